@@ -0,0 +1,108 @@
+#include "AssetLoader.h"
+
+AssetLoader::AssetLoader()
+{
+	shuttingDown = false;
+	totalJobs = 0;
+	finishedJobs = 0;
+
+	// Leave one hardware thread for the main thread, but always have at least one worker
+	unsigned int workerCount = std::thread::hardware_concurrency();
+	workerCount = workerCount > 1 ? workerCount - 1 : 1;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+}
+
+AssetLoader::~AssetLoader()
+{
+	// Let every queued job run so nothing that was loaded is leaked
+	WaitForAll();
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		shuttingDown = true;
+	}
+	jobQueued.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void AssetLoader::QueueJob(std::function<void()> work, std::function<void()> finish)
+{
+	totalJobs++;
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		AssetJob job;
+		job.work = work;
+		job.finish = finish;
+		queuedJobs.push_back(job);
+	}
+	jobQueued.notify_one();
+}
+
+void AssetLoader::ProcessCompletedJobs()
+{
+	// Grab everything that has completed so the workers aren't blocked while the finish steps run
+	std::vector<std::function<void()>> ready;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		ready.swap(completedJobs);
+	}
+
+	for (size_t i = 0; i < ready.size(); i++)
+	{
+		ready[i]();
+		finishedJobs++;
+	}
+}
+
+void AssetLoader::WaitForAll()
+{
+	while (finishedJobs < totalJobs)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCompleted.wait(lock, [this] { return !completedJobs.empty(); });
+		}
+		ProcessCompletedJobs();
+	}
+}
+
+bool AssetLoader::IsLoading()
+{
+	return finishedJobs < totalJobs;
+}
+
+float AssetLoader::GetProgress()
+{
+	return totalJobs == 0 ? 1.0f : (float)finishedJobs / totalJobs;
+}
+
+void AssetLoader::WorkerLoop()
+{
+	while (true)
+	{
+		AssetJob job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobQueued.wait(lock, [this] { return shuttingDown || !queuedJobs.empty(); });
+			if (queuedJobs.empty())
+				return;
+
+			job = queuedJobs.front();
+			queuedJobs.pop_front();
+		}
+
+		// Do the heavy lifting without holding the lock, then hand the finish step to the main thread
+		job.work();
+
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			completedJobs.push_back(job.finish);
+		}
+		jobCompleted.notify_one();
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A small worker pool for loading assets off the main thread
+// Each job is split into a work step that runs on a worker
+// (file I/O and CPU side processing) and a finish step that
+// runs on the main thread (creating the device objects), so
+// nothing but the workers' own data is touched concurrently
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	AssetLoader(); // Constructor (one worker per spare hardware thread)
+	~AssetLoader(); // Destructor (waits for every queued job)
+
+	// Queues a job whose work step runs on a worker and whose finish step runs on the main thread
+	void QueueJob(std::function<void()> work, std::function<void()> finish);
+
+	// Runs the finish step of every job whose work step has completed (main thread only)
+	void ProcessCompletedJobs();
+
+	// Blocks until every queued job has completed and had its finish step run (main thread only)
+	void WaitForAll();
+
+	// GET methods
+	bool IsLoading();
+	float GetProgress();
+
+private:
+	// Pulls jobs off the queue until the loader shuts down
+	void WorkerLoop();
+
+	// Work steps waiting for a worker and finish steps waiting for the main thread
+	struct AssetJob
+	{
+		std::function<void()> work;
+		std::function<void()> finish;
+	};
+	std::deque<AssetJob> queuedJobs;
+	std::vector<std::function<void()>> completedJobs;
+
+	// Worker threads and what they use to wait on each other
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+	std::condition_variable jobQueued;
+	std::condition_variable jobCompleted;
+	bool shuttingDown;
+
+	// Counters for reporting progress (only touched on the main thread)
+	unsigned int totalJobs;
+	unsigned int finishedJobs;
+};
@@ -1,20 +1,21 @@
 #pragma once
 #include "Entity.h"
 #include "Emitter.h"
+#include "Random.h"
 
 // --------------------------------------------------------
 // An Asteroid class that represents a singular asteroid object
 // Inherits from the Entity class
+// Drifting is handled by the TransformStore using the
+// velocity assigned at construction
 // --------------------------------------------------------
 class Asteroid :
 	public Entity
 {
 public:
-	Asteroid(Mesh* m, Material* mat, int type);
+	Asteroid(Mesh* m, Material* mat, int type, TransformStore* transforms, Random* random);
 	~Asteroid();
 
-	// Update the asteroid
-	void Update(float deltaTime, float totalTime);
 private:
 	Emitter * emitter;
 };
@@ -0,0 +1,1032 @@
+#include "Benchmarks.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "SpatialGrid.h"
+#include "Emitter.h"
+#include "JobPool.h"
+#include "Mesh.h"
+#include "Random.h"
+
+// Frames simulated for each timed run
+#define BENCHMARK_FRAMES 30
+
+// Broadphase benchmark world, with the game's cell size and about one entity per 64 square units
+#define BROADPHASE_CELL_SIZE 10.0f
+#define BROADPHASE_AREA_PER_ENTITY 64.0f
+#define BROADPHASE_BRUTE_FORCE_LIMIT 10000 // All pairs testing past this takes minutes
+
+// Models bundled with the game, for the vertex cache report
+static const char* bundledModels[] =
+{
+	"resources/models/bullet.obj",
+	"resources/models/cone.obj",
+	"resources/models/cube.obj",
+	"resources/models/cylinder.obj",
+	"resources/models/helix.obj",
+	"resources/models/SpaceShip.obj",
+	"resources/models/sphere.obj",
+	"resources/models/torus.obj",
+};
+
+// OBJ parse benchmark: a grid of this many cells a side (over a million faces) with a few normals
+#define OBJ_PARSE_GRID_CELLS 1100
+#define OBJ_PARSE_NORMAL_COUNT 4
+#define OBJ_PARSE_RUNS 3
+
+// Vertex dedup report: the bundled models load in milliseconds, so each is timed over several loads
+#define MESH_DEDUP_RUNS 20
+
+// How the generated OBJ files write a face corner
+#define OBJ_CORNER_FULL 0 // v/vt/vn
+#define OBJ_CORNER_NO_UV 1 // v//vn
+#define OBJ_CORNER_ZERO_UV 2 // v/vt/vn with a vt of 0 0, what the old reader needs for v//vn
+#define OBJ_CORNER_NEGATIVE 3 // v/vt/vn counting back from the end of each list
+
+// Particle benchmarks step at 60 frames a second with particles that outlive the run
+#define PARTICLE_DELTA_TIME (1.0f / 60.0f)
+
+// Threaded particle benchmark: a handful of big emitters, like several explosions at once
+#define THREADED_EMITTER_COUNT 4
+#define THREADED_EMITTER_PARTICLES 250000
+
+// The old particle upload: four of these per particle (one per quad corner) plus six
+// 32 bit indices, with the whole vertex buffer copied every frame however many were alive
+#define LEGACY_VERTICES_PER_PARTICLE 4
+#define LEGACY_INDICES_PER_PARTICLE 6
+// Sort benchmark camera: looking down +Z from this far behind the particles
+#define SORT_CAMERA_DISTANCE 50.0f
+#define SORT_DEPTH_KEY_STEPS 65535.0f // The emitter quantizes depths to 16 bit keys
+
+struct LegacyParticleVertex
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT2 UV;
+	DirectX::XMFLOAT4 Color;
+	float Size;
+};
+
+// --------------------------------------------------------
+// Prints a line of results and appends it to Benchmarks.txt,
+// since there is no console to read when running headless
+// --------------------------------------------------------
+static void Report(const char* format, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	printf("%s\n", line);
+
+	FILE* log = nullptr;
+	if (fopen_s(&log, "Benchmarks.txt", "a") == 0 && log)
+	{
+		fprintf(log, "%s\n", line);
+		fclose(log);
+	}
+}
+
+// --------------------------------------------------------
+// Milliseconds since a QueryPerformanceCounter time
+// --------------------------------------------------------
+static double MillisecondsSince(__int64 start)
+{
+	__int64 now;
+	__int64 frequency;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+	return (now - start) * 1000.0 / frequency;
+}
+
+// --------------------------------------------------------
+// Makes a simulation only emitter with a full ring of
+// particles flying out in every direction
+// --------------------------------------------------------
+static Emitter* CreateFullEmitter(int count)
+{
+	Emitter* emitter = new Emitter(0, count, 0, 0, 0, 0, 0);
+	emitter->SetLifetime(1000000.0f);
+	emitter->SetParticlesPerSecod(1);
+	emitter->SetEmitterAcceleration(DirectX::XMFLOAT3(0, -1, 0));
+	emitter->SetStartColor(DirectX::XMFLOAT4(1, 0.5f, 0, 1));
+	emitter->SetEndColor(DirectX::XMFLOAT4(0, 0, 1, 0));
+	emitter->SetStartSize(1.0f);
+	emitter->SetEndSize(0.0f);
+	emitter->SetBurstSize(count);
+	emitter->Explode(DirectX::XMFLOAT3(0, 0, 0));
+	emitter->Update(PARTICLE_DELTA_TIME);
+	return emitter;
+}
+
+// --------------------------------------------------------
+// Moves a field of circles around for a number of frames,
+// refreshing and querying every one of them each frame the
+// way UpdateEntities does, and compares the time with
+// testing every pair directly
+// --------------------------------------------------------
+int RunBroadphaseBenchmark()
+{
+	Report("Broadphase benchmark (%d frames per size)", BENCHMARK_FRAMES);
+
+	int failures = 0;
+	const int counts[] = { 1000, 10000, 100000 };
+	for (int c = 0; c < _countof(counts); c++)
+	{
+		int count = counts[c];
+		float halfSize = sqrtf(count * BROADPHASE_AREA_PER_ENTITY) * 0.5f;
+
+		// The grid only uses entity pointers as keys and never follows them, so stand-ins will do
+		std::vector<char> standIns(count);
+		std::vector<float> x(count), z(count), velocityX(count), velocityZ(count), radius(count);
+		Random random(1);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = random.Range(-halfSize, halfSize);
+			z[i] = random.Range(-halfSize, halfSize);
+			velocityX[i] = random.Range(-0.5f, 0.5f);
+			velocityZ[i] = random.Range(-0.5f, 0.5f);
+			radius[i] = random.Range(1.0f, 3.0f);
+		}
+
+		SpatialGrid grid(BROADPHASE_CELL_SIZE);
+		__int64 start;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int i = 0; i < count; i++)
+			grid.Insert((Entity*)&standIns[i], x[i], z[i], radius[i], i);
+		double buildTime = MillisecondsSince(start);
+
+		// Timed frames, counting the candidates that actually overlap
+		std::vector<Entity*> candidates;
+		long long candidateCount = 0;
+		long long overlapCount = 0;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				x[i] += velocityX[i];
+				z[i] += velocityZ[i];
+				grid.Move((Entity*)&standIns[i], x[i], z[i], radius[i]);
+			}
+
+			for (int i = 0; i < count; i++)
+			{
+				grid.Query(x[i], z[i], radius[i], candidates);
+				candidateCount += candidates.size();
+				for (size_t k = 0; k < candidates.size(); k++)
+				{
+					int j = (int)((char*)candidates[k] - &standIns[0]);
+					float dx = x[i] - x[j];
+					float dz = z[i] - z[j];
+					float reach = radius[i] + radius[j];
+					if (j != i && dx * dx + dz * dz <= reach * reach)
+						overlapCount++;
+				}
+			}
+		}
+		double gridTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+		Report("  %6d entities: build %.2f ms, grid %.3f ms/frame, %.1f candidates per query",
+			count, buildTime, gridTime, (double)candidateCount / ((double)count * BENCHMARK_FRAMES));
+
+		// All pairs testing over the final positions must find exactly the overlaps the grid found there
+		if (count > BROADPHASE_BRUTE_FORCE_LIMIT)
+			continue;
+
+		long long gridLastFrame = 0;
+		for (int i = 0; i < count; i++)
+		{
+			grid.Query(x[i], z[i], radius[i], candidates);
+			for (size_t k = 0; k < candidates.size(); k++)
+			{
+				int j = (int)((char*)candidates[k] - &standIns[0]);
+				float dx = x[i] - x[j];
+				float dz = z[i] - z[j];
+				float reach = radius[i] + radius[j];
+				if (j != i && dx * dx + dz * dz <= reach * reach)
+					gridLastFrame++;
+			}
+		}
+
+		long long bruteLastFrame = 0;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int i = 0; i < count; i++)
+		{
+			for (int j = 0; j < count; j++)
+			{
+				float dx = x[i] - x[j];
+				float dz = z[i] - z[j];
+				float reach = radius[i] + radius[j];
+				if (j != i && dx * dx + dz * dz <= reach * reach)
+					bruteLastFrame++;
+			}
+		}
+		double bruteTime = MillisecondsSince(start);
+
+		Report("  %6d entities: all pairs %.3f ms/frame (%.1fx the grid), overlaps %lld vs %lld%s",
+			count, bruteTime, bruteTime / gridTime, gridLastFrame, bruteLastFrame,
+			gridLastFrame == bruteLastFrame ? "" : " MISMATCH");
+		if (gridLastFrame != bruteLastFrame)
+			failures++;
+	}
+
+	return failures;
+}
+
+// --------------------------------------------------------
+// Loads every bundled model the way the game does and reports
+// its simulated vertex cache results from before and after
+// the optimizer reordered it (the numbers saved in the binary
+// cache when the model comes from there)
+// --------------------------------------------------------
+int RunVertexCacheReport()
+{
+	Report("Vertex cache report (ACMR: vertices transformed per triangle, ATVR: per unique vertex)");
+
+	int failures = 0;
+	for (int m = 0; m < _countof(bundledModels); m++)
+	{
+		Mesh mesh((char*)bundledModels[m]);
+		VertexCacheStats before;
+		VertexCacheStats after;
+		if (!mesh.GetVertexCacheStats(before, after))
+		{
+			Report("  %-32s not optimized (missing, or MESH_OPTIMIZE is off)", bundledModels[m]);
+			failures++;
+			continue;
+		}
+
+		Report("  %-32s ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+			bundledModels[m], before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+
+	return failures;
+}
+
+// --------------------------------------------------------
+// Key used by the old OBJ reader to merge face corners that
+// share the exact same position, uv and normal (a copy of
+// the one in Mesh.cpp, which is private to it)
+// --------------------------------------------------------
+struct LegacyVertexKey
+{
+	LegacyVertexKey(const Vertex& vertex)
+	{
+		// Adding zero turns any -0.0 into 0.0 so values that compare equal also hash equal
+		values[0] = vertex.Position.x + 0.0f;
+		values[1] = vertex.Position.y + 0.0f;
+		values[2] = vertex.Position.z + 0.0f;
+		values[3] = vertex.UV.x + 0.0f;
+		values[4] = vertex.UV.y + 0.0f;
+		values[5] = vertex.Normal.x + 0.0f;
+		values[6] = vertex.Normal.y + 0.0f;
+		values[7] = vertex.Normal.z + 0.0f;
+	}
+
+	bool operator==(const LegacyVertexKey& other) const
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			if (values[i] != other.values[i])
+				return false;
+		}
+		return true;
+	}
+
+	float values[8];
+};
+
+struct LegacyVertexKeyHasher
+{
+	size_t operator()(const LegacyVertexKey& key) const
+	{
+		// FNV-1a over the bits of every component
+		unsigned long long hash = 14695981039346656037ULL;
+		for (int i = 0; i < 8; i++)
+		{
+			unsigned int bits;
+			memcpy(&bits, &key.values[i], sizeof(unsigned int));
+			hash = (hash ^ bits) * 1099511628211ULL;
+		}
+		return (size_t)hash;
+	}
+};
+
+// Returns the index of an identical vertex if one was already added, otherwise adds this one
+static unsigned int AddLegacyUniqueVertex(const Vertex& vertex, std::vector<Vertex>& verts, std::unordered_map<LegacyVertexKey, unsigned int, LegacyVertexKeyHasher>& uniqueVerts)
+{
+	auto inserted = uniqueVerts.emplace(LegacyVertexKey(vertex), (unsigned int)verts.size());
+	if (inserted.second)
+		verts.push_back(vertex);
+
+	return inserted.first->second;
+}
+
+// Adds a face corner, sharing an identical earlier vertex only when merging (before merging every corner was its own vertex)
+static unsigned int AddLegacyVertex(const Vertex& vertex, bool mergeVertices, std::vector<Vertex>& verts, std::unordered_map<LegacyVertexKey, unsigned int, LegacyVertexKeyHasher>& uniqueVerts)
+{
+	if (mergeVertices)
+		return AddLegacyUniqueVertex(vertex, verts, uniqueVerts);
+
+	verts.push_back(vertex);
+	return (unsigned int)verts.size() - 1;
+}
+
+// --------------------------------------------------------
+// The OBJ reader Mesh used before ParseObj, kept as it was
+// (a line at a time through getline and sscanf_s) so the
+// parse benchmark has something to compare against
+// With mergeVertices off it is the reader from before
+// duplicate corners were merged, for the dedup report
+// Only reads triangles and quads with v/vt/vn corners
+// --------------------------------------------------------
+static bool ParseObjLegacy(const char* objFile, bool mergeVertices, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	// File input object
+	std::ifstream obj(objFile);
+
+	// Check for successful open
+	if (!obj.is_open())
+		return false;
+
+	// Variables used while reading the file
+	std::vector<DirectX::XMFLOAT3> positions;     // Positions from the file
+	std::vector<DirectX::XMFLOAT3> normals;       // Normals from the file
+	std::vector<DirectX::XMFLOAT2> uvs;           // UVs from the file
+	std::unordered_map<LegacyVertexKey, unsigned int, LegacyVertexKeyHasher> uniqueVerts; // Index of each unique vert
+	char chars[100];                     // String for line reading
+
+	// Still have data left?
+	while (obj.good())
+	{
+		// Get the line (100 characters should be more than enough)
+		obj.getline(chars, 100);
+
+		// Check the type of line
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			// Read the 3 numbers directly into an XMFLOAT3
+			DirectX::XMFLOAT3 norm;
+			sscanf_s(
+				chars,
+				"vn %f %f %f",
+				&norm.x, &norm.y, &norm.z);
+
+			// Add to the list of normals
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			// Read the 2 numbers directly into an XMFLOAT2
+			DirectX::XMFLOAT2 uv;
+			sscanf_s(
+				chars,
+				"vt %f %f",
+				&uv.x, &uv.y);
+
+			// Add to the list of uv's
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			// Read the 3 numbers directly into an XMFLOAT3
+			DirectX::XMFLOAT3 pos;
+			sscanf_s(
+				chars,
+				"v %f %f %f",
+				&pos.x, &pos.y, &pos.z);
+
+			// Add to the positions
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			// Read the face indices into an array
+			unsigned int i[12];
+			int facesRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			// - Create the verts by looking up
+			//    corresponding data from vectors
+			// - OBJ File indices are 1-based, so
+			//    they need to be adusted
+			Vertex v1;
+			v1.Position = positions[i[0] - 1];
+			v1.UV = uvs[i[1] - 1];
+			v1.Normal = normals[i[2] - 1];
+
+			Vertex v2;
+			v2.Position = positions[i[3] - 1];
+			v2.UV = uvs[i[4] - 1];
+			v2.Normal = normals[i[5] - 1];
+
+			Vertex v3;
+			v3.Position = positions[i[6] - 1];
+			v3.UV = uvs[i[7] - 1];
+			v3.Normal = normals[i[8] - 1];
+
+			// Flip the UV's since they're probably "upside down"
+			v1.UV.y = 1.0f - v1.UV.y;
+			v2.UV.y = 1.0f - v2.UV.y;
+			v3.UV.y = 1.0f - v3.UV.y;
+
+			// Flip Z (LH vs. RH)
+			v1.Position.z *= -1.0f;
+			v2.Position.z *= -1.0f;
+			v3.Position.z *= -1.0f;
+
+			// Flip normal Z
+			v1.Normal.z *= -1.0f;
+			v2.Normal.z *= -1.0f;
+			v3.Normal.z *= -1.0f;
+
+			// Add the verts and their indices (flipping the winding order)
+			// Corners shared with earlier faces reuse the existing vert
+			indices.push_back(AddLegacyVertex(v1, mergeVertices, verts, uniqueVerts));
+			indices.push_back(AddLegacyVertex(v3, mergeVertices, verts, uniqueVerts));
+			indices.push_back(AddLegacyVertex(v2, mergeVertices, verts, uniqueVerts));
+
+			// Was there a 4th face?
+			if (facesRead == 12)
+			{
+				// Make the last vertex
+				Vertex v4;
+				v4.Position = positions[i[9] - 1];
+				v4.UV = uvs[i[10] - 1];
+				v4.Normal = normals[i[11] - 1];
+
+				// Flip the UV, Z pos and normal
+				v4.UV.y = 1.0f - v4.UV.y;
+				v4.Position.z *= -1.0f;
+				v4.Normal.z *= -1.0f;
+
+				// Add a whole triangle (flipping the winding order)
+				indices.push_back(AddLegacyVertex(v1, mergeVertices, verts, uniqueVerts));
+				indices.push_back(AddLegacyVertex(v4, mergeVertices, verts, uniqueVerts));
+				indices.push_back(AddLegacyVertex(v3, mergeVertices, verts, uniqueVerts));
+			}
+		}
+	}
+
+	// Close the file
+	obj.close();
+	return !indices.empty();
+}
+
+// --------------------------------------------------------
+// Writes one face corner of the generated OBJ files, where
+// corner is the 0-based index of a grid point (which picks
+// its position, its uv and one of the few normals)
+// --------------------------------------------------------
+static void WriteObjCorner(FILE* file, int corner, int style)
+{
+	int positionCount = (OBJ_PARSE_GRID_CELLS + 1) * (OBJ_PARSE_GRID_CELLS + 1);
+	int position = corner + 1;
+	int normal = corner % OBJ_PARSE_NORMAL_COUNT + 1;
+	switch (style)
+	{
+	case OBJ_CORNER_NO_UV:
+		fprintf(file, " %d//%d", position, normal);
+		break;
+	case OBJ_CORNER_ZERO_UV:
+		fprintf(file, " %d/%d/%d", position, positionCount + 1, normal); // The extra "vt 0 0" after the grid's uvs
+		break;
+	case OBJ_CORNER_NEGATIVE:
+		fprintf(file, " %d/%d/%d", position - positionCount - 1, position - positionCount - 1, normal - OBJ_PARSE_NORMAL_COUNT - 1);
+		break;
+	default:
+		fprintf(file, " %d/%d/%d", position, position, normal);
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Writes the same grid mesh as two OBJ files:
+//  - One using everything ParseObj reads: quads, hexagons,
+//     v//vn corners and negative (relative) indices
+//  - One the old reader can read too, with the hexagons fanned
+//     into triangles, v//vn corners pointing at a "vt 0 0"
+//     (what ParseObj gives corners without a uv) and every
+//     index written as positive
+// Both parsers should come out with identical meshes
+// Returns the number of faces in the first file, or 0 on failure
+// --------------------------------------------------------
+static int WriteObjParseFiles(const char* objFile, const char* legacyObjFile)
+{
+	const int side = OBJ_PARSE_GRID_CELLS + 1;
+	const char* files[] = { objFile, legacyObjFile };
+
+	int faceCount = 0;
+	for (int f = 0; f < 2; f++)
+	{
+		bool legacy = f == 1;
+		FILE* file = nullptr;
+		if (fopen_s(&file, files[f], "wb") != 0 || !file)
+			return 0;
+
+		// A rippled grid with exact (power of two) values so every float parser reads them the same
+		for (int y = 0; y < side; y++)
+			for (int x = 0; x < side; x++)
+				fprintf(file, "v %g %g %g\n", x * 0.25f, ((x * 7 + y * 3) % 16) * 0.125f, y * 0.25f);
+		for (int y = 0; y < side; y++)
+			for (int x = 0; x < side; x++)
+				fprintf(file, "vt %.10g %.10g\n", (x % 1024) / 1024.0f, (y % 1024) / 1024.0f);
+		if (legacy)
+			fprintf(file, "vt 0 0\n");
+		fprintf(file, "vn 0 1 0\nvn 0.5 0.75 -0.25\nvn -0.5 0.75 0.25\nvn 0 0.5 1\n");
+
+		// Rows take turns at each kind of face
+		faceCount = 0;
+		for (int y = 0; y < OBJ_PARSE_GRID_CELLS; y++)
+		{
+			int kind = y % 4;
+			int step = kind == 3 ? 2 : 1;
+			for (int x = 0; x < OBJ_PARSE_GRID_CELLS; x += step)
+			{
+				int corners[6];
+				int cornerCount = 0;
+				corners[cornerCount++] = y * side + x;
+				corners[cornerCount++] = y * side + x + 1;
+				if (kind == 3) corners[cornerCount++] = y * side + x + 2;
+				if (kind == 3) corners[cornerCount++] = (y + 1) * side + x + 2;
+				corners[cornerCount++] = (y + 1) * side + x + 1;
+				corners[cornerCount++] = (y + 1) * side + x;
+				faceCount++;
+
+				int style = OBJ_CORNER_FULL;
+				if (kind == 1) style = legacy ? OBJ_CORNER_ZERO_UV : OBJ_CORNER_NO_UV;
+				if (kind == 2 && !legacy) style = OBJ_CORNER_NEGATIVE;
+
+				// The old reader only takes up to four corners, so fan the hexagons the way ParseObj does
+				if (legacy && cornerCount > 4)
+				{
+					for (int c = 1; c + 1 < cornerCount; c++)
+					{
+						fprintf(file, "f");
+						WriteObjCorner(file, corners[0], style);
+						WriteObjCorner(file, corners[c], style);
+						WriteObjCorner(file, corners[c + 1], style);
+						fprintf(file, "\n");
+					}
+					continue;
+				}
+
+				fprintf(file, "f");
+				for (int c = 0; c < cornerCount; c++)
+					WriteObjCorner(file, corners[c], style);
+				fprintf(file, "\n");
+			}
+		}
+
+		fclose(file);
+	}
+
+	return faceCount;
+}
+
+// --------------------------------------------------------
+// Whether two parsed meshes have the same vertices (position,
+// uv and normal, tangents are made later) and indices
+// --------------------------------------------------------
+static bool SameParsedMesh(const std::vector<Vertex>& vertsA, const std::vector<unsigned int>& indicesA, const std::vector<Vertex>& vertsB, const std::vector<unsigned int>& indicesB)
+{
+	if (vertsA.size() != vertsB.size() || indicesA != indicesB)
+		return false;
+
+	for (size_t v = 0; v < vertsA.size(); v++)
+	{
+		if (memcmp(&vertsA[v].Position, &vertsB[v].Position, sizeof(DirectX::XMFLOAT3)) != 0 ||
+			memcmp(&vertsA[v].UV, &vertsB[v].UV, sizeof(DirectX::XMFLOAT2)) != 0 ||
+			memcmp(&vertsA[v].Normal, &vertsB[v].Normal, sizeof(DirectX::XMFLOAT3)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Times Mesh::ParseObj against the old getline and sscanf_s
+// reader on a generated model of over a million faces, and
+// checks both come out with the same vertices and indices
+// --------------------------------------------------------
+int RunObjParseBenchmark()
+{
+	Report("OBJ parse benchmark (%d runs per reader)", OBJ_PARSE_RUNS);
+
+	const char* objFile = "ObjParseBenchmark.obj";
+	const char* legacyObjFile = "ObjParseBenchmarkLegacy.obj";
+	int faceCount = WriteObjParseFiles(objFile, legacyObjFile);
+	if (faceCount == 0)
+	{
+		Report("  Couldn't write %s and %s", objFile, legacyObjFile);
+		return 1;
+	}
+
+	// Fresh vectors each run, the way a mesh load starts out
+	std::vector<Vertex> legacyVerts;
+	std::vector<unsigned int> legacyIndices;
+	__int64 start;
+	QueryPerformanceCounter((LARGE_INTEGER*)&start);
+	for (int run = 0; run < OBJ_PARSE_RUNS; run++)
+	{
+		legacyVerts.clear();
+		legacyVerts.shrink_to_fit();
+		legacyIndices.clear();
+		legacyIndices.shrink_to_fit();
+		ParseObjLegacy(legacyObjFile, true, legacyVerts, legacyIndices);
+	}
+	double legacyTime = MillisecondsSince(start) / OBJ_PARSE_RUNS;
+
+	// ParseObj on the file the old reader read, then on the one using the rest of the format
+	std::vector<Vertex> sameFileVerts;
+	std::vector<unsigned int> sameFileIndices;
+	QueryPerformanceCounter((LARGE_INTEGER*)&start);
+	for (int run = 0; run < OBJ_PARSE_RUNS; run++)
+	{
+		sameFileVerts.clear();
+		sameFileVerts.shrink_to_fit();
+		sameFileIndices.clear();
+		sameFileIndices.shrink_to_fit();
+		Mesh::ParseObj((char*)legacyObjFile, sameFileVerts, sameFileIndices);
+	}
+	double sameFileTime = MillisecondsSince(start) / OBJ_PARSE_RUNS;
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	QueryPerformanceCounter((LARGE_INTEGER*)&start);
+	for (int run = 0; run < OBJ_PARSE_RUNS; run++)
+	{
+		verts.clear();
+		verts.shrink_to_fit();
+		indices.clear();
+		indices.shrink_to_fit();
+		Mesh::ParseObj((char*)objFile, verts, indices);
+	}
+	double parseTime = MillisecondsSince(start) / OBJ_PARSE_RUNS;
+
+	remove(objFile);
+	remove(legacyObjFile);
+
+	bool sameAsLegacy = !legacyIndices.empty() && SameParsedMesh(sameFileVerts, sameFileIndices, legacyVerts, legacyIndices);
+	bool fullSyntaxSame = !legacyIndices.empty() && SameParsedMesh(verts, indices, legacyVerts, legacyIndices);
+
+	Report("  %d faces (quads, hexagons, v//vn corners, negative indices): %d vertices, %d triangles",
+		faceCount, (int)verts.size(), (int)indices.size() / 3);
+	Report("  getline/sscanf_s %.1f ms, ParseObj %.1f ms on the same file (%.1fx faster)%s",
+		legacyTime, sameFileTime, legacyTime / sameFileTime, sameAsLegacy ? "" : " DIFFERENT MESH");
+	Report("  ParseObj %.1f ms on the file with n-gons, v//vn and negative indices%s",
+		parseTime, fullSyntaxSame ? "" : " DIFFERENT MESH");
+
+	int failures = 0;
+	if (!sameAsLegacy)
+		failures++;
+	if (!fullSyntaxSame)
+		failures++;
+	return failures;
+}
+
+// --------------------------------------------------------
+// Loads every bundled model through the old reader with and
+// without merging duplicate corners, and reports the vertex
+// buffer size and the time to parse and build tangents each
+// way. Merging must only share vertices, so every triangle
+// corner is checked against the unmerged load
+// --------------------------------------------------------
+int RunMeshDedupReport()
+{
+	Report("Vertex dedup report (parse plus tangents, one vertex per corner -> merged, %d runs per model)", MESH_DEDUP_RUNS);
+
+	int failures = 0;
+	for (int m = 0; m < _countof(bundledModels); m++)
+	{
+		std::vector<Vertex> cornerVerts;
+		std::vector<unsigned int> cornerIndices;
+		__int64 start;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int run = 0; run < MESH_DEDUP_RUNS; run++)
+		{
+			cornerVerts.clear();
+			cornerIndices.clear();
+			if (!ParseObjLegacy(bundledModels[m], false, cornerVerts, cornerIndices))
+				break;
+			Mesh::CalculateTangents(&cornerVerts[0], (int)cornerVerts.size(), &cornerIndices[0], (int)cornerIndices.size());
+		}
+		double cornerTime = MillisecondsSince(start) / MESH_DEDUP_RUNS;
+
+		std::vector<Vertex> mergedVerts;
+		std::vector<unsigned int> mergedIndices;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int run = 0; run < MESH_DEDUP_RUNS; run++)
+		{
+			mergedVerts.clear();
+			mergedIndices.clear();
+			if (!ParseObjLegacy(bundledModels[m], true, mergedVerts, mergedIndices))
+				break;
+			Mesh::CalculateTangents(&mergedVerts[0], (int)mergedVerts.size(), &mergedIndices[0], (int)mergedIndices.size());
+		}
+		double mergedTime = MillisecondsSince(start) / MESH_DEDUP_RUNS;
+
+		if (cornerIndices.empty() || mergedIndices.empty())
+		{
+			Report("  %-32s couldn't be read", bundledModels[m]);
+			failures++;
+			continue;
+		}
+
+		// Each triangle corner should see the same position, uv and normal either way
+		int mismatched = 0;
+		if (cornerIndices.size() != mergedIndices.size())
+			mismatched = (int)cornerIndices.size();
+		for (size_t i = 0; mismatched == 0 && i < cornerIndices.size(); i++)
+		{
+			const Vertex& corner = cornerVerts[cornerIndices[i]];
+			const Vertex& merged = mergedVerts[mergedIndices[i]];
+			if (memcmp(&corner.Position, &merged.Position, sizeof(DirectX::XMFLOAT3)) != 0 ||
+				memcmp(&corner.UV, &merged.UV, sizeof(DirectX::XMFLOAT2)) != 0 ||
+				memcmp(&corner.Normal, &merged.Normal, sizeof(DirectX::XMFLOAT3)) != 0)
+				mismatched++;
+		}
+
+		Report("  %-32s %6d -> %5d vertices, %4d KB -> %4d KB, %.3f -> %.3f ms%s",
+			bundledModels[m], (int)cornerVerts.size(), (int)mergedVerts.size(),
+			(int)(cornerVerts.size() * sizeof(Vertex) / 1024), (int)(mergedVerts.size() * sizeof(Vertex) / 1024),
+			cornerTime, mergedTime, mismatched == 0 ? "" : " DIFFERENT CORNERS");
+		if (mismatched > 0)
+			failures++;
+	}
+
+	return failures;
+}
+
+// --------------------------------------------------------
+// Times a full ring of particles through the SIMD update
+// (Update, four particles per instruction) and through the
+// per particle path it replaced (UpdateSingleParticle)
+// --------------------------------------------------------
+int RunParticleBenchmark()
+{
+	Report("Particle update benchmark (%d frames per size)", BENCHMARK_FRAMES);
+
+	int failures = 0;
+	const int counts[] = { 1000, 100000, 1000000 };
+	for (int c = 0; c < _countof(counts); c++)
+	{
+		int count = counts[c];
+		Emitter* emitter = CreateFullEmitter(count);
+		if (emitter->GetLivingParticleCount() != count)
+			failures++;
+
+		__int64 start;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			emitter->Update(PARTICLE_DELTA_TIME);
+		double simdTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+		{
+			for (int i = 0; i < count; i++)
+				emitter->UpdateSingleParticle(PARTICLE_DELTA_TIME, i);
+		}
+		double scalarTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		Report("  %7d particles: SIMD %.3f ms/frame (%.1f M particles/s), per particle %.3f ms/frame (%.1f M particles/s)",
+			count, simdTime, count / (simdTime * 1000.0), scalarTime, count / (scalarTime * 1000.0));
+		delete emitter;
+	}
+
+	return failures;
+}
+
+// --------------------------------------------------------
+// Updates emitters the way EntityManager::UpdateEmitters does:
+// every emitter's chunks in one parallel batch, then every
+// emitter's retire and spawn step in another
+// --------------------------------------------------------
+static void UpdateEmittersInParallel(JobPool& pool, std::vector<Emitter*>& emitters, float dt)
+{
+	std::vector<std::pair<Emitter*, int>> jobs;
+	for (size_t e = 0; e < emitters.size(); e++)
+	{
+		int chunkCount = emitters[e]->BeginUpdate(dt);
+		for (int i = 0; i < chunkCount; i++)
+			jobs.push_back(std::pair<Emitter*, int>(emitters[e], i));
+	}
+
+	pool.ParallelFor((int)jobs.size(), [&jobs](int job)
+	{
+		jobs[job].first->UpdateChunk(jobs[job].second);
+	});
+
+	pool.ParallelFor((int)emitters.size(), [&emitters](int e)
+	{
+		emitters[e]->EndUpdate();
+	});
+}
+
+// --------------------------------------------------------
+// Times the chunked emitter update with 1, 2, 4... threads up
+// to every hardware thread, and checks each thread count ends
+// with exactly the same particles as the single thread run
+// --------------------------------------------------------
+int RunParticleThreadBenchmark()
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	if (hardwareThreads == 0)
+		hardwareThreads = 1;
+
+	Report("Threaded particle update benchmark (%d emitters of %d particles, %d frames, %u hardware threads)",
+		THREADED_EMITTER_COUNT, THREADED_EMITTER_PARTICLES, BENCHMARK_FRAMES, hardwareThreads);
+
+	// Thread counts to try, always ending with every hardware thread
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(hardwareThreads);
+
+	int failures = 0;
+	double singleThreadTime = 0.0;
+	std::vector<ParticleInstance> singleThreadInstances;
+	for (size_t t = 0; t < threadCounts.size(); t++)
+	{
+		JobPool pool(threadCounts[t]);
+
+		// Fresh emitters for every run so each one starts from the same state
+		std::vector<Emitter*> emitters;
+		for (int e = 0; e < THREADED_EMITTER_COUNT; e++)
+			emitters.push_back(CreateFullEmitter(THREADED_EMITTER_PARTICLES));
+
+		__int64 start;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			UpdateEmittersInParallel(pool, emitters, PARTICLE_DELTA_TIME);
+		double time = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		// Every emitter's particles, laid out as they would be uploaded
+		std::vector<ParticleInstance> instances(THREADED_EMITTER_COUNT * THREADED_EMITTER_PARTICLES);
+		for (int e = 0; e < THREADED_EMITTER_COUNT; e++)
+		{
+			emitters[e]->WriteInstances(&instances[e * THREADED_EMITTER_PARTICLES]);
+			delete emitters[e];
+		}
+
+		bool matches = true;
+		if (t == 0)
+		{
+			singleThreadTime = time;
+			singleThreadInstances = instances;
+		}
+		else
+		{
+			matches = memcmp(&instances[0], &singleThreadInstances[0], instances.size() * sizeof(ParticleInstance)) == 0;
+		}
+
+		Report("  %2u thread(s): %.3f ms/frame (%.2fx one thread)%s",
+			threadCounts[t], time, singleThreadTime / time, matches ? "" : " MISMATCH with one thread");
+		if (!matches)
+			failures++;
+	}
+
+	return failures;
+}
+
+// --------------------------------------------------------
+// Reports how much particle data crosses to the GPU each
+// frame with the packed 20 byte instances, against the old
+// four 40 byte vertices per particle, and times writing both
+// (the old path builds its vertices locally then copies them)
+// --------------------------------------------------------
+int RunParticleBandwidthReport()
+{
+	const int legacyBytesPerParticle = (int)sizeof(LegacyParticleVertex) * LEGACY_VERTICES_PER_PARTICLE;
+	const int legacyIndexBytesPerParticle = (int)sizeof(unsigned int) * LEGACY_INDICES_PER_PARTICLE;
+
+	Report("Particle bandwidth report (%d frames per size)", BENCHMARK_FRAMES);
+	Report("  Per particle: %d byte instance now, %d bytes of vertices before (%d x %d) plus %d bytes of indices the GPU fetched",
+		(int)sizeof(ParticleInstance), legacyBytesPerParticle, LEGACY_VERTICES_PER_PARTICLE, (int)sizeof(LegacyParticleVertex),
+		legacyIndexBytesPerParticle);
+
+	const int counts[] = { 1000, 100000, 1000000 };
+	for (int c = 0; c < _countof(counts); c++)
+	{
+		int count = counts[c];
+		Emitter* emitter = CreateFullEmitter(count);
+		std::vector<ParticleInstance> instances(count);
+		std::vector<LegacyParticleVertex> localVertices(count * LEGACY_VERTICES_PER_PARTICLE);
+		std::vector<LegacyParticleVertex> uploadedVertices(count * LEGACY_VERTICES_PER_PARTICLE);
+
+		__int64 start;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			emitter->WriteInstances(&instances[0]);
+		double instanceTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		// The old path, fed from the freshly written instances so both see the same particles
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				LegacyParticleVertex vertex = {};
+				vertex.Position = instances[i].Position;
+				vertex.Color = DirectX::XMFLOAT4(
+					(instances[i].Color & 0xFF) / 255.0f,
+					((instances[i].Color >> 8) & 0xFF) / 255.0f,
+					((instances[i].Color >> 16) & 0xFF) / 255.0f,
+					(instances[i].Color >> 24) / 255.0f);
+				vertex.Size = instances[i].Size;
+				for (int corner = 0; corner < LEGACY_VERTICES_PER_PARTICLE; corner++)
+					localVertices[i * LEGACY_VERTICES_PER_PARTICLE + corner] = vertex;
+			}
+			memcpy(&uploadedVertices[0], &localVertices[0], localVertices.size() * sizeof(LegacyParticleVertex));
+		}
+		double legacyTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		double instanceMegabytes = (double)count * sizeof(ParticleInstance) / (1024.0 * 1024.0);
+		double legacyMegabytes = (double)count * legacyBytesPerParticle / (1024.0 * 1024.0);
+		Report("  %7d particles: %.2f MB/frame in %.3f ms now, %.2f MB/frame in %.3f ms before (%.1fx the bytes)",
+			count, instanceMegabytes, instanceTime, legacyMegabytes, legacyTime, legacyMegabytes / instanceMegabytes);
+		delete emitter;
+	}
+
+	return 0;
+}
+
+// --------------------------------------------------------
+// Times the particle depth sort (keys plus radix sort) against
+// std::sort of the same depths, and checks the sorted instances
+// really come out farthest first
+// --------------------------------------------------------
+int RunParticleSortBenchmark()
+{
+	Report("Particle depth sort benchmark (%d frames per size)", BENCHMARK_FRAMES);
+
+	// A (transposed) view matrix whose depth row just adds the camera distance to z
+	DirectX::XMFLOAT4X4 view = {};
+	view._11 = view._22 = view._33 = view._44 = 1.0f;
+	view._34 = SORT_CAMERA_DISTANCE;
+
+	int failures = 0;
+	const int counts[] = { 10000, 100000, 1000000 };
+	for (int c = 0; c < _countof(counts); c++)
+	{
+		int count = counts[c];
+		Emitter* emitter = CreateFullEmitter(count);
+		std::vector<ParticleInstance> instances(count);
+
+		// The same depths and ring indices the emitter sorts, for std::sort to work on
+		emitter->WriteInstances(&instances[0]);
+		std::vector<std::pair<float, unsigned int>> depths(count);
+		std::vector<std::pair<float, unsigned int>> sortedDepths(count);
+		for (int i = 0; i < count; i++)
+			depths[i] = std::pair<float, unsigned int>(instances[i].Position.z + SORT_CAMERA_DISTANCE, i);
+
+		__int64 start;
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			emitter->SortParticlesByDepth(view);
+		double radixTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		QueryPerformanceCounter((LARGE_INTEGER*)&start);
+		for (int frame = 0; frame < BENCHMARK_FRAMES; frame++)
+		{
+			sortedDepths = depths;
+			std::sort(sortedDepths.begin(), sortedDepths.end(),
+				[](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+		}
+		double stdSortTime = MillisecondsSince(start) / BENCHMARK_FRAMES;
+
+		// Farthest first, allowing for particles that share a quantized depth keeping their ring order
+		emitter->SetDepthSorted(true);
+		emitter->WriteInstances(&instances[0]);
+		float depthStep = (sortedDepths[0].first - sortedDepths[count - 1].first) / SORT_DEPTH_KEY_STEPS;
+		int outOfOrder = 0;
+		for (int i = 1; i < count; i++)
+		{
+			if (instances[i].Position.z > instances[i - 1].Position.z + depthStep)
+				outOfOrder++;
+		}
+
+		Report("  %7d particles: radix %.3f ms/frame, std::sort %.3f ms/frame (%.1fx slower)%s",
+			count, radixTime, stdSortTime, stdSortTime / radixTime, outOfOrder == 0 ? "" : " OUT OF ORDER");
+		if (outOfOrder > 0)
+			failures++;
+		delete emitter;
+	}
+
+	return failures;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// --------------------------------------------------------
+// Headless benchmarks for the engine's CPU side systems
+// Each one is started from the command line (see Main.cpp),
+// runs without a window or device, prints its results and
+// appends them to Benchmarks.txt next to the executable
+// Each returns 0, or non-zero if a result check failed
+// --------------------------------------------------------
+
+// -benchmark-broadphase: grid broadphase against all-pairs testing, 1k to 100k entities
+int RunBroadphaseBenchmark();
+
+// -report-vertex-cache: simulated vertex cache results for the bundled models, before and after optimizing
+int RunVertexCacheReport();
+
+// -benchmark-obj-parse: Mesh::ParseObj against the old getline/sscanf_s reader on a generated model of over a million faces
+int RunObjParseBenchmark();
+
+// -report-mesh-dedup: vertex buffer size and load time for the bundled models, one vertex per corner against merged vertices
+int RunMeshDedupReport();
+
+// -benchmark-particles: SIMD particle update against the per particle path, 1k to 1M particles
+int RunParticleBenchmark();
+
+// -benchmark-particle-threads: several emitters updated across 1 thread up to every hardware thread
+int RunParticleThreadBenchmark();
+
+// -report-particle-bandwidth: bytes uploaded per particle each frame, and the time to write them, against the old vertex format
+int RunParticleBandwidthReport();
+
+// -benchmark-particle-sort: particle depth sort (radix) against std::sort, 10k to 1M particles
+int RunParticleSortBenchmark();
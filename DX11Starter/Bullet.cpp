@@ -3,22 +3,20 @@
 // For the DirectX Math library
 using namespace DirectX;
 
-Bullet::Bullet(Mesh* m, Material* mat, int type) :
-	Entity(m, mat, type)
+Bullet::Bullet(Mesh* m, Material* mat, int type, TransformStore* transforms) :
+	Entity(m, mat, type, transforms)
 {
 	maxSpeed = 25;
 
-	// Set scale smaller
-	scale = XMFLOAT3(.5f, .5f, .5f);
+	// Set scale smaller (directly on the transform so the collider keeps its mesh radius)
+	transforms->SetScale(transformIndex, XMFLOAT3(.5f, .5f, .5f));
 
-	// Position and Direction are set by EntityManager to match the player's at the time of firing
-	
-	// Make sure to normalize the direction
-	XMVECTOR tempDir = XMVector3Normalize(XMLoadFloat3(&direction));
-	XMStoreFloat3(&direction, tempDir);
-
-	// Calculate the velocity of the bullet
-	XMStoreFloat3(&velocity, tempDir * maxSpeed);
+	// Bullets start out parked in the pool until they are launched
+	active = false;
+	age = 0;
+	lifetime = 3.0f;
+	origin = XMFLOAT3(0, 0, 0);
+	range = 80.0f;
 }
 
 
@@ -27,15 +25,43 @@ Bullet::~Bullet()
 
 }
 
-void Bullet::Update(float deltaTime, float totalTime)
+void Bullet::Launch(XMFLOAT3 position, XMFLOAT3 direction)
 {
+	active = true;
+	age = 0;
+	origin = position;
+
+	SetPosition(position);
+	SetDirection(direction);
+
 	// Calculate the velocity of the bullet
+	XMFLOAT3 velocity;
 	XMStoreFloat3(&velocity, XMLoadFloat3(&direction) * maxSpeed);
+	SetVelocity(velocity);
+}
 
-	XMStoreFloat3(&position, (XMLoadFloat3(&position) + XMLoadFloat3(&velocity)* deltaTime));
-	// Set the world matrix to dirty so that it updates
-	isWorldDirty = true;
+void Bullet::Deactivate()
+{
+	active = false;
 
-	// Run base entity update
-	Entity::Update(deltaTime, totalTime);
+	// Stop the bullet so the batched transform pass leaves it where it is
+	SetVelocity(XMFLOAT3(0, 0, 0));
+}
+
+bool Bullet::HasExpired(float deltaTime)
+{
+	age += deltaTime;
+	if (age > lifetime)
+		return true;
+
+	// Bullets that have flown off the field are recycled early
+	XMFLOAT3 position = GetPosition();
+	float dx = position.x - origin.x;
+	float dz = position.z - origin.z;
+	return dx * dx + dz * dz > range * range;
+}
+
+bool Bullet::IsActive()
+{
+	return active;
 }
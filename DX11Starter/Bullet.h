@@ -4,16 +4,38 @@
 // --------------------------------------------------------
 // A Bullet class that represents a singular bullet object
 // Inherits from the Entity class
-// Only ever Instantiated by the Player class
+// Only ever Instantiated by the EntityManager's bullet pool
+// Flight is handled by the TransformStore once launched
 // --------------------------------------------------------
 class Bullet :
 	public Entity
 {
 public:
-	Bullet(Mesh* m, Material* mat, int type);
+	Bullet(Mesh* m, Material* mat, int type, TransformStore* transforms);
 	~Bullet();
 
-	// Update the bullet
-	void Update(float deltaTime, float totalTime);
+	// Place the bullet and send it flying in the given direction
+	void Launch(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 direction);
+
+	// Stop the bullet and hand it back to the pool
+	void Deactivate();
+
+	// Age the bullet, returns true once it has outlived its lifetime or range
+	bool HasExpired(float deltaTime);
+
+	// GET methods
+	bool IsActive();
+
+private:
+	// Whether the bullet is currently in flight
+	bool active;
+
+	// Time spent in flight and how long the bullet is allowed to fly for
+	float age;
+	float lifetime;
+
+	// Where the bullet was fired from and how far it can travel from there
+	DirectX::XMFLOAT3 origin;
+	float range;
 };
 
@@ -50,6 +50,7 @@ DXCore::DXCore(
 	// Initialize fields
 	fpsFrameCount = 0;
 	fpsTimeElapsed = 0.0f;
+	showWindow = true;
 	
 	device = 0;
 	context = 0;
@@ -148,7 +149,7 @@ HRESULT DXCore::InitWindow()
 
 	// The window exists but is not visible yet
 	// We need to tell Windows to show it, and how to show it
-	ShowWindow(hWnd, SW_SHOW);
+	ShowWindow(hWnd, showWindow ? SW_SHOW : SW_HIDE);
 
 	// Return an "everything is ok" HRESULT value
 	return S_OK;
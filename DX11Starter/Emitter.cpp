@@ -1,9 +1,23 @@
 #include "Emitter.h"
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+// Number of particles simulated as a single job, a multiple of 4 to keep whole vectors together
+#define EMITTER_CHUNK_SIZE 2048
+
+// Most explosions that can be waiting to spawn at once, any more in the same frame are dropped
+#define EMITTER_MAX_QUEUED_BURSTS 32
+
+// Depth sorted emitters quantize view depth to this many bits, two radix passes
+#define EMITTER_DEPTH_KEY_BITS 16
+#define EMITTER_DEPTH_KEY_MAX 65535.0f
 
 using namespace DirectX;
 
 Emitter::Emitter(
 	ID3D11Device* device,
+	int maxParticles,
 	SimpleVertexShader* vs,
 	SimplePixelShader* ps,
 	ID3D11ShaderResourceView* texture,
@@ -14,99 +28,169 @@ Emitter::Emitter(
 	// Save params
 	this->vs = vs;
 	this->ps = ps;
+	viewVariable = vs ? vs->GetVariableInfo("view") : 0;
+	projectionVariable = vs ? vs->GetVariableInfo("projection") : 0;
+	textureSlot = ps ? ps->GetShaderResourceViewInfo("particle") : 0;
 	this->texture = texture;
 	this->particleDepthState = particleDepthState;
 	this->particleBlendState = particleBlendState;
-
-	this->maxParticles = 1000;
+	this->device = device;
 
 	timeSinceEmit = 0;
 	livingParticleCount = 0;
 	firstAliveIndex = 0;
 	firstDeadIndex = 0;
-
-	// Make the particle array
-	particles = new Particle[maxParticles];
-
-	// Safe to create our UVs here
-	// also unroll loop a bit, no sense in doing more iterations than needed
-	localParticleVertices = new ParticleVertex[4 * maxParticles];
-	for (int i = 0; i < maxParticles * 4; i += 4)
-	{
-		localParticleVertices[i + 0].UV = XMFLOAT2(0, 0);
-		localParticleVertices[i + 1].UV = XMFLOAT2(1, 0);
-		localParticleVertices[i + 2].UV = XMFLOAT2(1, 1);
-		localParticleVertices[i + 3].UV = XMFLOAT2(0, 1);
-	}
-
-
-	// Create buffers for drawing particles
-	D3D11_BUFFER_DESC vbDesc = {};
-	vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	vbDesc.Usage = D3D11_USAGE_DYNAMIC;
-	vbDesc.ByteWidth = sizeof(ParticleVertex) * 4 * maxParticles;
-	device->CreateBuffer(&vbDesc, 0, &vertexBuffer);
-
-	// Index buffer data
-	unsigned int* indices = new unsigned int[maxParticles * 6];
-	int indexCount = 0;
-	for (int i = 0; i < maxParticles * 4; i += 4)
-	{
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 1;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i + 3;
-	}
-	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indices;
-
-	// Regular index buffer
-	D3D11_BUFFER_DESC ibDesc = {};
-	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibDesc.CPUAccessFlags = 0;
-	ibDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibDesc.ByteWidth = sizeof(unsigned int) * maxParticles * 6;
-	device->CreateBuffer(&ibDesc, &indexData, &indexBuffer);
-
-	delete[] indices;
+	this->maxParticles = 0;
+	instanceBuffer = 0;
+	followEmitter = true;
+	depthSorted = false;
+	jobPool = 0;
+	collisionMode = ParticleCollision::None;
+	colliders = 0;
+	bounciness = 0.5f;
+	spawnScale = 1.0f;
+	emitterPosition = XMFLOAT3(0, 0, 0);
+	queuedBursts.reserve(EMITTER_MAX_QUEUED_BURSTS);
+
+	// Make the particle streams and instance buffer
+	SetMaxParticles(maxParticles);
+	burstSize = this->maxParticles;
 }
 
 
 Emitter::~Emitter()
 {
-	delete[] particles;
-	delete[] localParticleVertices;
-	vertexBuffer->Release();
-	indexBuffer->Release();
+	if (instanceBuffer) { instanceBuffer->Release(); }
 }
 
 void Emitter::Update(float dt)
 {
+	// Simulate every chunk on this thread
+	int chunkCount = BeginUpdate(dt);
+	for (int i = 0; i < chunkCount; i++)
+		UpdateChunk(i);
+	EndUpdate();
+}
+
+int Emitter::BeginUpdate(float dt)
+{
+	updateDeltaTime = dt;
+	updateChunks.clear();
+
 	// Update all particles - Check cyclic buffer first
 	// i.e always draw first alive before first dead
 	if (firstAliveIndex < firstDeadIndex)
 	{
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+		AddUpdateChunks(firstAliveIndex, firstDeadIndex);
 	}
-	else
+	else if (livingParticleCount > 0)
 	{
 		// otherwise our living particles will wrap around, this saves
 		// us from making tons of new ones
 		// Update first half (from firstAlive to max particles)
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			UpdateSingleParticle(dt, i);
+		AddUpdateChunks(firstAliveIndex, maxParticles);
 
 		// Update second half (from 0 to first dead)
-		for (int i = 0; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+		AddUpdateChunks(0, firstDeadIndex);
+	}
+
+	return (int)updateChunks.size();
+}
+
+void Emitter::AddUpdateChunks(int start, int end)
+{
+	// Chunks are a multiple of 4 long so only the last chunk of a run ever needs the scalar path
+	for (int chunkStart = start; chunkStart < end; chunkStart += EMITTER_CHUNK_SIZE)
+	{
+		ParticleChunk chunk;
+		chunk.start = chunkStart;
+		chunk.end = chunkStart + EMITTER_CHUNK_SIZE < end ? chunkStart + EMITTER_CHUNK_SIZE : end;
+		chunk.deadCount = 0;
+		updateChunks.push_back(chunk);
 	}
+}
 
-	// Add to the time
-	timeSinceEmit += dt;
+void Emitter::UpdateChunk(int chunk)
+{
+	// Chunks never overlap, so each one only touches its own particles and death count
+	updateChunks[chunk].deadCount = UpdateParticleRange(updateDeltaTime, updateChunks[chunk].start, updateChunks[chunk].end);
+
+	// The colliders don't change during the update, so chunks can test against them at the same time
+	if (collisionMode != ParticleCollision::None && colliders)
+		CollideParticleRange(updateChunks[chunk].start, updateChunks[chunk].end);
+}
+
+void Emitter::CollideParticleRange(int start, int end)
+{
+	XMFLOAT3 startPos = followEmitter ? emitterPosition : XMFLOAT3(0, 0, 0);
+	for (int i = start; i < end; i++)
+	{
+		// Skip dead particles and ones already killed by a collision
+		if (ages[i] >= lifetime || visibility[i] == 0.0f)
+			continue;
+
+		float colliderX, colliderZ, colliderRadius;
+		if (!colliders->FindCollider(positionX[i], positionZ[i], colliderX, colliderZ, colliderRadius))
+			continue;
+
+		// A killed particle can't leave the ring early without breaking its spawn order,
+		// so it stays in its slot at zero size until it would have died anyway
+		if (collisionMode == ParticleCollision::Kill)
+		{
+			visibility[i] = 0.0f;
+			sizes[i] = 0.0f;
+			continue;
+		}
+
+		// Push the particle back out to the edge of the circle
+		float normalX = positionX[i] - colliderX;
+		float normalZ = positionZ[i] - colliderZ;
+		float length = sqrtf(normalX * normalX + normalZ * normalZ);
+		if (length > 0.0f)
+		{
+			normalX /= length;
+			normalZ /= length;
+		}
+		else
+		{
+			normalX = 1.0f;
+			normalZ = 0.0f;
+		}
+		positionX[i] = colliderX + normalX * colliderRadius;
+		positionZ[i] = colliderZ + normalZ * colliderRadius;
+
+		// Reflect the particle's current velocity if it's still heading inwards
+		float t = ages[i];
+		float velocityX = startVelocityX[i] + emitterAcceleration.x * t;
+		float velocityZ = startVelocityZ[i] + emitterAcceleration.z * t;
+		float inwardSpeed = velocityX * normalX + velocityZ * normalZ;
+		if (inwardSpeed < 0.0f)
+		{
+			velocityX -= (1.0f + bounciness) * inwardSpeed * normalX;
+			velocityZ -= (1.0f + bounciness) * inwardSpeed * normalZ;
+		}
+
+		// Positions are worked out from the age each frame, so restart the motion from here:
+		// pick the start velocity and origin that put the particle at this position and velocity at its current age
+		startVelocityX[i] = velocityX - emitterAcceleration.x * t;
+		startVelocityZ[i] = velocityZ - emitterAcceleration.z * t;
+		originX[i] = positionX[i] - startPos.x - (emitterAcceleration.x * 0.5f * t + startVelocityX[i]) * t;
+		originZ[i] = positionZ[i] - startPos.z - (emitterAcceleration.z * 0.5f * t + startVelocityZ[i]) * t;
+	}
+}
+
+void Emitter::EndUpdate()
+{
+	// Particles always die in the order they were spawned, so retire them all by moving the alive index
+	int deadCount = 0;
+	for (size_t i = 0; i < updateChunks.size(); i++)
+		deadCount += updateChunks[i].deadCount;
+
+	firstAliveIndex = (firstAliveIndex + deadCount) % maxParticles;
+	livingParticleCount -= deadCount;
+
+	// Add to the time, slowed down when the particle budget is scaling this emitter back
+	timeSinceEmit += updateDeltaTime * spawnScale;
 
 	// Enough time to emit?
 	while (timeSinceEmit > secondsPerParticle)
@@ -114,50 +198,111 @@ void Emitter::Update(float dt)
 		SpawnParticle();
 		timeSinceEmit -= secondsPerParticle;
 	}
+
+	// Spawn any explosions queued since the last update
+	SpawnQueuedBursts();
 }
 
-void Emitter::UpdateSingleParticle(float dt, int index)
+int Emitter::UpdateParticleRange(float dt, int start, int end)
 {
-	// Check for valid particle age before doing anything
-	if (particles[index].Age >= lifetime)
-		return;
-
-	// Update and check for death
-	particles[index].Age += dt;
-	if (particles[index].Age >= lifetime)
+	XMVECTOR dtV = XMVectorReplicate(dt);
+	XMVECTOR lifetimeV = XMVectorReplicate(lifetime);
+	XMVECTOR invLifetimeV = XMVectorReplicate(1.0f / lifetime);
+	XMVECTOR halfAccelX = XMVectorReplicate(emitterAcceleration.x * 0.5f);
+	XMVECTOR halfAccelY = XMVectorReplicate(emitterAcceleration.y * 0.5f);
+	XMVECTOR halfAccelZ = XMVectorReplicate(emitterAcceleration.z * 0.5f);
+	XMFLOAT3 startPos = followEmitter ? emitterPosition : XMFLOAT3(0, 0, 0);
+	XMVECTOR startPosX = XMVectorReplicate(startPos.x);
+	XMVECTOR startPosY = XMVectorReplicate(startPos.y);
+	XMVECTOR startPosZ = XMVectorReplicate(startPos.z);
+	XMVECTOR startR = XMVectorReplicate(startColor.x);
+	XMVECTOR startG = XMVectorReplicate(startColor.y);
+	XMVECTOR startB = XMVectorReplicate(startColor.z);
+	XMVECTOR startA = XMVectorReplicate(startColor.w);
+	XMVECTOR deltaR = XMVectorReplicate(endColor.x - startColor.x);
+	XMVECTOR deltaG = XMVectorReplicate(endColor.y - startColor.y);
+	XMVECTOR deltaB = XMVectorReplicate(endColor.z - startColor.z);
+	XMVECTOR deltaA = XMVectorReplicate(endColor.w - startColor.w);
+	XMVECTOR startSizeV = XMVectorReplicate(startSize);
+	XMVECTOR deltaSizeV = XMVectorReplicate(endSize - startSize);
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR deaths = XMVectorZero();
+
+	// Four particles per iteration, each lane of a vector being a different particle
+	// The loads are unaligned since the live range can start anywhere in the ring
+	int i = start;
+	for (; i + 4 <= end; i += 4)
 	{
-		// Recent death, so retire by moving alive count
-		firstAliveIndex++;
-		firstAliveIndex %= maxParticles;
-		livingParticleCount--;
-		return;
+		// Age only the living lanes and count the ones that died this frame
+		XMVECTOR age = XMLoadFloat4((XMFLOAT4*)&ages[i]);
+		XMVECTOR alive = XMVectorLess(age, lifetimeV);
+		age = XMVectorSelect(age, XMVectorAdd(age, dtV), alive);
+		XMVECTOR died = XMVectorAndInt(alive, XMVectorGreaterOrEqual(age, lifetimeV));
+		deaths = XMVectorAdd(deaths, XMVectorSelect(XMVectorZero(), one, died));
+		XMStoreFloat4((XMFLOAT4*)&ages[i], age);
+
+		// Interpolate the color and size by age percentage
+		XMVECTOR agePercent = XMVectorMultiply(age, invLifetimeV);
+		XMStoreFloat4((XMFLOAT4*)&colorR[i], XMVectorMultiplyAdd(deltaR, agePercent, startR));
+		XMStoreFloat4((XMFLOAT4*)&colorG[i], XMVectorMultiplyAdd(deltaG, agePercent, startG));
+		XMStoreFloat4((XMFLOAT4*)&colorB[i], XMVectorMultiplyAdd(deltaB, agePercent, startB));
+		XMStoreFloat4((XMFLOAT4*)&colorA[i], XMVectorMultiplyAdd(deltaA, agePercent, startA));
+		XMVECTOR size = XMVectorMultiplyAdd(deltaSizeV, agePercent, startSizeV);
+		XMStoreFloat4((XMFLOAT4*)&sizes[i], XMVectorMultiply(size, XMLoadFloat4((XMFLOAT4*)&visibility[i])));
+
+		// Use constant acceleration function, (accel * t / 2 + startVel) * t + (origin + startPos)
+		XMVECTOR vx = XMLoadFloat4((XMFLOAT4*)&startVelocityX[i]);
+		XMVECTOR vy = XMLoadFloat4((XMFLOAT4*)&startVelocityY[i]);
+		XMVECTOR vz = XMLoadFloat4((XMFLOAT4*)&startVelocityZ[i]);
+		XMVECTOR px = XMVectorAdd(XMLoadFloat4((XMFLOAT4*)&originX[i]), startPosX);
+		XMVECTOR py = XMVectorAdd(XMLoadFloat4((XMFLOAT4*)&originY[i]), startPosY);
+		XMVECTOR pz = XMVectorAdd(XMLoadFloat4((XMFLOAT4*)&originZ[i]), startPosZ);
+		XMStoreFloat4((XMFLOAT4*)&positionX[i], XMVectorMultiplyAdd(XMVectorMultiplyAdd(halfAccelX, age, vx), age, px));
+		XMStoreFloat4((XMFLOAT4*)&positionY[i], XMVectorMultiplyAdd(XMVectorMultiplyAdd(halfAccelY, age, vy), age, py));
+		XMStoreFloat4((XMFLOAT4*)&positionZ[i], XMVectorMultiplyAdd(XMVectorMultiplyAdd(halfAccelZ, age, vz), age, pz));
 	}
 
-	// Calculate age percentage for lerp
-	float agePercent = particles[index].Age / lifetime;
+	// Sum the per lane death counts
+	XMFLOAT4 deathLanes;
+	XMStoreFloat4(&deathLanes, deaths);
+	int deadCount = (int)(deathLanes.x + deathLanes.y + deathLanes.z + deathLanes.w);
 
-	// Interpolate the color
-	XMStoreFloat4(
-		&particles[index].Color,
-		XMVectorLerp(
-			XMLoadFloat4(&startColor),
-			XMLoadFloat4(&endColor),
-			agePercent));
+	// Finish off whatever doesn't fill a whole vector
+	for (; i < end; i++)
+		deadCount += UpdateSingleParticle(dt, i);
 
-	// Lerp size
-	particles[index].Size = startSize + agePercent * (endSize - startSize);
+	return deadCount;
+}
 
+int Emitter::UpdateSingleParticle(float dt, int index)
+{
+	// Check for valid particle age before doing anything
+	if (ages[index] >= lifetime)
+		return 0;
 
-	// Adjust the position
-	XMVECTOR startPos = XMLoadFloat3(&emitterPosition);
-	XMVECTOR startVel = XMLoadFloat3(&particles[index].StartVelocity);
-	XMVECTOR accel = XMLoadFloat3(&emitterAcceleration);
-	float t = particles[index].Age;
+	// Update and check for death
+	ages[index] += dt;
+	if (ages[index] >= lifetime)
+		return 1;
 
-	// Use constant acceleration function
-	XMStoreFloat3(
-		&particles[index].Position,
-		accel * t * t / 2.0f + startVel * t + startPos);
+	// Calculate age percentage for lerp
+	// This does the exact same operations as UpdateParticleRange so results don't depend on how the ring was split up
+	float t = ages[index];
+	float agePercent = t * (1.0f / lifetime);
+
+	// Interpolate the color and size
+	colorR[index] = (endColor.x - startColor.x) * agePercent + startColor.x;
+	colorG[index] = (endColor.y - startColor.y) * agePercent + startColor.y;
+	colorB[index] = (endColor.z - startColor.z) * agePercent + startColor.z;
+	colorA[index] = (endColor.w - startColor.w) * agePercent + startColor.w;
+	sizes[index] = ((endSize - startSize) * agePercent + startSize) * visibility[index];
+
+	// Use constant acceleration function, (accel * t / 2 + startVel) * t + (origin + startPos)
+	XMFLOAT3 startPos = followEmitter ? emitterPosition : XMFLOAT3(0, 0, 0);
+	positionX[index] = (emitterAcceleration.x * 0.5f * t + startVelocityX[index]) * t + (originX[index] + startPos.x);
+	positionY[index] = (emitterAcceleration.y * 0.5f * t + startVelocityY[index]) * t + (originY[index] + startPos.y);
+	positionZ[index] = (emitterAcceleration.z * 0.5f * t + startVelocityZ[index]) * t + (originZ[index] + startPos.z);
+	return 0;
 }
 
 void Emitter::SpawnParticle()
@@ -166,15 +311,32 @@ void Emitter::SpawnParticle()
 	if (livingParticleCount == maxParticles)
 		return;
 
-	// Reset the first dead particle
-	particles[firstDeadIndex].Age = 0;
-	particles[firstDeadIndex].Size = startSize;
-	particles[firstDeadIndex].Color = startColor;
-	particles[firstDeadIndex].Position = emitterPosition;
-	particles[firstDeadIndex].StartVelocity = startVelocity;
-	particles[firstDeadIndex].StartVelocity.x += ((float)rand() / RAND_MAX) * 0.4f - 0.2f;
-	particles[firstDeadIndex].StartVelocity.y += ((float)rand() / RAND_MAX) * 0.4f - 0.2f;
-	particles[firstDeadIndex].StartVelocity.z += ((float)rand() / RAND_MAX) * 0.4f - 0.2f;
+	// Reset the first dead particle, at the emitter itself with a little spread
+	XMFLOAT3 velocity(
+		startVelocity.x + random.Range(-0.2f, 0.2f),
+		startVelocity.y + random.Range(-0.2f, 0.2f),
+		startVelocity.z + random.Range(-0.2f, 0.2f));
+	InitParticle(velocity, followEmitter ? XMFLOAT3(0, 0, 0) : emitterPosition);
+}
+
+void Emitter::InitParticle(XMFLOAT3 velocity, XMFLOAT3 origin)
+{
+	ages[firstDeadIndex] = 0;
+	sizes[firstDeadIndex] = startSize;
+	visibility[firstDeadIndex] = 1.0f;
+	colorR[firstDeadIndex] = startColor.x;
+	colorG[firstDeadIndex] = startColor.y;
+	colorB[firstDeadIndex] = startColor.z;
+	colorA[firstDeadIndex] = startColor.w;
+	originX[firstDeadIndex] = origin.x;
+	originY[firstDeadIndex] = origin.y;
+	originZ[firstDeadIndex] = origin.z;
+	positionX[firstDeadIndex] = followEmitter ? origin.x + emitterPosition.x : origin.x;
+	positionY[firstDeadIndex] = followEmitter ? origin.y + emitterPosition.y : origin.y;
+	positionZ[firstDeadIndex] = followEmitter ? origin.z + emitterPosition.z : origin.z;
+	startVelocityX[firstDeadIndex] = velocity.x;
+	startVelocityY[firstDeadIndex] = velocity.y;
+	startVelocityZ[firstDeadIndex] = velocity.z;
 
 	// Increment and wrap
 	firstDeadIndex++;
@@ -185,90 +347,150 @@ void Emitter::SpawnParticle()
 
 void Emitter::CopyParticlesToGPU(ID3D11DeviceContext* context)
 {
-	// Update local buffer (living particles only as a speed up)
+	// Discarding hands back a fresh buffer, so only the living particles are written
+	// Each one is written straight into the mapped memory at the same ring position the draw calls read from
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	WriteInstances((ParticleInstance*)mapped.pData);
+	context->Unmap(instanceBuffer, 0);
+}
 
+void Emitter::WriteInstances(ParticleInstance* instances)
+{
+	if (depthSorted)
+	{
+		// Sorted particles are packed from the start of the buffer in drawing order instead
+		for (int i = 0; i < livingParticleCount; i++)
+			CopyOneParticle(&instances[i], sortedIndices[i]);
+	}
 	// Check cyclic buffer status
-	if (firstAliveIndex < firstDeadIndex)
+	else if (firstAliveIndex < firstDeadIndex)
 	{
 		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
+			CopyOneParticle(&instances[i], i);
 	}
-	else
+	else if (livingParticleCount > 0)
 	{
 		// Update first half (from firstAlive to max particles)
 		for (int i = firstAliveIndex; i < maxParticles; i++)
-			CopyOneParticle(i);
+			CopyOneParticle(&instances[i], i);
 
 		// Update second half (from 0 to first dead)
 		for (int i = 0; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
+			CopyOneParticle(&instances[i], i);
 	}
+}
 
-	// All particles copied locally - send whole buffer to GPU
-	D3D11_MAPPED_SUBRESOURCE mapped = {};
-	context->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
-
-	memcpy(mapped.pData, localParticleVertices, sizeof(ParticleVertex) * 4 * maxParticles);
-
-	context->Unmap(vertexBuffer, 0);
+void Emitter::CopyOneParticle(ParticleInstance* instance, int index)
+{
+	// Build the record locally and write it out in one go
+	// since the mapped memory is write combined and should never be read back
+	ParticleInstance particle;
+	particle.Position = XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+	particle.Color = PackParticleColor(XMFLOAT4(colorR[index], colorG[index], colorB[index], colorA[index]));
+	particle.Size = sizes[index];
+	*instance = particle;
 }
 
-void Emitter::CopyOneParticle(int index)
+void Emitter::SortParticlesByDepth(XMFLOAT4X4 viewMatrix)
 {
-	int i = index * 4;
+	sortedIndices.resize(livingParticleCount);
+	depthKeys.resize(livingParticleCount);
+
+	// View depth is the third row of the (transposed) view matrix dotted with the position
+	float depthX = viewMatrix._31;
+	float depthY = viewMatrix._32;
+	float depthZ = viewMatrix._33;
+	float depthW = viewMatrix._34;
+
+	// Work out each living particle's depth (parked in the key array for now) and the range they cover
+	float minDepth = FLT_MAX;
+	float maxDepth = -FLT_MAX;
+	for (int i = 0; i < livingParticleCount; i++)
+	{
+		int index = (firstAliveIndex + i) % maxParticles;
+		float depth = positionX[index] * depthX + positionY[index] * depthY + positionZ[index] * depthZ + depthW;
+		if (depth < minDepth) minDepth = depth;
+		if (depth > maxDepth) maxDepth = depth;
 
-	localParticleVertices[i + 0].Position = particles[index].Position;
-	localParticleVertices[i + 1].Position = particles[index].Position;
-	localParticleVertices[i + 2].Position = particles[index].Position;
-	localParticleVertices[i + 3].Position = particles[index].Position;
+		sortedIndices[i] = index;
+		memcpy(&depthKeys[i], &depth, sizeof(float));
+	}
 
-	localParticleVertices[i + 0].Size = particles[index].Size;
-	localParticleVertices[i + 1].Size = particles[index].Size;
-	localParticleVertices[i + 2].Size = particles[index].Size;
-	localParticleVertices[i + 3].Size = particles[index].Size;
+	// Quantize the depths across that range so the farthest particle gets the smallest key
+	// Particles closer together than one step keep their ring (age) order, since the sort is stable
+	float keyScale = maxDepth > minDepth ? EMITTER_DEPTH_KEY_MAX / (maxDepth - minDepth) : 0.0f;
+	for (int i = 0; i < livingParticleCount; i++)
+	{
+		float depth;
+		memcpy(&depth, &depthKeys[i], sizeof(float));
+		depthKeys[i] = (unsigned int)((maxDepth - depth) * keyScale + 0.5f);
+	}
 
-	localParticleVertices[i + 0].Color = particles[index].Color;
-	localParticleVertices[i + 1].Color = particles[index].Color;
-	localParticleVertices[i + 2].Color = particles[index].Color;
-	localParticleVertices[i + 3].Color = particles[index].Color;
+	depthSort.Sort(&depthKeys[0], &sortedIndices[0], livingParticleCount, EMITTER_DEPTH_KEY_BITS, jobPool);
+}
+
+unsigned int PackParticleColor(XMFLOAT4 color)
+{
+	// Clamp and round each channel to a byte
+	float channels[4] = { color.x, color.y, color.z, color.w };
+	unsigned int packed = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		float channel = channels[i] < 0.0f ? 0.0f : (channels[i] > 1.0f ? 1.0f : channels[i]);
+		packed |= (unsigned int)(channel * 255.0f + 0.5f) << (i * 8);
+	}
+	return packed;
 }
 
 void Emitter::Draw(ID3D11DeviceContext* context, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 {
+	// Nothing to copy or draw (and the wrapped draw below would otherwise read the whole unwritten buffer)
+	if (livingParticleCount == 0)
+		return;
+
 	float blend[4] = { 1,1,1,1 };
-	context->OMSetBlendState(particleBlendState, blend, 0xffffffff);  // Additive blending
+	context->OMSetBlendState(particleBlendState, blend, 0xffffffff);  // Additive blending unless changed
 	context->OMSetDepthStencilState(particleDepthState, 0);			// No depth WRITING
 
+	// Order the particles back to front before they're copied
+	if (depthSorted)
+		SortParticlesByDepth(viewMatrix);
+
 	// Copy to dynamic buffer
 	CopyParticlesToGPU(context);
 
-	// Set up buffers
-	UINT stride = sizeof(ParticleVertex);
+	// Set up buffers, the shader only reads per instance data (slot 1) and builds the corners itself
+	UINT stride = sizeof(ParticleInstance);
 	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	context->IASetVertexBuffers(1, 1, &instanceBuffer, &stride, &offset);
 
-	vs->SetMatrix4x4("view", viewMatrix);
-	vs->SetMatrix4x4("projection", projectionMatrix);
+	vs->SetMatrix4x4(viewVariable, viewMatrix);
+	vs->SetMatrix4x4(projectionVariable, projectionMatrix);
 	vs->SetShader();
 	vs->CopyAllBufferData();
 
-	ps->SetShaderResourceView("particle", texture);
+	ps->SetShaderResourceView(textureSlot, texture);
 	ps->SetShader();
 	ps->CopyAllBufferData();
 
-	// Draw the correct parts of the buffer
-	if (firstAliveIndex < firstDeadIndex)
+	// Draw the correct parts of the buffer, six corners for every particle instance
+	if (depthSorted)
+	{
+		// Sorted particles were copied in order to the start of the buffer
+		context->DrawInstanced(6, livingParticleCount, 0, 0);
+	}
+	else if (firstAliveIndex < firstDeadIndex)
 	{
-		context->DrawIndexed(livingParticleCount * 6, firstAliveIndex * 6, 0);
+		context->DrawInstanced(6, livingParticleCount, 0, firstAliveIndex);
 	}
 	else
 	{
 		// Draw first half (0 -> dead)
-		context->DrawIndexed(firstDeadIndex * 6, 0, 0);
+		context->DrawInstanced(6, firstDeadIndex, 0, 0);
 
 		// Draw second half (alive -> max)
-		context->DrawIndexed((maxParticles - firstAliveIndex) * 6, firstAliveIndex * 6, 0);
+		context->DrawInstanced(6, maxParticles - firstAliveIndex, 0, firstAliveIndex);
 	}
 
 	// Reset to default states for next frame
@@ -279,37 +501,61 @@ void Emitter::Draw(ID3D11DeviceContext* context, XMFLOAT4X4 viewMatrix, XMFLOAT4
 
 void Emitter::Explode(DirectX::XMFLOAT3 position)
 {
-	// Update Emitter Position
-	emitterPosition = position;
+	// Grab a burst from the pool, the particles themselves spawn on the next update
+	if (queuedBursts.size() == EMITTER_MAX_QUEUED_BURSTS)
+		return;
+
+	ParticleBurst burst;
+	burst.origin = position;
+	queuedBursts.push_back(burst);
+}
 
-	// Spawn loads of particles
-	for (int i = 0; i < maxParticles; i++)
+void Emitter::SpawnQueuedBursts()
+{
+	for (size_t i = 0; i < queuedBursts.size(); i++)
 	{
-		SpawnExplosionParticle();
+		// Split whatever room is left between this burst and the ones after it
+		int freeParticles = maxParticles - livingParticleCount;
+		int share = freeParticles / (int)(queuedBursts.size() - i);
+		int scaledBurstSize = (int)(burstSize * spawnScale + 0.5f);
+		int count = scaledBurstSize < share ? scaledBurstSize : share;
+
+		// Origins are stored relative to the emitter when particles follow it
+		XMFLOAT3 origin = queuedBursts[i].origin;
+		if (followEmitter)
+			origin = XMFLOAT3(origin.x - emitterPosition.x, origin.y - emitterPosition.y, origin.z - emitterPosition.z);
+
+		if (count <= 0)
+			continue;
+
+		// Generate every random direction (whole numbers from -5 to 4 on each axis) and spread for the burst in bulk
+		burstRandoms.resize(count * 6);
+		float* directions = &burstRandoms[0];
+		float* spread = &burstRandoms[count * 3];
+		random.FillRange(directions, count * 3, -5.0f, 5.0f);
+		random.FillRange(spread, count * 3, -0.2f, 0.2f);
+
+		// Spawn loads of particles
+		for (int p = 0; p < count; p++)
+		{
+			SpawnExplosionParticle(origin, XMFLOAT3(
+				floorf(directions[p * 3 + 0]) + spread[p * 3 + 0],
+				floorf(directions[p * 3 + 1]) + spread[p * 3 + 1],
+				floorf(directions[p * 3 + 2]) + spread[p * 3 + 2]));
+		}
 	}
+
+	queuedBursts.clear();
 }
 
-void Emitter::SpawnExplosionParticle()
+void Emitter::SpawnExplosionParticle(XMFLOAT3 origin, XMFLOAT3 velocity)
 {
 	// Check if there are any particles that need to spawn
 	if (livingParticleCount == maxParticles)
 		return;
 
 	// Reset the first dead particle
-	particles[firstDeadIndex].Age = 0;
-	particles[firstDeadIndex].Size = startSize;
-	particles[firstDeadIndex].Color = startColor;
-	particles[firstDeadIndex].Position = emitterPosition;
-	particles[firstDeadIndex].StartVelocity = XMFLOAT3(rand() % 10 + (-5), rand() % 10 + (-5), rand() % 10 + (-5));
-	particles[firstDeadIndex].StartVelocity.x += ((float)rand() / RAND_MAX) * 0.4f - 0.2f;
-	particles[firstDeadIndex].StartVelocity.y += ((float)rand() / RAND_MAX) * 0.4f - 0.2f;
-	particles[firstDeadIndex].StartVelocity.z += ((float)rand() / RAND_MAX) * 0.4f - 0.2f;
-
-	// Increment and wrap
-	firstDeadIndex++;
-	firstDeadIndex %= maxParticles;
-
-	livingParticleCount++;
+	InitParticle(velocity, origin);
 }
 
 DirectX::XMFLOAT3 Emitter::GetEmitterPosition()
@@ -317,9 +563,71 @@ DirectX::XMFLOAT3 Emitter::GetEmitterPosition()
 	return emitterPosition;
 }
 
+int Emitter::GetMaxParticles()
+{
+	return maxParticles;
+}
+
+int Emitter::GetLivingParticleCount()
+{
+	return livingParticleCount;
+}
+
+bool Emitter::GetFollowEmitter()
+{
+	return followEmitter;
+}
+
 void Emitter::SetMaxParticles(int _maxParticles)
 {
+	if (_maxParticles < 1)
+		_maxParticles = 1;
+	if (_maxParticles == maxParticles)
+		return;
+
+	// Keep as many living particles as fit, dropping the oldest (they would have died first anyway)
+	int keptCount = livingParticleCount < _maxParticles ? livingParticleCount : _maxParticles;
+	int firstKept = maxParticles > 0 ? (firstAliveIndex + livingParticleCount - keptCount) % maxParticles : 0;
+
+	// Unwrap the kept particles to the start of the new streams, oldest first, so the ring stays in spawn order
+	std::vector<float>* streams[] = {
+		&ages, &startVelocityX, &startVelocityY, &startVelocityZ,
+		&originX, &originY, &originZ, &positionX, &positionY, &positionZ,
+		&colorR, &colorG, &colorB, &colorA, &sizes, &visibility };
+	for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); s++)
+	{
+		std::vector<float> resized(_maxParticles, 0.0f);
+		for (int i = 0; i < keptCount; i++)
+			resized[i] = (*streams[s])[(firstKept + i) % maxParticles];
+		streams[s]->swap(resized);
+	}
+
 	maxParticles = _maxParticles;
+	livingParticleCount = keptCount;
+	firstAliveIndex = 0;
+	firstDeadIndex = keptCount % maxParticles;
+
+	// Recreate the instance buffer for drawing particles, one record per particle
+	if (instanceBuffer) { instanceBuffer->Release(); instanceBuffer = 0; }
+	if (!device)
+		return;
+
+	D3D11_BUFFER_DESC instanceDesc = {};
+	instanceDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instanceDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	instanceDesc.Usage = D3D11_USAGE_DYNAMIC;
+	instanceDesc.ByteWidth = sizeof(ParticleInstance) * maxParticles;
+	device->CreateBuffer(&instanceDesc, 0, &instanceBuffer);
+}
+
+void Emitter::SetBurstSize(int _burstSize)
+{
+	burstSize = _burstSize;
+}
+
+void Emitter::SetSpawnScale(float _spawnScale)
+{
+	spawnScale = _spawnScale < 0.0f ? 0.0f : _spawnScale;
 }
 
 void Emitter::SetParticlesPerSecod(int _particlesPerSecond)
@@ -367,3 +675,39 @@ void Emitter::SetEmitterAcceleration(DirectX::XMFLOAT3 _emitterAcceleration)
 {
 	emitterAcceleration = _emitterAcceleration;
 }
+
+void Emitter::SetFollowEmitter(bool _followEmitter)
+{
+	followEmitter = _followEmitter;
+}
+
+void Emitter::SetRandomSeed(unsigned int seed)
+{
+	random.Seed(seed);
+}
+
+void Emitter::SetDepthSorted(bool _depthSorted)
+{
+	depthSorted = _depthSorted;
+}
+
+void Emitter::SetBlendState(ID3D11BlendState* _particleBlendState)
+{
+	particleBlendState = _particleBlendState;
+}
+
+void Emitter::SetJobPool(JobPool* _jobPool)
+{
+	jobPool = _jobPool;
+}
+
+void Emitter::SetCollision(ParticleCollision _collisionMode, ParticleColliderGrid* _colliders)
+{
+	collisionMode = _collisionMode;
+	colliders = _colliders;
+}
+
+void Emitter::SetBounciness(float _bounciness)
+{
+	bounciness = _bounciness;
+}
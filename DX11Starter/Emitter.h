@@ -3,32 +3,45 @@
 #include <d3d11.h>
 #include <DirectXMath.h>
 
+#include <vector>
+
 #include "SimpleShader.h"
+#include "Random.h"
+#include "RadixSort.h"
+#include "ParticleColliderGrid.h"
 
-struct Particle
+// Per particle record read by the particle vertex shader once for each corner of the quad
+// The corners themselves are generated from the vertex ID, so this is all that gets uploaded
+struct ParticleInstance
 {
 	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT4 Color;
-	DirectX::XMFLOAT3 StartVelocity;
+	unsigned int Color; // RGBA8, red in the lowest byte
 	float Size;
-	float Age;
 };
 
-struct ParticleVertex
+// The particle vertex shader's slot 1 input layout reads exactly this
+static_assert(sizeof(ParticleInstance) == 20, "ParticleInstance must match the particle input layout");
+
+// What happens to a particle that flies into a collider
+enum class ParticleCollision
 {
-	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT2 UV;
-	DirectX::XMFLOAT4 Color;
-	float Size;
+	None,
+	Kill,
+	Bounce
 };
 
+// Packs a color into RGBA8 for a particle instance, clamping each channel to [0, 1]
+unsigned int PackParticleColor(DirectX::XMFLOAT4 color);
+
 // Currently doing CPU based emissions
 // We eventually want to switch it over to GPU-CPU hybrid
+// An emitter made without a device or shaders only simulates (for headless benchmarks) and can't be drawn
 class Emitter
 {
 public:
 	Emitter(
 		ID3D11Device* device,
+		int maxParticles,
 		SimpleVertexShader* vs,
 		SimplePixelShader* ps,
 		ID3D11ShaderResourceView* texture,
@@ -39,20 +52,47 @@ public:
 
 	void Update(float dt);
 
-	void UpdateSingleParticle(float dt, int index);
+	// Update split into stages so the particle simulation can be spread across threads
+	// BeginUpdate splits the live particles into chunks, UpdateChunk simulates one chunk
+	// (safe to call for different chunks at once) and EndUpdate retires and spawns particles
+	// Running every chunk in any order or on any thread gives the same result as Update
+	int BeginUpdate(float dt);
+	void UpdateChunk(int chunk);
+	void EndUpdate();
+
+	// Updates a contiguous run of the ring four particles at a time, returning how many died
+	int UpdateParticleRange(float dt, int start, int end);
+	int UpdateSingleParticle(float dt, int index);
+	void CollideParticleRange(int start, int end);
 	void SpawnParticle();
 
 	void CopyParticlesToGPU(ID3D11DeviceContext* context);
-	void CopyOneParticle(int index);
+	// Writes every living particle into an array of maxParticles instances at the positions the draw calls read from
+	// (their ring slots, or packed from the start in drawing order when depth sorted), leaving every other slot alone
+	void WriteInstances(ParticleInstance* instances);
+	void CopyOneParticle(ParticleInstance* instance, int index);
+
+	// Puts the living particles in drawing order, farthest from the camera first, for the next WriteInstances
+	// Draw does this itself when depth sorted, it's public so the sort can be timed on its own
+	void SortParticlesByDepth(DirectX::XMFLOAT4X4 viewMatrix);
 	void Draw(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
 
+	// Queues a burst of particles at a world position, spawned on the next update
+	// Every queued burst keeps its own origin, so any number of them share this emitter's ring and draw call
 	void Explode(DirectX::XMFLOAT3 position);
-	void SpawnExplosionParticle();
+	void SpawnExplosionParticle(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 velocity);
 
 	DirectX::XMFLOAT3 GetEmitterPosition();
+	int GetMaxParticles();
+	int GetLivingParticleCount();
+	bool GetFollowEmitter();
 
 	#pragma region setters
+	// Reallocates the particle streams and instance buffer, keeping the youngest living particles that fit
 	void SetMaxParticles(int _maxParticles);
+	void SetBurstSize(int _burstSize);
+	// Multiplies the emission rate and burst size, used by the particle budget to thin out emitters
+	void SetSpawnScale(float _spawnScale);
 	void SetParticlesPerSecod(int _particlesPerSecond);
 	void SetLifetime(float _lifetime);
 	void SetStartSize(float _startSize);
@@ -62,10 +102,63 @@ public:
 	void SetEmitterVelocity(DirectX::XMFLOAT3 _startVelocity);
 	void SetEmitterPosition(DirectX::XMFLOAT3 _emitterPosition);
 	void SetEmitterAcceleration(DirectX::XMFLOAT3 _emitterAcceleration);
+	void SetFollowEmitter(bool _followEmitter);
+	void SetRandomSeed(unsigned int seed);
+	// Sorted emitters draw their particles back to front every frame, so they can use alpha blending
+	void SetDepthSorted(bool _depthSorted);
+	void SetBlendState(ID3D11BlendState* _particleBlendState);
+	void SetJobPool(JobPool* _jobPool); // Optional, spreads the depth sort across threads
+	// Particles test themselves against the given colliders every update, which must not change while emitters update
+	void SetCollision(ParticleCollision _collisionMode, ParticleColliderGrid* _colliders);
+	void SetBounciness(float _bounciness); // Fraction of the inward speed kept by a bounce
 	#pragma endregion
 
 private:
+	// This emitter's own random numbers, so spawning never depends on (or races with) anything else
+	Random random;
+	std::vector<float> burstRandoms; // Reusable storage for bulk generated burst directions
+
+	// Resets the first dead particle to a newly spawned one moving at the given velocity from the given origin
+	void InitParticle(DirectX::XMFLOAT3 velocity, DirectX::XMFLOAT3 origin);
+
+	// An explosion waiting to be spawned
+	struct ParticleBurst
+	{
+		DirectX::XMFLOAT3 origin;
+	};
+	std::vector<ParticleBurst> queuedBursts;
+
+	// Spawns every queued burst, sharing out the free particles evenly when there isn't room for them all
+	void SpawnQueuedBursts();
+
+	// A run of the ring simulated as one unit of work, and how many of its particles died
+	struct ParticleChunk
+	{
+		int start;
+		int end;
+		int deadCount;
+	};
+	std::vector<ParticleChunk> updateChunks;
+	float updateDeltaTime;
+
+	// Splits a contiguous run of the ring into chunks
+	void AddUpdateChunks(int start, int end);
+
+	// Depth sorting
+	bool depthSorted;
+	JobPool* jobPool;
+	RadixSort depthSort;
+	std::vector<unsigned int> depthKeys; // Quantized view depth of each living particle
+	std::vector<unsigned int> sortedIndices; // Ring indices of the living particles in drawing order
+
+	// World collision
+	ParticleCollision collisionMode;
+	ParticleColliderGrid* colliders;
+	float bounciness;
+
 	// Emission properties
+	int burstSize; // Particles spawned by each Explode call
+	float spawnScale; // Fraction of the emission rate and burst size actually spawned
 	int particlesPerSecond;
 	float secondsPerParticle;
 	float timeSinceEmit;
@@ -75,26 +168,45 @@ private:
 
 	DirectX::XMFLOAT3 emitterAcceleration;
 	DirectX::XMFLOAT3 emitterPosition;
+	bool followEmitter; // Whether living particles move along with the emitter or stay where they spawned
 	DirectX::XMFLOAT3 startVelocity;
 	DirectX::XMFLOAT4 startColor;
 	DirectX::XMFLOAT4 endColor;
 	float startSize;
 	float endSize;
 
-	// Particle array
-	Particle* particles;
+	// Particle streams, kept as separate arrays so the update can work on four particles per instruction
+	// Index i of every stream together makes up particle i of the ring buffer
+	std::vector<float> ages;
+	std::vector<float> startVelocityX;
+	std::vector<float> startVelocityY;
+	std::vector<float> startVelocityZ;
+	std::vector<float> originX; // Spawn position, relative to the emitter when following it
+	std::vector<float> originY;
+	std::vector<float> originZ;
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> colorR;
+	std::vector<float> colorG;
+	std::vector<float> colorB;
+	std::vector<float> colorA;
+	std::vector<float> sizes;
+	std::vector<float> visibility; // 1 normally, 0 once killed by a collision (scales the size)
 	int maxParticles;
 	int firstDeadIndex;
 	int firstAliveIndex;
 
 	// Rendering
-	ParticleVertex* localParticleVertices;
-	ID3D11Buffer* vertexBuffer;
-	ID3D11Buffer* indexBuffer;
+	ID3D11Device* device; // Kept to recreate the instance buffer when the capacity changes
+	ID3D11Buffer* instanceBuffer;
 
 	ID3D11ShaderResourceView* texture;
 	SimpleVertexShader* vs;
 	SimplePixelShader* ps;
+	const SimpleShaderVariable* viewVariable; // Shader slots looked up once instead of by name every draw
+	const SimpleShaderVariable* projectionVariable;
+	const SimpleSRV* textureSlot;
 
 	// Blend and depth states
 	ID3D11DepthStencilState* particleDepthState;
@@ -3,45 +3,44 @@
 // For the DirectX Math library
 using namespace DirectX;
 
-Entity::Entity(Mesh* mesh, Material* material, int type)
+Entity::Entity(Mesh* mesh, Material* material, int type, TransformStore* transforms)
 {
 	// Use the passed in mesh and material
 	this->mesh = mesh;
 	this->material = material;
 	this->type = type;
 
-	// Set the location and movement vectors and matrix to default values
-	position = XMFLOAT3(0, 0, 0);
-	rotation = XMFLOAT3(0, 0, 0);
-	scale = XMFLOAT3(1, 1, 1);
-	velocity = XMFLOAT3(0, 0, 0);
+	// Grab a slot in the transform store, which starts at the origin, unscaled and at rest
+	this->transforms = transforms;
+	transformIndex = transforms->Allocate();
+
+	// Set the movement vectors to default values
 	direction = XMFLOAT3(0, 0, 1);
 	maxSpeed = 0;
 
-	worldMatrix = GetIdentityMatrix();
-
 	speed = 0.0f;
 	moveDir = XMVECTOR();
 
 	// Assign the default collider from the mesh to the entity
 	this->collider = mesh->GetCollider(ColliderKey());
-	
-	isWorldDirty = false;
 }
 
 Entity::Entity(Entity const & other)
 {
 	mesh = other.mesh;
 	material = other.material;
-	position = other.position;
-	rotation = other.rotation;
-	scale = other.scale;
-	velocity = other.velocity;
+	type = other.type;
 	direction = other.direction;
 	maxSpeed = other.maxSpeed;
 	collider = other.collider;
-	worldMatrix = other.worldMatrix;
-	isWorldDirty = other.isWorldDirty;
+
+	// Copies get their own transform slot holding the same values
+	transforms = other.transforms;
+	transformIndex = transforms->Allocate();
+	transforms->SetPosition(transformIndex, transforms->GetPosition(other.transformIndex));
+	transforms->SetRotation(transformIndex, transforms->GetRotation(other.transformIndex));
+	transforms->SetScale(transformIndex, transforms->GetScale(other.transformIndex));
+	transforms->SetVelocity(transformIndex, transforms->GetVelocity(other.transformIndex));
 }
 
 Entity & Entity::operator=(Entity const & other)
@@ -51,15 +50,16 @@ Entity & Entity::operator=(Entity const & other)
 		// Switch values
 		mesh = other.mesh;
 		material = other.material;
-		position = other.position;
-		rotation = other.rotation;
-		scale = other.scale;
-		velocity = other.velocity;
+		type = other.type;
 		direction = other.direction;
 		maxSpeed = other.maxSpeed;
 		collider = other.collider;
-		worldMatrix = other.worldMatrix;
-		isWorldDirty = other.isWorldDirty;
+
+		// Copy the transform into this entity's own slot
+		transforms->SetPosition(transformIndex, other.transforms->GetPosition(other.transformIndex));
+		transforms->SetRotation(transformIndex, other.transforms->GetRotation(other.transformIndex));
+		transforms->SetScale(transformIndex, other.transforms->GetScale(other.transformIndex));
+		transforms->SetVelocity(transformIndex, other.transforms->GetVelocity(other.transformIndex));
 	}
 	return *this;
 }
@@ -71,45 +71,39 @@ bool Entity::operator==(Entity const & other)
 
 Entity::~Entity()
 {
+	// Hand the transform slot back to the store
+	transforms->Free(transformIndex);
 }
 
 void Entity::Update(float deltaTime, float totalTime)
 {
-	if (isWorldDirty) {
-		// Update the world matrix based on the position, rotation, and scale
-		XMStoreFloat4x4(&worldMatrix,
-			XMMatrixScaling(scale.x, scale.y, scale.z)*
-			XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) *
-			XMMatrixTranslation(position.x, position.y, position.z));
-		
-
-		isWorldDirty = false;
-	}
+	// Update the world matrix based on the position, rotation, and scale if anything changed
+	transforms->RebuildWorldMatrix(transformIndex);
 }
 
 XMFLOAT4X4 Entity::GetWorldMatrix()
 {
-	return worldMatrix;
+	return transforms->GetWorldMatrix(transformIndex);
 }
 
 XMFLOAT3 Entity::GetPosition()
 {
-	return position;
+	return transforms->GetPosition(transformIndex);
 }
 
 XMFLOAT3 Entity::GetRotation()
 {
-	return rotation;
+	return transforms->GetRotation(transformIndex);
 }
 
 XMFLOAT3 Entity::GetScale()
 {
-	return scale;
+	return transforms->GetScale(transformIndex);
 }
 
 DirectX::XMFLOAT3 Entity::GetVelocity()
 {
-	return velocity;
+	return transforms->GetVelocity(transformIndex);
 }
 
 DirectX::XMFLOAT3 Entity::GetDirection()
@@ -137,27 +131,34 @@ Mesh* Entity::GetMesh()
 	return mesh;
 }
 
+Material* Entity::GetMaterial()
+{
+	return material;
+}
+
+unsigned int Entity::GetTransformIndex()
+{
+	return transformIndex;
+}
+
 void Entity::SetWorldMatrix(XMFLOAT4X4 worldMatrix)
 {
-	this->worldMatrix = worldMatrix;
+	transforms->SetWorldMatrix(transformIndex, worldMatrix);
 }
 
 void Entity::SetPosition(XMFLOAT3 position)
 {
-	isWorldDirty = true;
-	this->position = position;
+	transforms->SetPosition(transformIndex, position);
 }
 
 void Entity::SetRotation(XMFLOAT3 rotation)
 {
-	isWorldDirty = true;
-	this->rotation = rotation;
+	transforms->SetRotation(transformIndex, rotation);
 }
 
 void Entity::SetScale(XMFLOAT3 scale)
 {
-	isWorldDirty = true;
-	this->scale = scale;
+	transforms->SetScale(transformIndex, scale);
 
 	// only scale in one direction as our circle is a circle, not an oval
 	// currently not working Do Not Attempt
@@ -166,14 +167,18 @@ void Entity::SetScale(XMFLOAT3 scale)
 
 void Entity::SetUniformScale(float scale)
 {
-	isWorldDirty = true;
-	this->scale = XMFLOAT3(scale, scale, scale);
+	transforms->SetScale(transformIndex, XMFLOAT3(scale, scale, scale));
 
 	// only scale in one direction as our circle is a circle, not an oval
 	// currently not working Do Not Attempt
 	collider.SetRadius(collider.GetRadius() * scale);
 }
 
+void Entity::SetVelocity(DirectX::XMFLOAT3 velocity)
+{
+	transforms->SetVelocity(transformIndex, velocity);
+}
+
 void Entity::SetDirection(DirectX::XMFLOAT3 direction)
 {
 	this->direction = direction;
@@ -186,15 +191,17 @@ void Entity::SetMesh(Mesh* mesh)
 
 void Entity::Move(XMFLOAT3 direction, XMFLOAT3 velocity)
 {
-	isWorldDirty = true;
+	XMFLOAT3 position = GetPosition();
 	XMVECTOR initialPos = XMLoadFloat3(&position);
 	XMVECTOR movement = XMVector3Rotate(XMLoadFloat3(&velocity), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&direction)));
 	XMStoreFloat3(&position, initialPos + movement);
+	SetPosition(position);
 }
 
 void Entity::MoveForward(XMFLOAT3 velocity, float dTime)
 {
-	isWorldDirty = true;
+	XMFLOAT3 position = GetPosition();
+	XMFLOAT3 rotation = GetRotation();
 	XMVECTOR initialPos = XMLoadFloat3(&position);
 
 	moveDir += XMVector3Rotate(XMLoadFloat3(&velocity), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation)));
@@ -221,15 +228,16 @@ void Entity::MoveForward(XMFLOAT3 velocity, float dTime)
 	}
 
 	XMStoreFloat3(&position, initialPos + moveDir);
-
+	SetPosition(position);
 }
 
 void Entity::RotateBy(DirectX::XMFLOAT3 deltaRotation)
 {
-	isWorldDirty = true;
+	XMFLOAT3 rotation = GetRotation();
 	rotation.x += deltaRotation.x;
 	rotation.y += deltaRotation.y;
 	rotation.z += deltaRotation.z;
+	SetRotation(rotation);
 }
 
 XMFLOAT4X4 Entity::GetIdentityMatrix()
@@ -237,68 +245,4 @@ XMFLOAT4X4 Entity::GetIdentityMatrix()
 	XMFLOAT4X4 identityMatrix = XMFLOAT4X4();
 	XMStoreFloat4x4(&identityMatrix, XMMatrixIdentity());
 	return identityMatrix;
-}
-
-void Entity::Draw(ID3D11DeviceContext* context, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
-{
-	// Prepare the entity's material
-	PrepareMaterial(viewMatrix, projectionMatrix);
-
-	// Set buffers in the input assembler
-	//  - Do this ONCE PER OBJECT you're drawing, since each object might
-	//    have different geometry.
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	ID3D11Buffer* vBuffer = GetMesh()->GetVertexBuffer();
-	context->IASetVertexBuffers(0, 1, &vBuffer, &stride, &offset);
-	context->IASetIndexBuffer(GetMesh()->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-
-	// Finally do the actual drawing
-	//  - Do this ONCE PER OBJECT you intend to draw
-	//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
-	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-	//     vertices in the currently set VERTEX BUFFER
-	context->DrawIndexed(
-		GetMesh()->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
-}
-
-void Entity::PrepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
-{
-	// Send data to shader variables
-	//  - Do this ONCE PER OBJECT you're drawing
-	//  - This is actually a complex process of copying data to a local buffer
-	//    and then copying that entire buffer to the GPU.  
-	//  - The "SimpleShader" class handles all of that for you.
-
-	// Send the world, view, and projection matrices to the vertex shader
-	material->GetVertexShader()->SetMatrix4x4("view", viewMatrix);
-	material->GetVertexShader()->SetMatrix4x4("projection", projectionMatrix);
-	XMFLOAT4X4 worldMatrixTranspose;
-	XMStoreFloat4x4(&worldMatrixTranspose, XMMatrixTranspose(XMLoadFloat4x4(&GetWorldMatrix())));
-	material->GetVertexShader()->SetMatrix4x4("world", worldMatrixTranspose);
-
-	// Send the texture information to the pixel shader
-	material->GetPixelShader()->SetSamplerState("samplerState", material->GetSamplerState());
-	material->GetPixelShader()->SetShaderResourceView("textureBaseColor", material->GetShaderResourceViewBaseColor());
-
-	// Ensure that the normal texture exists before sending it over to the pixel shader
-	if (material->GetShaderResourceViewNormal() != nullptr)
-	{
-		material->GetPixelShader()->SetShaderResourceView("textureNormal", material->GetShaderResourceViewNormal());
-	}
-
-	// Once you've set all of the data you care to change for
-	// the next draw call, you need to actually send it to the GPU
-	//  - If you skip this, the "SetMatrix" calls above won't make it to the GPU!
-	material->GetVertexShader()->CopyAllBufferData();
-	material->GetPixelShader()->CopyAllBufferData(); 
-
-	// Set the vertex and pixel shaders to use for the next Draw() command
-	//  - These don't technically need to be set every frame...YET
-	//  - Once you start applying different shaders to different objects,
-	//    you'll need to swap the current shaders before each draw
-	material->GetVertexShader()->SetShader();
-	material->GetPixelShader()->SetShader();
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "Material.h"
 #include "Collider.h"
 #include "Emitter.h"
+#include "TransformStore.h"
 
 // --------------------------------------------------------
 // A Entity class that represents a singular game object
@@ -12,13 +13,14 @@
 class Entity
 {
 public:
-	Entity(Mesh* mesh, Material* material, int type); // Constructor
+	Entity(Mesh* mesh, Material* material, int type, TransformStore* transforms); // Constructor
 	Entity(Entity const& other); // Copy Constructor
 	Entity& operator=(Entity const& other); // Copy Assignment Operator
 	bool operator==(Entity const& other);
 	~Entity(); // Destructor
 
 	// Updates the game object
+	// Plain movement is integrated by the TransformStore, so only entities with behaviour override this
 	void virtual Update(float deltaTime, float totalTime);
 
 	// GET methods
@@ -32,6 +34,8 @@ public:
 	int GetType();
 	Collider GetCollider();
 	Mesh* GetMesh();
+	Material* GetMaterial();
+	unsigned int GetTransformIndex();
 
 	// SET methods
 	void SetWorldMatrix(DirectX::XMFLOAT4X4 worldMatrix);
@@ -39,6 +43,7 @@ public:
 	void SetRotation(DirectX::XMFLOAT3 rotation);
 	void SetScale(DirectX::XMFLOAT3 scale);
 	void SetUniformScale(float scale);
+	void SetVelocity(DirectX::XMFLOAT3 velocity);
 	void SetDirection(DirectX::XMFLOAT3 direction);
 	void SetMesh(Mesh* mesh);
 
@@ -49,8 +54,6 @@ public:
 
 	// Helper methods
 	DirectX::XMFLOAT4X4 GetIdentityMatrix();
-	void virtual Draw(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
-	void PrepareMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
 
 	float speed;
 	DirectX::XMVECTOR moveDir;
@@ -64,22 +67,14 @@ private:
 
 protected:
 
-	// World Matrix representing the entitys current position, rotation, and scale
-	DirectX::XMFLOAT4X4 worldMatrix;
+	// Store holding this entity's position, rotation, scale, velocity and world matrix
+	TransformStore* transforms;
+	unsigned int transformIndex;
 
-	// Position, Rotation, Scale Vectors
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 rotation;
-	DirectX::XMFLOAT3 scale;
-
-	// Velocity, direction, and Max Speed for movement of entities
-	DirectX::XMFLOAT3 velocity;
+	// Direction and Max Speed for movement of entities
 	DirectX::XMFLOAT3 direction;
 	float maxSpeed;
 
-	// Boolean for if the world matrix needs to be recalculated
-	bool isWorldDirty;
-
 	// Entity Mesh
 	Mesh* mesh;
 
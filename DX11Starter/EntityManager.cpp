@@ -1,5 +1,9 @@
 #include "EntityManager.h"
 #include "Player.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <cstring>
 
 // For the C++ standard library
 using namespace std;
@@ -7,10 +11,24 @@ using namespace std;
 // For the DirectX Math library
 using namespace DirectX;
 
-EntityManager::EntityManager()
+EntityManager::EntityManager() :
+	broadphase(10.0f), // Cells roughly the size of a small building keep asteroid and bullet queries to a handful of cells
+	particleColliders(10.0f)
 {
+	// Instantiate the entity storage
+	entities = vector<SmartEntity>();
+	entitySlots = vector<EntitySlot>();
+	freeEntitySlots = vector<unsigned int>();
+	entityNames = unordered_map<string, EntityHandle>();
+	bulletPool = vector<EntityHandle>();
+	nextBullet = 0;
+	renderCounters = {};
+	instanceBuffer = nullptr;
+	instanceBufferCapacity = 0;
+	frameBuffer = nullptr;
+	frameConstants = {};
+
 	// Instantiate the Maps
-	entities = map<string, SmartEntity>();
 	meshes = map<string, SmartMesh>();
 	materials = map<string, SmartMaterial>();
 	vertexShaders = map<string, SmartVertexShader>();
@@ -22,18 +40,20 @@ EntityManager::EntityManager()
 // Cleans up all remaing items in the manager
 EntityManager::~EntityManager()
 {
+	// Let any in flight loads land so their resources are cleaned up below
+	assetLoader.WaitForAll();
+
+	if (instanceBuffer) { instanceBuffer->Release(); }
+	if (frameBuffer) { frameBuffer->Release(); }
+
+	// Remove all existing entities from the back of the dense array so nothing needs to be swapped
+	bulletPool.clear();
+	while (!entities.empty())
+		RemoveEntity(entities.back().handle);
+
 	// Create a vector to hold the names of resources to delete
 	vector<string> names = vector<string>();
 
-	// Get all existing entity names
-	for (auto& entity : entities)
-		names.push_back(entity.first);
-	// Remove all existing entities
-	for (std::vector<Entity>::size_type i = 0; i != names.size(); i++)
-		RemoveEntity(names[i]);
-	// Clear the list of names
-	names.clear();
-
 	// Get all existing mesh names
 	for (auto& mesh : meshes)
 		names.push_back(mesh.first);
@@ -100,82 +120,258 @@ EntityManager::~EntityManager()
 
 bool EntityManager::UpdateEntities(float deltaTime, float totalTime, int * asteroidCount, Emitter* explosionEmitter)
 {
+	// Integrate velocities and rebuild dirty world matrices for every entity in one batched pass
+	transforms.UpdateTransforms(deltaTime);
+
+	// Bring the broadphase up to date with anything that moved outside of this loop
+	// Order keys are dense indices so a candidate's order key leads straight back to its smart entity
+	for (unsigned int i = 0; i < entities.size(); i++)
+	{
+		AddToBroadphase(i);
+	}
+
 	// Run the update method on all entities
-	for (auto& entity : entities)
+	// Spawns and removals are queued as commands, so the dense array is stable for the whole loop
+	bool changeScene = false;
+	for (size_t i = 0; i < entities.size(); i++)
 	{
-		entity.second.entity->Update(deltaTime, totalTime);
+		// Only the player has behaviour beyond the batched transform pass
+		Entity* current = entities[i].entity;
+		if (current->GetType() == (int)EntityType::Player)
+			current->Update(deltaTime, totalTime);
 
-		for (auto& other : entities)
+		// Bullets that have flown too long or too far go back to the pool
+		if (current->GetType() == (int)EntityType::Bullet)
 		{
+			Bullet* bullet = (Bullet*)current;
+			if (bullet->IsActive() && bullet->HasExpired(deltaTime))
+				bullet->Deactivate();
+			continue;
+		}
+
+		// Only asteroids and the player react to collisions, so nothing else needs to look for them
+		EntityType reactsTo;
+		if (current->GetType() == (int)EntityType::Asteroid) reactsTo = EntityType::Bullet;
+		else if (current->GetType() == (int)EntityType::Player) reactsTo = EntityType::Asteroid;
+		else continue;
+
+		// Refresh this entity's cells in case its update moved it and gather everything near it
+		AddToBroadphase((unsigned int)i);
+		XMFLOAT3 position = current->GetPosition();
+		broadphase.Query(position.x, position.z, current->GetCollider().GetRadius(), broadphaseCandidates);
+
+		for (size_t c = 0; c < broadphaseCandidates.size(); c++)
+		{
+			Entity* other = broadphaseCandidates[c];
+			if (other->GetType() != (int)reactsTo)
+				continue;
+
+			// Bullets sitting in the pool are parked where they expired and can't hit anything
+			if (reactsTo == EntityType::Bullet && !((Bullet*)other)->IsActive())
+				continue;
+
+			// Asteroids destroyed by a bullet earlier this frame are already gone and can't hit the player
+			// The order key is the candidate's dense index, which stays put until the commands are flushed
+			if (reactsTo == EntityType::Asteroid && entities[broadphase.GetOrder(other)].pendingDestroy)
+				continue;
+
 			// if entities are colliding with each other
-			if (CheckForCollision(entity.second.entity, other.second.entity))
+			if (CheckForCollision(current, other))
 			{
-				// TODO: Handle Collision
-				if (entity.second.entity->GetType() == (int)EntityType::Asteroid)
+				if (reactsTo == EntityType::Bullet)
 				{
-					if (other.second.entity->GetType() == (int)EntityType::Bullet)
-					{
-						// create an explosion
-						explosionEmitter->Explode(entity.second.entity->GetPosition());
-
-						// Bullet vs. Asteroid Collision -- Destroy both of them
-						RemoveEntity(entity.first);
-						RemoveEntity(other.first);
-						(*asteroidCount)--;
-
-						if (*asteroidCount <= 0) return true;
-						else return false;
-					}
+					// Asteroids already destroyed this frame can't take part in another hit
+					if (entities[i].pendingDestroy)
+						break;
+
+					// create an explosion
+					explosionEmitter->Explode(current->GetPosition());
+
+					// Bullet vs. Asteroid Collision -- Destroy the asteroid at the end of the frame and recycle the bullet
+					QueueRemoveEntity(entities[i].handle);
+					((Bullet*)other)->Deactivate();
+					(*asteroidCount)--;
+
+					if (*asteroidCount <= 0) changeScene = true;
+
+					// This asteroid is gone, so stop looking for more bullets
+					break;
 				}
-				if (entity.second.entity->GetType() == (int)EntityType::Player)
+				else
 				{
-					if (other.second.entity->GetType() == (int)EntityType::Asteroid)
-					{
-						// Player vs. Asteroid Collision -- signal to change scenes
-						return true;
-					}
+					// Player vs. Asteroid Collision -- signal to change scenes
+					changeScene = true;
+					break;
 				}
-				//cout << entity.first << " is colliding with " << other.first << endl;
 			}
 		}
 	}
-	return false;
+
+	// Apply every spawn and removal recorded during the update at the frame boundary
+	FlushEntityCommands();
+
+	return changeScene;
 }
 
 void EntityManager::DrawEntities(ID3D11DeviceContext* context, Camera* camera, DirectionalLight lights[], int lightCount, ID3D11ShaderResourceView* skySRV)
 {
-	// Draws all entities with lighting
-	for (auto& entity : entities)
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+
+	// Queue every entity by its shaders, material, mesh and view depth
+	// View depth is the third row of the (transposed) view matrix dotted with the position
+	renderQueue.Clear();
+	for (unsigned int i = 0; i < entities.size(); i++)
 	{
-		// Pass the enviromental lights to the pixel shader
-		SimplePixelShader* pixelShader = pixelShaders[materials[entity.second.materialName].pixelShaderName].pixelShader;
-		pixelShader->SetData(
-			"lights", // The name of the variable in the shader
-			lights, // The address of the data to copy
-			sizeof(DirectionalLight) * lightCount); // The size of the data to copy
+		// Skip bullets waiting in the pool
+		Entity* entity = entities[i].entity;
+		if (entity->GetType() == (int)EntityType::Bullet && !((Bullet*)entity)->IsActive())
+			continue;
+
+		XMFLOAT3 position = entity->GetPosition();
+		float depth = position.x * viewMatrix._31 + position.y * viewMatrix._32 + position.z * viewMatrix._33 + viewMatrix._34;
+		renderQueue.Add(i, entity->GetMaterial(), entity->GetMesh(), depth);
+	}
+	renderQueue.Sort(&jobPool);
 
-		// If this is the interior mapping material pass in unique pixel shader data
-		if (entity.second.materialName == "InteriorMapping_Material")
-		{
-			pixelShader->SetShaderResourceView("SkyCube", skySRV);
-			pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
-			pixelShader->SetInt("NumCubeMaps", 8);
+	// Group the sorted entities into one batch per shaders, material and mesh, packing their per instance data
+	instanceBatcher.Clear();
+	for (int q = 0; q < renderQueue.GetCount(); q++)
+	{
+		SmartEntity& entity = entities[renderQueue.GetItem(q)];
 
+		EntityInstance instance = {};
+		instance.World = entity.entity->GetWorldMatrix();
+		if (entity.interiorMapped)
+		{
 			// Base the number of offices off the current scale
-			pixelShader->SetFloat("Offices", (int)entity.second.entity->GetScale().x / 3);
+			instance.Offices = (float)((int)entity.entity->GetScale().x / 3);
+			instance.RandSeed = entity.interiorRandSeed;
+		}
+
+		instanceBatcher.Add(renderQueue.GetStateKey(q), renderQueue.GetItem(q), instance);
+	}
+
+	// Copy every instance into one buffer, growing it if this frame has more than it can hold
+	renderCounters = {};
+	if (instanceBatcher.GetInstanceCount() == 0)
+		return;
+
+	if (instanceBatcher.GetInstanceCount() > instanceBufferCapacity)
+	{
+		if (instanceBuffer) { instanceBuffer->Release(); }
+		instanceBufferCapacity = instanceBatcher.GetInstanceCount() * 2;
+
+		ID3D11Device* device = nullptr;
+		context->GetDevice(&device);
+		D3D11_BUFFER_DESC instanceDesc = {};
+		instanceDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		instanceDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		instanceDesc.Usage = D3D11_USAGE_DYNAMIC;
+		instanceDesc.ByteWidth = sizeof(EntityInstance) * instanceBufferCapacity;
+		device->CreateBuffer(&instanceDesc, 0, &instanceBuffer);
+		device->Release();
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	memcpy(mapped.pData, instanceBatcher.GetInstances(), sizeof(EntityInstance) * instanceBatcher.GetInstanceCount());
+	context->Unmap(instanceBuffer, 0);
+
+	UINT instanceStride = sizeof(EntityInstance);
+	UINT instanceOffset = 0;
+	context->IASetVertexBuffers(1, 1, &instanceBuffer, &instanceStride, &instanceOffset);
+
+	// Camera and lights go into the shared per frame buffer, only copied when they actually changed
+	FrameConstants frame = {};
+	frame.View = viewMatrix;
+	frame.Projection = projectionMatrix;
+	memcpy(frame.Lights, lights, sizeof(DirectionalLight) * min(lightCount, 4));
+	frame.CameraPosition = camera->GetPosition();
+
+	if (memcmp(&frame, &frameConstants, sizeof(FrameConstants)) != 0)
+	{
+		context->UpdateSubresource(frameBuffer, 0, 0, &frame, 0, 0);
+		frameConstants = frame;
+	}
+
+	// Draws every batch with lighting, only changing state when it differs from the previous batch
+	SimpleVertexShader* vertexShader = nullptr;
+	SimplePixelShader* pixelShader = nullptr;
+	Material* currentMaterial = nullptr;
+	ID3D11Buffer* currentVertexBuffer = nullptr;
+	for (int b = 0; b < instanceBatcher.GetBatchCount(); b++)
+	{
+		InstanceBatch batch = instanceBatcher.GetBatch(b);
+		SmartEntity& entity = entities[batch.firstItem];
+		Material* material = entity.entity->GetMaterial();
+		Mesh* mesh = entity.entity->GetMesh();
+
+		// Shaders, which already have the shared per frame buffer in place of their own copy
+		if (material->GetVertexShader() != vertexShader || material->GetPixelShader() != pixelShader)
+		{
+			vertexShader = material->GetVertexShader();
+			pixelShader = material->GetPixelShader();
+
+			vertexShader->SetShader();
+			pixelShader->SetShader();
+
+			// Texture slots belong to the shader, so the next material has to bind its own again
+			currentMaterial = nullptr;
+			renderCounters.shaderChanges++;
+		}
+
+		// Textures and sampler, plus the pixel shader data that's the same for everything with this material
+		if (material != currentMaterial)
+		{
+			currentMaterial = material;
+			pixelShader->SetSamplerState(material->GetSamplerSlot(), material->GetSamplerState());
+			pixelShader->SetShaderResourceView(material->GetBaseColorSlot(), material->GetShaderResourceViewBaseColor());
+
+			// Ensure that the normal texture exists before sending it over to the pixel shader
+			if (material->GetShaderResourceViewNormal() != nullptr)
+				pixelShader->SetShaderResourceView(material->GetNormalSlot(), material->GetShaderResourceViewNormal());
+
+			// The interior mapping material also needs the sky, its per building values are in the instances
+			if (material->GetSkyCubeSlot() != nullptr)
+			{
+				pixelShader->SetShaderResourceView(material->GetSkyCubeSlot(), skySRV);
+				pixelShader->SetInt(material->GetNumCubeMapsVariable(), 8);
+			}
+
+			// Only copied if something in it changed since the last time
+			pixelShader->CopyAllBufferData();
+			renderCounters.materialChanges++;
+		}
+
+		// Geometry, copies of a mesh share their buffers so only a different buffer needs binding
+		if (mesh->GetVertexBuffer() != currentVertexBuffer)
+		{
+			currentVertexBuffer = mesh->GetVertexBuffer();
+			UINT stride = sizeof(Vertex);
+			UINT offset = 0;
+			context->IASetVertexBuffers(0, 1, &currentVertexBuffer, &stride, &offset);
+			context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 
-			// Base the room random generator seed off the building number
-			size_t last_index = entity.first.find_last_not_of("0123456789");
-			string result = entity.first.substr(last_index + 1);
-			pixelShader->SetInt("RandSeed", stoi(result));
+			renderCounters.meshChanges++;
 		}
 
-		// Draw the entity
-		entity.second.entity->Draw(context, camera->GetViewMatrix(), camera->GetProjectionMatrix());
+		// One draw call for every instance in the batch
+		context->DrawIndexedInstanced(mesh->GetIndexCount(), batch.instanceCount, 0, 0, batch.firstInstance);
+		renderCounters.draws++;
+		renderCounters.instances += batch.instanceCount;
 	}
+
+	// Drawing each entity on its own used to set its shaders, material and mesh every time
+	renderCounters.stateChangesAvoided = renderCounters.instances * 3 - (renderCounters.shaderChanges + renderCounters.materialChanges + renderCounters.meshChanges);
+}
+
+RenderStateCounters EntityManager::GetRenderCounters()
+{
+	return renderCounters;
 }
 
-void EntityManager::CreateEntity(string entityName, string meshName, string materialName, EntityType type)
+EntityHandle EntityManager::CreateEntity(string entityName, string meshName, string materialName, EntityType type)
 {
 	// Ensure the specfied mesh exists
 	if (meshes.count(meshName) == 0)
@@ -189,15 +385,19 @@ void EntityManager::CreateEntity(string entityName, string meshName, string mate
 		throw "The specified material: " + materialName + " does not exist.";
 	}
 
+	EntityHandle handle = EntityHandle();
 	switch (type) {
 	case EntityType::Asteroid:
 		{
-			// Create a new asteroid using the given mesh and material and assign it to the entity map
-			entities[entityName] = SmartEntity(
+			// Create a new asteroid using the given mesh and material and add it to the entity array
+			handle = AddEntity(
+				entityName,
 				new Asteroid(
 					GetMesh(meshName),
 					GetMaterial(materialName),
-					(int)EntityType::Asteroid
+					(int)EntityType::Asteroid,
+					&transforms,
+					&random
 				),
 				meshName,
 				materialName);
@@ -205,12 +405,14 @@ void EntityManager::CreateEntity(string entityName, string meshName, string mate
 		break;
 	case EntityType::Base:
 		{
-			// Create a new entity using the given mesh and material and assign it to the entity map
-			entities[entityName] = SmartEntity(
+			// Create a new entity using the given mesh and material and add it to the entity array
+			handle = AddEntity(
+				entityName,
 				new Entity(
 					GetMesh(meshName),
 					GetMaterial(materialName),
-					(int)EntityType::Base
+					(int)EntityType::Base,
+					&transforms
 				),
 				meshName,
 				materialName);
@@ -218,28 +420,18 @@ void EntityManager::CreateEntity(string entityName, string meshName, string mate
 		break;
 	case EntityType::Bullet:
 		{
-			// Create a new bullet using the given mesh and material and assign it to the entity map
-			entities[entityName] = SmartEntity(
+			// Create a new bullet using the given mesh and material and add it to the entity array
+			// Bullets start out inactive and are only launched through FireBullet
+			handle = AddEntity(
+				entityName,
 				new Bullet(
 					GetMesh(meshName),
 					GetMaterial(materialName),
-					(int)EntityType::Bullet
+					(int)EntityType::Bullet,
+					&transforms
 				),
 				meshName,
 				materialName);
-
-			// Set the bullet's position to be slightly in front of the Player and direction to be the same as the Player's
-			XMMATRIX rotation = XMMatrixRotationRollPitchYaw(GetEntity("Player")->GetRotation().x, GetEntity("Player")->GetRotation().y, 0);
-			XMFLOAT4 forward = XMFLOAT4(0, 0, 1, 0);
-			XMVECTOR newForward = XMVector4Transform(XMLoadFloat4(&forward), rotation);
-			XMFLOAT4 playerForward = XMFLOAT4(0, 0, 1, 0);
-			XMStoreFloat4(&playerForward, newForward);
-
-			XMFLOAT3 initialPosition = GetEntity("Player")->GetPosition();
-			initialPosition.x += playerForward.x * 3;
-			initialPosition.z += playerForward.z * 3;
-			entities[entityName].entity->SetPosition(initialPosition);
-			entities[entityName].entity->SetDirection(GetEntity("Player")->GetDirection());
 		}
 		break;
 	//case EntityType::Player:
@@ -258,9 +450,11 @@ void EntityManager::CreateEntity(string entityName, string meshName, string mate
 	//	}
 	//	break;
 	}
+
+	return handle;
 }
 
-void EntityManager::CreateEntityWithEmitter(std::string entityName, std::string meshName, std::string materialName, std::string emitterName, EntityType type)
+EntityHandle EntityManager::CreateEntityWithEmitter(std::string entityName, std::string meshName, std::string materialName, std::string emitterName, EntityType type)
 {
 	// Ensure the specfied mesh exists
 	if (meshes.count(meshName) == 0)
@@ -274,15 +468,19 @@ void EntityManager::CreateEntityWithEmitter(std::string entityName, std::string
 		throw "The specified material: " + materialName + " does not exist.";
 	}
 
+	EntityHandle handle = EntityHandle();
 	switch (type) {
 	case EntityType::Asteroid:
 	{
-		// Create a new asteroid using the given mesh and material and assign it to the entity map
-		entities[entityName] = SmartEntity(
+		// Create a new asteroid using the given mesh and material and add it to the entity array
+		handle = AddEntity(
+			entityName,
 			new Asteroid(
 				GetMesh(meshName),
 				GetMaterial(materialName),
-				(int)EntityType::Asteroid
+				(int)EntityType::Asteroid,
+				&transforms,
+				&random
 			),
 			meshName,
 			materialName);
@@ -290,58 +488,319 @@ void EntityManager::CreateEntityWithEmitter(std::string entityName, std::string
 	break;
 	case EntityType::Player:
 	{
-		// Create a new player using the given mesh and material and assign it to the entity map
-		entities[entityName] = SmartEntity(
-			new Player(
-				GetMesh(meshName),
-				GetMaterial(materialName),
-				(int)EntityType::Player,
-				emitters[emitterName].emitter
-			),
-			meshName,
-			materialName);
-		Player* play = (Player*)GetEntity("Player");
+		// Create a new player using the given mesh and material and add it to the entity array
+		Player* play = new Player(
+			GetMesh(meshName),
+			GetMaterial(materialName),
+			(int)EntityType::Player,
+			emitters[emitterName].emitter,
+			&transforms
+		);
 		play->SetEntityManager(this);
+
+		handle = AddEntity(entityName, play, meshName, materialName);
+		playerHandle = handle;
 	}
 	break;
 	}
+
+	return handle;
 }
 
-void EntityManager::RemoveEntity(string entityName)
+void EntityManager::RemoveEntity(EntityHandle handle)
 {
 	// Ensure the specfied entity exists
-	if (entities.count(entityName) == 0)
+	SmartEntity* smartEntity = GetSmartEntity(handle);
+	if (smartEntity == nullptr)
 	{
-		throw "The specified entity: " + entityName + " does not exist.";
+		throw string("The specified entity handle is no longer valid.");
 	}
 
 	// Decrement the mesh and material reference counts for this entity
-	meshes[entities[entityName].meshName].refCount--;
-	materials[entities[entityName].materialName].refCount--;
+	meshes[smartEntity->meshName].refCount--;
+	materials[smartEntity->materialName].refCount--;
+
+	// Stop tracking the entity in the collision broadphase
+	broadphase.Remove(smartEntity->entity);
 
 	// Delete the entity instance from the heap
-	delete entities[entityName].entity;
+	delete smartEntity->entity;
 
-	// Remove the entity pair from the map
-	entities.erase(entityName);
+	// Remove the name from the name index
+	entityNames.erase(smartEntity->name);
+
+	// Swap the last entity into the removed entity's place and point its slot at the new position
+	unsigned int denseIndex = entitySlots[handle.index].denseIndex;
+	if (denseIndex != entities.size() - 1)
+	{
+		entities[denseIndex] = entities.back();
+		entitySlots[entities[denseIndex].handle.index].denseIndex = denseIndex;
+	}
+	entities.pop_back();
+
+	// Free the slot and bump its generation so any outstanding handles go stale
+	entitySlots[handle.index].denseIndex = UINT_MAX;
+	entitySlots[handle.index].generation++;
+	freeEntitySlots.push_back(handle.index);
+}
+
+void EntityManager::RemoveEntity(string entityName)
+{
+	RemoveEntity(GetEntityHandle(entityName));
+}
+
+Entity* EntityManager::GetEntity(EntityHandle handle)
+{
+	// Ensure the specfied entity exists
+	SmartEntity* smartEntity = GetSmartEntity(handle);
+	if (smartEntity == nullptr)
+	{
+		throw string("The specified entity handle is no longer valid.");
+	}
+
+	// Return the specified entity instance
+	return smartEntity->entity;
 }
 
 Entity* EntityManager::GetEntity(string entityName)
+{
+	return GetEntity(GetEntityHandle(entityName));
+}
+
+EntityHandle EntityManager::GetEntityHandle(string entityName)
 {
 	// Ensure the specfied entity exists
-	if (entities.count(entityName) == 0)
+	auto found = entityNames.find(entityName);
+	if (found == entityNames.end())
 	{
 		throw "The specified entity: " + entityName + " does not exist.";
 	}
 
-	// Return the specified entity instance
-	return entities[entityName].entity;
+	// Return the handle registered under this name
+	return found->second;
+}
+
+bool EntityManager::IsEntityValid(EntityHandle handle)
+{
+	return GetSmartEntity(handle) != nullptr;
+}
+
+void EntityManager::CreateBulletPool(string meshName, string materialName, unsigned int capacity)
+{
+	// Create every bullet up front so firing never has to allocate
+	for (unsigned int i = 0; i < capacity; i++)
+	{
+		bulletPool.push_back(CreateEntity("Bullet_" + to_string(bulletPool.size()), meshName, materialName, EntityType::Bullet));
+	}
+}
+
+void EntityManager::FireBullet()
+{
+	// Ensure there are bullets to fire
+	if (bulletPool.empty())
+	{
+		throw string("The bullet pool has not been created.");
+	}
+
+	// Take the next bullet in line, which is either idle or the oldest one still in flight
+	Bullet* bullet = (Bullet*)GetEntity(bulletPool[nextBullet]);
+	nextBullet = (nextBullet + 1) % bulletPool.size();
+
+	// Set the bullet's position to be slightly in front of the Player and direction to be the same as the Player's
+	Entity* player = GetEntity(playerHandle);
+	XMMATRIX rotation = XMMatrixRotationRollPitchYaw(player->GetRotation().x, player->GetRotation().y, 0);
+	XMFLOAT4 forward = XMFLOAT4(0, 0, 1, 0);
+	XMVECTOR newForward = XMVector4Transform(XMLoadFloat4(&forward), rotation);
+	XMFLOAT4 playerForward = XMFLOAT4(0, 0, 1, 0);
+	XMStoreFloat4(&playerForward, newForward);
+
+	XMFLOAT3 initialPosition = player->GetPosition();
+	initialPosition.x += playerForward.x * 3;
+	initialPosition.z += playerForward.z * 3;
+	bullet->Launch(initialPosition, player->GetDirection());
+}
+
+void EntityManager::QueueCreateEntity(string entityName, string meshName, string materialName, EntityType type)
+{
+	// Record the spawn so it happens at the next flush instead of in the middle of an update
+	EntityCommand command = EntityCommand();
+	command.type = EntityCommandType::Create;
+	command.entityName = entityName;
+	command.meshName = meshName;
+	command.materialName = materialName;
+	command.entityType = type;
+	entityCommands.push_back(command);
+}
+
+void EntityManager::QueueRemoveEntity(EntityHandle handle)
+{
+	// Ignore stale handles and entities that are already on their way out
+	SmartEntity* smartEntity = GetSmartEntity(handle);
+	if (smartEntity == nullptr || smartEntity->pendingDestroy)
+		return;
+
+	// Flag the entity so it is skipped by anything else this frame, and record the removal
+	smartEntity->pendingDestroy = true;
+
+	EntityCommand command = EntityCommand();
+	command.type = EntityCommandType::Remove;
+	command.handle = handle;
+	entityCommands.push_back(command);
+}
+
+void EntityManager::FlushEntityCommands()
+{
+	// Removals go first so spawns can reuse the freed slots, then spawns in the order they were queued
+	for (size_t i = 0; i < entityCommands.size(); i++)
+	{
+		if (entityCommands[i].type == EntityCommandType::Remove && IsEntityValid(entityCommands[i].handle))
+			RemoveEntity(entityCommands[i].handle);
+	}
+	for (size_t i = 0; i < entityCommands.size(); i++)
+	{
+		if (entityCommands[i].type == EntityCommandType::Create)
+			CreateEntity(entityCommands[i].entityName, entityCommands[i].meshName, entityCommands[i].materialName, entityCommands[i].entityType);
+	}
+
+	entityCommands.clear();
+}
+
+EntityHandle EntityManager::AddEntity(string entityName, Entity* entity, string meshName, string materialName)
+{
+	// Replace any existing entity with the same name
+	if (entityNames.count(entityName) != 0)
+	{
+		RemoveEntity(entityNames[entityName]);
+	}
+
+	// Reuse a free slot if one is available, otherwise grow the slot array
+	unsigned int slotIndex;
+	if (!freeEntitySlots.empty())
+	{
+		slotIndex = freeEntitySlots.back();
+		freeEntitySlots.pop_back();
+	}
+	else
+	{
+		slotIndex = (unsigned int)entitySlots.size();
+		entitySlots.push_back(EntitySlot());
+	}
+
+	// Append the entity to the dense array and point the slot at it
+	EntityHandle handle = EntityHandle(slotIndex, entitySlots[slotIndex].generation);
+	entitySlots[slotIndex].denseIndex = (unsigned int)entities.size();
+
+	SmartEntity smartEntity = SmartEntity(entity, meshName, materialName);
+	smartEntity.name = entityName;
+	smartEntity.handle = handle;
+
+	// Base the room random generator seed off the building number, worked out once rather than every draw
+	if (materialName == "InteriorMapping_Material")
+	{
+		size_t last_index = entityName.find_last_not_of("0123456789");
+		smartEntity.interiorMapped = true;
+		smartEntity.interiorRandSeed = stoi(entityName.substr(last_index + 1));
+	}
+	entities.push_back(smartEntity);
+	entityNames[entityName] = handle;
+
+	// Make the new entity visible to the collision broadphase
+	AddToBroadphase(entitySlots[slotIndex].denseIndex);
+
+	return handle;
+}
+
+SmartEntity* EntityManager::GetSmartEntity(EntityHandle handle)
+{
+	// Reject handles that are out of range or whose slot has been reused
+	if (handle.index >= entitySlots.size() || entitySlots[handle.index].generation != handle.generation)
+		return nullptr;
+
+	unsigned int denseIndex = entitySlots[handle.index].denseIndex;
+	if (denseIndex == UINT_MAX)
+		return nullptr;
+
+	return &entities[denseIndex];
+}
+
+void EntityManager::AddToBroadphase(unsigned int denseIndex)
+{
+	// Insert (or refresh) the entity's circle collider in the grid using its dense index as the order key
+	SmartEntity& smartEntity = entities[denseIndex];
+	Entity* entity = smartEntity.entity;
+	XMFLOAT3 position = entity->GetPosition();
+	float radius = entity->GetCollider().GetRadius();
+
+	// Nothing to do for entities that haven't moved or changed place in the dense array since last time
+	if (smartEntity.gridOrder == denseIndex && smartEntity.gridX == position.x &&
+		smartEntity.gridZ == position.z && smartEntity.gridRadius == radius)
+		return;
+
+	broadphase.Insert(entity, position.x, position.z, radius, denseIndex);
+	smartEntity.gridX = position.x;
+	smartEntity.gridZ = position.z;
+	smartEntity.gridRadius = radius;
+	smartEntity.gridOrder = denseIndex;
 }
 
 void EntityManager::CreateMesh(string meshName, ID3D11Device* device, char* objFile)
 {
+	// Share the GPU buffers of any mesh already loaded from the same file instead of loading it again
+	for (auto& mesh : meshes)
+	{
+		if (mesh.second.fileName == objFile)
+		{
+			meshes[meshName] = SmartMesh(new Mesh(*mesh.second.mesh), 0, objFile);
+			return;
+		}
+	}
+
 	// Create a new smart mesh using the passed in parameters and assign it to the mesh map
-	meshes[meshName] = SmartMesh(new Mesh(device, objFile), 0);
+	meshes[meshName] = SmartMesh(new Mesh(device, objFile), 0, objFile);
+}
+
+void EntityManager::CreateMeshAsync(string meshName, ID3D11Device* device, char* objFile)
+{
+	string fileName = objFile;
+
+	// Files that are already loaded can be shared right away
+	for (auto& mesh : meshes)
+	{
+		if (mesh.second.fileName == fileName)
+		{
+			CreateMesh(meshName, device, objFile);
+			return;
+		}
+	}
+
+	// Files that are already on their way just pick up another name
+	if (pendingMeshNames.count(fileName) != 0)
+	{
+		pendingMeshNames[fileName].push_back(meshName);
+		return;
+	}
+	pendingMeshNames[fileName] = vector<string>(1, meshName);
+
+	// Parse (or map the cache of) the OBJ on a worker, then create the buffers on the main thread
+	shared_ptr<Mesh*> loaded = make_shared<Mesh*>(nullptr);
+	assetLoader.QueueJob(
+		[loaded, fileName]()
+		{
+			*loaded = new Mesh((char*)fileName.c_str());
+		},
+		[this, loaded, fileName, device]()
+		{
+			Mesh* mesh = *loaded;
+			mesh->FinishLoading(device);
+
+			// The first name owns the loaded mesh and every other name shares its buffers
+			vector<string>& names = pendingMeshNames[fileName];
+			meshes[names[0]] = SmartMesh(mesh, 0, fileName);
+			for (size_t i = 1; i < names.size(); i++)
+				meshes[names[i]] = SmartMesh(new Mesh(*mesh), 0, fileName);
+
+			pendingMeshNames.erase(fileName);
+		});
 }
 
 void EntityManager::RemoveMesh(string meshName)
@@ -514,6 +973,50 @@ void EntityManager::CreateVertexShader(string vertexShaderName, ID3D11Device* de
 	// Create a new vertex shader using the passed in data and assign it to the vertex shader map
 	vertexShaders[vertexShaderName] = SmartVertexShader(new SimpleVertexShader(device, context), 0);
 	vertexShaders[vertexShaderName].vertexShader->LoadShaderFile(shaderFile);
+	ShareFrameBuffer(vertexShaders[vertexShaderName].vertexShader, device);
+}
+
+void EntityManager::CreateVertexShaderAsync(string vertexShaderName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
+{
+	// Read the compiled shader on a worker, then create and reflect it on the main thread
+	wstring fileName = shaderFile;
+	shared_ptr<ID3DBlob*> blob = make_shared<ID3DBlob*>(nullptr);
+	assetLoader.QueueJob(
+		[blob, fileName]()
+		{
+			D3DReadFileToBlob(fileName.c_str(), blob.get());
+		},
+		[this, blob, fileName, vertexShaderName, device, context]()
+		{
+			// A shader that couldn't be read or created is left out, so anything using it fails to find it
+			SimpleVertexShader* vertexShader = new SimpleVertexShader(device, context);
+			if (!vertexShader->LoadShaderBlob(*blob))
+			{
+				printf("\nCould not load the vertex shader %ls", fileName.c_str());
+				delete vertexShader;
+				return;
+			}
+			ShareFrameBuffer(vertexShader, device);
+			vertexShaders[vertexShaderName] = SmartVertexShader(vertexShader, 0);
+		});
+}
+
+void EntityManager::ShareFrameBuffer(ISimpleShader* shader, ID3D11Device* device)
+{
+	// Made with the first shader rather than while drawing, holding the (empty) frame it starts out matching
+	if (!frameBuffer)
+	{
+		D3D11_BUFFER_DESC frameDesc = {};
+		frameDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		frameDesc.Usage = D3D11_USAGE_DEFAULT;
+		frameDesc.ByteWidth = sizeof(FrameConstants);
+		D3D11_SUBRESOURCE_DATA frameData = {};
+		frameData.pSysMem = &frameConstants;
+		device->CreateBuffer(&frameDesc, &frameData, &frameBuffer);
+	}
+
+	// Shaders without frameData (particles, sky) are left alone
+	shader->SetSharedConstantBuffer("frameData", frameBuffer);
 }
 
 void EntityManager::RemoveVertexShader(string vertexShaderName)
@@ -557,6 +1060,32 @@ void EntityManager::CreatePixelShader(string pixelShaderName, ID3D11Device* devi
 	// Create a new pixel shader using the passed in data and assign it to the pixel shader map
 	pixelShaders[pixelShaderName] = SmartPixelShader(new SimplePixelShader(device, context), 0);
 	pixelShaders[pixelShaderName].pixelShader->LoadShaderFile(shaderFile);
+	ShareFrameBuffer(pixelShaders[pixelShaderName].pixelShader, device);
+}
+
+void EntityManager::CreatePixelShaderAsync(string pixelShaderName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
+{
+	// Read the compiled shader on a worker, then create and reflect it on the main thread
+	wstring fileName = shaderFile;
+	shared_ptr<ID3DBlob*> blob = make_shared<ID3DBlob*>(nullptr);
+	assetLoader.QueueJob(
+		[blob, fileName]()
+		{
+			D3DReadFileToBlob(fileName.c_str(), blob.get());
+		},
+		[this, blob, fileName, pixelShaderName, device, context]()
+		{
+			// A shader that couldn't be read or created is left out, so anything using it fails to find it
+			SimplePixelShader* pixelShader = new SimplePixelShader(device, context);
+			if (!pixelShader->LoadShaderBlob(*blob))
+			{
+				printf("\nCould not load the pixel shader %ls", fileName.c_str());
+				delete pixelShader;
+				return;
+			}
+			ShareFrameBuffer(pixelShader, device);
+			pixelShaders[pixelShaderName] = SmartPixelShader(pixelShader, 0);
+		});
 }
 
 void EntityManager::RemovePixelShader(string pixelShaderName)
@@ -610,6 +1139,48 @@ void EntityManager::CreateShaderResourceView(string shaderResourceViewName, ID3D
 	shaderResourceViews[shaderResourceViewName] = SmartShaderResourceView(shaderResourceView, 0);
 }
 
+void EntityManager::CreateShaderResourceViewAsync(string shaderResourceViewName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR textureFile)
+{
+	// Only the file read happens on a worker, decoding has to stay on the main thread
+	// because generating the mipmaps goes through the immediate context
+	wstring fileName = textureFile;
+	shared_ptr<vector<uint8_t>> data = make_shared<vector<uint8_t>>();
+	assetLoader.QueueJob(
+		[data, fileName]()
+		{
+			ifstream file(fileName.c_str(), ios::binary | ios::ate);
+			if (!file.is_open())
+				return;
+
+			data->resize((size_t)file.tellg());
+			file.seekg(0, ios::beg);
+			file.read((char*)data->data(), data->size());
+		},
+		[this, data, fileName, shaderResourceViewName, device, context]()
+		{
+			// A texture that couldn't be read or decoded is left out, so anything using it fails to find it
+			ID3D11ShaderResourceView* shaderResourceView = 0;
+			HRESULT result = E_FAIL;
+			if (!data->empty())
+			{
+				result = CreateWICTextureFromMemory(
+					device,								// Application Device
+					context,							// Application Device Context (necesary for auto generation of mipmaps)
+					data->data(),						// Bytes of the external texture file
+					data->size(),						// Size of the external texture file
+					0,									// Reference to the texture which we don't need so we pass in 0
+					&shaderResourceView);				// Address to the Shader Resource View pointer which we pass to the shader later
+			}
+
+			if (FAILED(result) || !shaderResourceView)
+			{
+				printf("\nCould not load the texture %ls", fileName.c_str());
+				return;
+			}
+			shaderResourceViews[shaderResourceViewName] = SmartShaderResourceView(shaderResourceView, 0);
+		});
+}
+
 void EntityManager::CreateInteriorMappingDDSShaderResourceView(std::string shaderResourceViewName, ID3D11Device * device, ID3D11DeviceContext * context, LPCWSTR * textureFiles, int textureFileCount)
 {
 	// Load all of the interior cube maps
@@ -774,17 +1345,105 @@ void EntityManager::RemoveSamplerState(string samplerStateName)
 	samplerStates.erase(samplerStateName);
 }
 
-void EntityManager::CreateEmitter(std::string emitterName, ID3D11Device * device, std::string vs, std::string ps, std::string texture, ID3D11DepthStencilState* particleDepthState, ID3D11BlendState* particleBlendState)
+void EntityManager::UpdateAssetLoading()
+{
+	// Create the device objects for everything the workers have finished with
+	assetLoader.ProcessCompletedJobs();
+}
+
+bool EntityManager::IsLoadingAssets()
+{
+	return assetLoader.IsLoading();
+}
+
+float EntityManager::GetAssetLoadingProgress()
+{
+	return assetLoader.GetProgress();
+}
+
+void EntityManager::UpdateEmitters(float deltaTime, XMFLOAT3 viewPosition)
+{
+	// Snapshot the colliders particles can hit, the grid then stays untouched while the chunks read it
+	particleColliders.Clear();
+	for (size_t i = 0; i < entities.size(); i++)
+	{
+		Entity* entity = entities[i].entity;
+		if (entity->GetType() != (int)EntityType::Base && entity->GetType() != (int)EntityType::Asteroid)
+			continue;
+		if (!entity->GetCollider().GetEnabled())
+			continue;
+
+		XMFLOAT3 position = entity->GetPosition();
+		particleColliders.AddCollider(position.x, position.z, entity->GetCollider().GetRadius());
+	}
+	particleColliders.Build();
+
+	// The budget's timer starts after the grid is built, since that cost depends on the buildings and asteroids, not the particles
+	particleBudget.BeginFrame(viewPosition);
+
+	// Gather the chunks of every emitter due an update into one list so small emitters don't leave threads idle
+	emitterJobs.clear();
+	updatingEmitters.clear();
+	for (auto& emitter : emitters)
+	{
+		float updateTime = particleBudget.PlanEmitter(emitter.second.emitter, deltaTime);
+		if (updateTime <= 0.0f)
+			continue;
+
+		updatingEmitters.push_back(emitter.second.emitter);
+		int chunkCount = emitter.second.emitter->BeginUpdate(updateTime);
+		for (int i = 0; i < chunkCount; i++)
+			emitterJobs.push_back(pair<Emitter*, int>(emitter.second.emitter, i));
+	}
+
+	// Chunks are independent of each other, so they can run on any thread in any order
+	jobPool.ParallelFor((int)emitterJobs.size(), [this](int job)
+	{
+		emitterJobs[job].first->UpdateChunk(emitterJobs[job].second);
+	});
+
+	// Retiring and spawning only touch each emitter's own particles and random numbers, so emitters can finish in parallel too
+	jobPool.ParallelFor((int)updatingEmitters.size(), [this](int job)
+	{
+		updatingEmitters[job]->EndUpdate();
+	});
+
+	particleBudget.EndFrame();
+}
+
+ParticleBudget* EntityManager::GetParticleBudget()
+{
+	return &particleBudget;
+}
+
+ParticleColliderGrid* EntityManager::GetParticleColliders()
+{
+	return &particleColliders;
+}
+
+void EntityManager::CreateEmitter(std::string emitterName, ID3D11Device * device, int maxParticles, std::string vs, std::string ps, std::string texture, ID3D11DepthStencilState* particleDepthState, ID3D11BlendState* particleBlendState)
 {
 	emitters[emitterName] = SmartEmitter(
 		new Emitter(
 			device, 
+			maxParticles,
 			vertexShaders[vs].vertexShader,
 			pixelShaders[ps].pixelShader,
 			shaderResourceViews[texture].shaderResourceView,
 			particleDepthState, 
 			particleBlendState
 		));
+
+	// Every emitter draws its own seed from the manager, so the same manager seed always gives the same particles
+	emitters[emitterName].emitter->SetRandomSeed(random.NextUInt());
+
+	// Depth sorted emitters share the manager's threads for their sort
+	emitters[emitterName].emitter->SetJobPool(&jobPool);
+}
+
+void EntityManager::SetRandomSeed(unsigned int seed)
+{
+	random.Seed(seed);
 }
 
 void EntityManager::RemoveEmitter(std::string emitterName)
@@ -796,6 +1455,7 @@ void EntityManager::RemoveEmitter(std::string emitterName)
 	}
 
 	// Delete the entity instance from the heap
+	particleBudget.RemoveEmitter(emitters[emitterName].emitter);
 	delete emitters[emitterName].emitter;
 
 	// Remove the entity pair from the map
@@ -2,11 +2,22 @@
 #ifndef EntityManager_Included
 #define EntityManager_Included
 
+#include <climits>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
 #include "Entity.h"
 #include "Asteroid.h"
 #include "Bullet.h"
+#include "SpatialGrid.h"
+#include "ParticleBudget.h"
+#include "RenderQueue.h"
+#include "InstanceBatcher.h"
+#include "TransformStore.h"
+#include "AssetLoader.h"
+#include "JobPool.h"
+#include "Random.h"
 #include "Mesh.h"
 #include "Material.h"
 #include "Camera.h"
@@ -22,18 +33,73 @@ enum class EntityType
 	Bullet = 4
 };
 
+// Struct representing a generational handle to an entity in the manager
+// A handle whose slot has since been reused by another entity is rejected
+struct EntityHandle
+{
+	// Constructors
+	EntityHandle() : index(UINT_MAX), generation(0) { }
+	EntityHandle(unsigned int index, unsigned int generation) : index(index), generation(generation) { }
+
+	bool operator==(EntityHandle const& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(EntityHandle const& other) const { return !(*this == other); }
+
+	// Members
+	unsigned int index; // Index of the slot this handle refers to
+	unsigned int generation; // Generation of the slot when the handle was issued
+};
+
 #pragma region Smart Structs
 // Struct representing a smart entity
 struct SmartEntity
 {
 	// Constructors
 	SmartEntity() { }
-	SmartEntity(Entity* entity, std::string meshName, std::string materialName) : entity(entity), meshName(meshName), materialName(materialName) { }
+	SmartEntity(Entity* entity, std::string meshName, std::string materialName) : entity(entity), meshName(meshName), materialName(materialName), pendingDestroy(false), interiorMapped(false), interiorRandSeed(0), gridX(0), gridZ(0), gridRadius(0), gridOrder(UINT_MAX) { }
 
 	// Members
 	Entity* entity; // Entity Pointer
 	std::string meshName; // Name of the mesh this entity utilizes
 	std::string materialName; // Name of the material this entity utilizes
+	std::string name; // Name the entity was created with
+	EntityHandle handle; // Handle that refers to this entity
+	bool pendingDestroy; // Whether a removal has been queued for this entity
+	bool interiorMapped; // Whether this entity uses the interior mapping material
+	int interiorRandSeed; // Room seed for interior mapping, taken from the number ending the name
+	float gridX; // Collider last given to the broadphase, so unmoved entities can skip refreshing it
+	float gridZ;
+	float gridRadius;
+	unsigned int gridOrder;
+};
+
+// Kinds of deferred structural changes to the entity set
+enum class EntityCommandType
+{
+	Create = 1,
+	Remove = 2
+};
+
+// Struct representing a spawn or removal recorded during an update and applied at the frame boundary
+struct EntityCommand
+{
+	// Members
+	EntityCommandType type; // Whether this command creates or removes an entity
+	EntityHandle handle; // Entity to remove
+	std::string entityName; // Name of the entity to create
+	std::string meshName; // Mesh of the entity to create
+	std::string materialName; // Material of the entity to create
+	EntityType entityType; // Type of the entity to create
+};
+
+// Struct representing an indirection slot that entity handles point at
+struct EntitySlot
+{
+	// Constructors
+	EntitySlot() : denseIndex(UINT_MAX), generation(0) { }
+
+	// Members
+	unsigned int denseIndex; // Index of the entity in the dense entity array (UINT_MAX when the slot is free)
+	unsigned int generation; // Bumped every time the slot is freed so old handles go stale
 };
 
 // Struct representing a smart mesh
@@ -42,10 +108,12 @@ struct SmartMesh
 	// Constructors
 	SmartMesh() { }
 	SmartMesh(Mesh* mesh, unsigned int refCount) : mesh(mesh), refCount(refCount) { }
+	SmartMesh(Mesh* mesh, unsigned int refCount, std::string fileName) : mesh(mesh), refCount(refCount), fileName(fileName) { }
 
 	// Members
 	Mesh* mesh; // Mesh Pointer
 	unsigned int refCount; // Number of references to this mesh
+	std::string fileName; // OBJ file the mesh was loaded from
 };
 
 // Struct representing a smart material
@@ -138,6 +206,18 @@ struct SmartSamplerState
 };
 #pragma endregion
 
+// Data that stays the same for every entity drawn in a frame, copied once into
+// a constant buffer shared by all of the entity shaders
+// Must match the layout of the frameData cbuffer in those shaders
+struct FrameConstants
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectionalLight Lights[4]; // The size of this array should match the shaders' light array
+	DirectX::XMFLOAT3 CameraPosition;
+	float Padding;
+};
+
 class EntityManager
 {
 public:
@@ -150,18 +230,36 @@ public:
 	// its ok
 	bool UpdateEntities(float deltaTime, float totalTime, int * asteroidCount, Emitter * explosionEmitter);
 
-	// Draws all entities with lighting
+	// Draws all entities with lighting, sorted so shaders, materials and meshes are only bound when they change
+	// Entities sharing all three are drawn together with one instanced draw call
 	void DrawEntities(ID3D11DeviceContext* context, Camera* camera, DirectionalLight lights[], int lightCount, ID3D11ShaderResourceView* skySRV);
+	RenderStateCounters GetRenderCounters(); // Binding done by the last DrawEntities
 
 	#pragma region Public Helper Methods
 	// Entity Helper Methods
-	void CreateEntity(std::string entityName, std::string meshName, std::string materialName, EntityType type);
-	void CreateEntityWithEmitter(std::string entityName, std::string meshName, std::string materialName, std::string emitterName, EntityType type);
+	EntityHandle CreateEntity(std::string entityName, std::string meshName, std::string materialName, EntityType type);
+	EntityHandle CreateEntityWithEmitter(std::string entityName, std::string meshName, std::string materialName, std::string emitterName, EntityType type);
+	void RemoveEntity(EntityHandle handle);
+	Entity* GetEntity(EntityHandle handle);
+	bool IsEntityValid(EntityHandle handle);
+
+	// Deferred entity helpers, safe to call while entities are updating
+	void QueueCreateEntity(std::string entityName, std::string meshName, std::string materialName, EntityType type);
+	void QueueRemoveEntity(EntityHandle handle);
+	void FlushEntityCommands();
+
+	// Bullet Pool Helper Methods
+	void CreateBulletPool(std::string meshName, std::string materialName, unsigned int capacity);
+	void FireBullet();
+
+	// Name based entity helpers kept for tooling and older call sites
 	void RemoveEntity(std::string entityName);
 	Entity* GetEntity(std::string entityName);
+	EntityHandle GetEntityHandle(std::string entityName);
 
 	// Mesh Helper Methods
 	void CreateMesh(std::string meshName, ID3D11Device* device, char* objFile);
+	void CreateMeshAsync(std::string meshName, ID3D11Device* device, char* objFile);
 	void RemoveMesh(std::string meshName);
 
 	// Material Helper Methods
@@ -171,14 +269,17 @@ public:
 
 	// Vertex Shader Helper Methods
 	void CreateVertexShader(std::string vertexShaderName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	void CreateVertexShaderAsync(std::string vertexShaderName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
 	void RemoveVertexShader(std::string vertexShaderName);
 
 	// Vertex Shader Helper Methods
 	void CreatePixelShader(std::string pixelShaderName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	void CreatePixelShaderAsync(std::string pixelShaderName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
 	void RemovePixelShader(std::string pixelShaderName);
 
 	// Shader Resource View Helper Methods
 	void CreateShaderResourceView(std::string shaderResourceViewName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR textureFile);
+	void CreateShaderResourceViewAsync(std::string shaderResourceViewName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR textureFile);
 	void CreateInteriorMappingDDSShaderResourceView(std::string shaderResourceViewName, ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR* textureFiles, int textureFileCount);
 	void RemoveShaderResourceView(std::string shaderResourceViewName);
 
@@ -186,19 +287,95 @@ public:
 	void CreateSamplerState(std::string samplerStateName, ID3D11Device* device, D3D11_SAMPLER_DESC samplerDesc);
 	void RemoveSamplerState(std::string samplerStateName);
 
+	// Asset Streaming Helper Methods
+	// The Async create methods read and process their files on worker threads and only
+	// create the device objects once UpdateAssetLoading is called on the main thread
+	void UpdateAssetLoading();
+	bool IsLoadingAssets();
+	float GetAssetLoadingProgress();
+
+	// Simulates every emitter's particles, then retires and spawns them, spreading both stages across the job pool
+	// The particle budget decides how often each emitter updates and how much it spawns, based on its distance from the viewer
+	void UpdateEmitters(float deltaTime, DirectX::XMFLOAT3 viewPosition);
+	ParticleBudget* GetParticleBudget();
+
+	// Colliders for emitters to collide their particles with, kept up to date by UpdateEmitters
+	ParticleColliderGrid* GetParticleColliders();
+
 	// Emitter Helper Methods
-	void CreateEmitter(std::string emitterName, ID3D11Device* device, std::string vs, std::string ps, std::string texture, ID3D11DepthStencilState* particleDepthState, ID3D11BlendState* particleBlendState);
+	void CreateEmitter(std::string emitterName, ID3D11Device* device, int maxParticles, std::string vs, std::string ps, std::string texture, ID3D11DepthStencilState* particleDepthState, ID3D11BlendState* particleBlendState);
 	void RemoveEmitter(std::string emitterName);
 	Emitter * GetEmitter(std::string entityName);
 
+	// Seeds the random numbers used for spawning asteroids and emitters created from now on
+	void SetRandomSeed(unsigned int seed);
+
 	// Collision detection helper method
 	// returns true if collision is found
 	bool CheckForCollision(Entity * entity1, Entity * entity2);
 	#pragma endregion
 
 private:
-	// Map of all smart entities handled in the manager (Uses entity name for the key)
-	std::map<std::string, SmartEntity> entities;
+	// Dense array of all smart entities handled in the manager
+	// Entities are swapped to the back when removed so this stays tightly packed
+	std::vector<SmartEntity> entities;
+
+	// Slots that entity handles index into, along with the slots available for reuse
+	std::vector<EntitySlot> entitySlots;
+	std::vector<unsigned int> freeEntitySlots;
+
+	// Name to handle index used only by the name based helpers (Uses entity name for the key)
+	std::unordered_map<std::string, EntityHandle> entityNames;
+
+	// Spawns and removals waiting for the next flush
+	std::vector<EntityCommand> entityCommands;
+
+	// Handle of the player entity, used when spawning bullets
+	EntityHandle playerHandle;
+
+	// Fixed set of bullets created up front and recycled for every shot
+	// Handed out round robin so a full pool reuses whichever bullet was fired longest ago
+	std::vector<EntityHandle> bulletPool;
+	unsigned int nextBullet;
+
+	// Structure of arrays store holding every entity's transform
+	TransformStore transforms;
+
+	// Worker pool that streams meshes, shaders and textures in the background
+	AssetLoader assetLoader;
+
+	// Worker pool for per frame work such as the particle simulation
+	JobPool jobPool;
+	std::vector<std::pair<Emitter*, int>> emitterJobs; // Reusable list of (emitter, chunk) jobs
+	std::vector<Emitter*> updatingEmitters; // Reusable list of emitters finishing their update
+
+	// Random numbers for everything the manager spawns
+	Random random;
+
+	// Mesh names waiting on an in flight load, keyed by OBJ file so each file is only loaded once
+	std::map<std::string, std::vector<std::string>> pendingMeshNames;
+
+	// Collision broadphase over the XZ plane so entities only test against nearby entities
+	SpatialGrid broadphase;
+	std::vector<Entity*> broadphaseCandidates; // Reusable storage for broadphase query results
+
+	// Buildings and asteroids as seen by particles, rebuilt before every emitter update
+	ParticleColliderGrid particleColliders;
+
+	// Limits on the particle work done each frame
+	ParticleBudget particleBudget;
+
+	// Draw order for the entities and the instanced batches drawn from it, rebuilt every frame
+	RenderQueue renderQueue;
+	InstanceBatcher instanceBatcher;
+	RenderStateCounters renderCounters;
+	ID3D11Buffer* instanceBuffer; // World matrices (and interior mapping values) for every instance drawn this frame
+	int instanceBufferCapacity;
+	ID3D11Buffer* frameBuffer; // Per frame camera and lights, bound to every entity shader in place of its own copy
+	FrameConstants frameConstants; // What frameBuffer currently holds, so an unchanged frame isn't copied again
+
+	// Binds the shared frame buffer to a newly created shader's frameData (making the buffer on first use)
+	void ShareFrameBuffer(ISimpleShader* shader, ID3D11Device* device);
 
 	// Maps to keep track of entity related objects
 	std::map<std::string, SmartMesh> meshes; // Smart Meshes Map (Uses mesh name for the key)
@@ -210,6 +387,13 @@ private:
 	std::map<std::string, SmartSamplerState> samplerStates; // Smart Sampler States Map (Uses sampler state name for the key)
 
 	#pragma region Private Helper Methods
+	// Entity Helper Methods
+	EntityHandle AddEntity(std::string entityName, Entity* entity, std::string meshName, std::string materialName);
+	SmartEntity* GetSmartEntity(EntityHandle handle);
+
+	// Broadphase Helper Methods
+	void AddToBroadphase(unsigned int denseIndex);
+
 	// Mesh Helper Methods
 	Mesh* GetMesh(std::string meshName);
 
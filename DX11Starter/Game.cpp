@@ -29,6 +29,13 @@ Game::Game(HINSTANCE hInstance)
 	camera = new Camera(width, height);
 	debugCameraEnabled = false;
 	entityManager = new EntityManager();
+	assetsReady = false;
+
+	// Measure time to first frame without showing a window when launched with -measure-startup
+	measureStartup = strstr(GetCommandLineA(), "-measure-startup") != nullptr;
+	showWindow = !measureStartup;
+	firstFramePresented = false;
+	QueryPerformanceCounter((LARGE_INTEGER*)&startupStartTime);
 	
 
 	// Set the game state to the debug scene
@@ -101,8 +108,12 @@ void Game::Init()
 	menuManager = new MenuManager(font);
 	// Initialize SpriteBatch
 	spriteBatch = new SpriteBatch(context);
-	// Seed the random 
-	srand((unsigned)time(0));
+	// Seed the random numbers, passing the same -seed on the command line replays the same asteroids, buildings and particles
+	const char* seedArgument = strstr(GetCommandLineA(), "-seed ");
+	unsigned int seed = seedArgument ? (unsigned int)strtoul(seedArgument + 6, 0, 10) : (unsigned int)time(0);
+	printf("\nRandom seed: %u", seed);
+	random.Seed(seed);
+	entityManager->SetRandomSeed(random.NextUInt());
 
 	/*context->RSGetState(&rasState);
 	context->OMGetBlendState(&blendState, blendFactor, blendMask);*/
@@ -114,11 +125,13 @@ void Game::Init()
 		CreateDebugLights();
 		CreateDebugEntities();
 		CreateSky();
+		assetsReady = true;
 		break;
 	case GameState::Game:
+		// The sky is loaded up front since the main menu draws it, everything else streams in behind the menu
 		CreateLights();
-		CreateEntities();
 		CreateSky();
+		LoadAssets();
 		break;
 	}
 
@@ -136,6 +149,15 @@ void Game::Init()
 	bloomPS = new SimplePixelShader(device, context);
 	bloomPS->LoadShaderFile(L"PixelShaderBloom.cso");
 
+	extractPixelsSlot = extractPS->GetShaderResourceViewInfo("Pixels");
+	extractSamplerSlot = extractPS->GetSamplerInfo("Sampler");
+	bloomBlurAmountVariable = bloomPS->GetVariableInfo("blurAmount");
+	bloomPixelWidthVariable = bloomPS->GetVariableInfo("pixelWidth");
+	bloomPixelHeightVariable = bloomPS->GetVariableInfo("pixelHeight");
+	bloomPixelsSlot = bloomPS->GetShaderResourceViewInfo("Pixels");
+	bloomBrightPixelsSlot = bloomPS->GetShaderResourceViewInfo("BrightPixels");
+	bloomSamplerSlot = bloomPS->GetSamplerInfo("Sampler");
+
 	// Create post process resources -----------------------------------------
 	D3D11_TEXTURE2D_DESC textureDesc = {};
 	textureDesc.Width = width;
@@ -207,38 +229,60 @@ void Game::CreateLights()
 }
 
 // --------------------------------------------------------
-// Sets up entities in the entity manager, this includes:
-// - Creates basic materials to be used in engine, this includes:
-//   - Loading shaders from compiled shader object (.cso) files using
-//     my SimpleShader wrapper for DirectX shader manipulation
-//     - SimpleShader provides helpful methods for sending
-//       data to individual variables on the GPU
-//   - Using DirectXTK to load a texture from an external file
-//   - And creating a sampler description which specifies how the 
-//     material should sample from the loaded texture
-// - Loads the geometry we're going to draw from external files
+// Queues every shader, texture and mesh the game scene needs
+// on the entity manager's loader threads. File I/O and CPU
+// side processing (OBJ parsing, tangents, etc.) happen on the
+// workers while the main menu keeps rendering, and the device
+// objects are created back on the main thread as each one
+// arrives. CreateEntities runs once everything has arrived
 // --------------------------------------------------------
-void Game::CreateEntities()
+void Game::LoadAssets()
 {
 	// Create the vertex shaders
-	entityManager->CreateVertexShader("Default_Vertex_Shader", device, context, L"VertexShader.cso");
-	entityManager->CreateVertexShader("Normals_Vertex_Shader", device, context, L"VertexShaderNormals.cso");
-	entityManager->CreateVertexShader("InteriorMapping_Vertex_Shader", device, context, L"VertexShaderInteriorMapping.cso");
-	entityManager->CreateVertexShader("Particle_Vertex_Shader", device, context, L"VertexShaderParticle.cso");
+	entityManager->CreateVertexShaderAsync("Default_Vertex_Shader", device, context, L"VertexShader.cso");
+	entityManager->CreateVertexShaderAsync("Normals_Vertex_Shader", device, context, L"VertexShaderNormals.cso");
+	entityManager->CreateVertexShaderAsync("InteriorMapping_Vertex_Shader", device, context, L"VertexShaderInteriorMapping.cso");
+	entityManager->CreateVertexShaderAsync("Particle_Vertex_Shader", device, context, L"VertexShaderParticle.cso");
 
 	// Create the pixel shaders
-	entityManager->CreatePixelShader("Default_Pixel_Shader", device, context, L"PixelShader.cso");
-	entityManager->CreatePixelShader("Normals_Pixel_Shader", device, context, L"PixelShaderNormals.cso");
-	entityManager->CreatePixelShader("InteriorMapping_Pixel_Shader", device, context, L"PixelShaderInteriorMapping.cso");
-	entityManager->CreatePixelShader("Particle_Pixel_Shader", device, context, L"PixelShaderParticle.cso");
+	entityManager->CreatePixelShaderAsync("Default_Pixel_Shader", device, context, L"PixelShader.cso");
+	entityManager->CreatePixelShaderAsync("Normals_Pixel_Shader", device, context, L"PixelShaderNormals.cso");
+	entityManager->CreatePixelShaderAsync("InteriorMapping_Pixel_Shader", device, context, L"PixelShaderInteriorMapping.cso");
+	entityManager->CreatePixelShaderAsync("Particle_Pixel_Shader", device, context, L"PixelShaderParticle.cso");
 
 	// Create the shader resource views
-	entityManager->CreateShaderResourceView("Cliff_Texture", device, context, L"resources/textures/CliffLayered_bc.tif");
-	entityManager->CreateShaderResourceView("Cliff_Normal_Texture", device, context, L"resources/textures/CliffLayered_normal.tif");
-	entityManager->CreateShaderResourceView("SpaceShip_Texture", device, context, L"resources/textures/SpaceShip/SpaceShip_bc.png");
-	entityManager->CreateShaderResourceView("SpaceShip_Normal_Texture", device, context, L"resources/textures/SpaceShip/SpaceShip_normal.png");
-	entityManager->CreateShaderResourceView("Bullet_Texture", device, context, L"resources/textures/Bullet_bc.png");
+	entityManager->CreateShaderResourceViewAsync("Cliff_Texture", device, context, L"resources/textures/CliffLayered_bc.tif");
+	entityManager->CreateShaderResourceViewAsync("Cliff_Normal_Texture", device, context, L"resources/textures/CliffLayered_normal.tif");
+	entityManager->CreateShaderResourceViewAsync("SpaceShip_Texture", device, context, L"resources/textures/SpaceShip/SpaceShip_bc.png");
+	entityManager->CreateShaderResourceViewAsync("SpaceShip_Normal_Texture", device, context, L"resources/textures/SpaceShip/SpaceShip_normal.png");
+	entityManager->CreateShaderResourceViewAsync("Bullet_Texture", device, context, L"resources/textures/Bullet_bc.png");
 
+	// Create particle textures
+	//entityManager->CreateShaderResourceView("fireParticle", device, context, L"resources/textures/SpaceShip/fireParticle.jpg");
+	entityManager->CreateShaderResourceViewAsync("Particle", device, context, L"resources/textures/particles/particle.jpg");
+
+	// Load geometry
+	entityManager->CreateMeshAsync("Sphere_Mesh", device, "resources/models/sphere.obj");
+	entityManager->CreateMeshAsync("SpaceShip_Mesh", device, "resources/models/SpaceShip.obj");
+	entityManager->CreateMeshAsync("Bullet_Mesh", device, "resources/models/bullet.obj");
+	entityManager->CreateMeshAsync("Building_Mesh_01", device, "resources/models/cube.obj");
+	entityManager->CreateMeshAsync("Building_Mesh_02", device, "resources/models/cube.obj");
+	entityManager->CreateMeshAsync("Building_Mesh_03", device, "resources/models/helix.obj");
+	entityManager->CreateMeshAsync("Building_Mesh_04", device, "resources/models/cylinder.obj");
+	entityManager->CreateMeshAsync("Building_Mesh_05", device, "resources/models/cylinder.obj");
+}
+
+// --------------------------------------------------------
+// Sets up entities in the entity manager once the assets
+// queued by LoadAssets have arrived, this includes:
+// - Creates basic materials to be used in engine, this includes:
+//   - Using DirectXTK to load the interior mapping textures
+//   - And creating a sampler description which specifies how the 
+//     material should sample from the loaded texture
+// - Creates the emitters, entities and buildings
+// --------------------------------------------------------
+void Game::CreateEntities()
+{
 	// Create the interior mapping shader resource view
 	LPCWSTR textureFiles[8];
 	textureFiles[0] = L"resources/textures/InteriorMaps/OfficeCubeMap.dds";
@@ -251,10 +295,6 @@ void Game::CreateEntities()
 	textureFiles[7] = L"resources/textures/InteriorMaps/OfficeCubeMapWhiteboardDark.dds";
 	entityManager->CreateInteriorMappingDDSShaderResourceView("InteriorMap_Texture", device, context, textureFiles, 8);
 
-	// Create particle textures
-	//entityManager->CreateShaderResourceView("fireParticle", device, context, L"resources/textures/SpaceShip/fireParticle.jpg");
-	entityManager->CreateShaderResourceView("Particle", device, context, L"resources/textures/particles/particle.jpg");
-
 	// Define the anisotropic filtering sampler description
 	D3D11_SAMPLER_DESC samplerDesc = {}; // Zero out all values initially
 	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP; // Have UVW address wrap on the U axis
@@ -294,23 +334,16 @@ void Game::CreateEntities()
 	entityManager->CreateMaterial("Bullet_Material", "Default_Vertex_Shader", "Default_Pixel_Shader", "Bullet_Texture", "Anisotropic_Sampler");
 	entityManager->CreateMaterial("InteriorMapping_Material", "InteriorMapping_Vertex_Shader", "InteriorMapping_Pixel_Shader", "InteriorMap_Texture", "Anisotropic_Sampler");
 
-	// Load geometry
-	entityManager->CreateMesh("Sphere_Mesh", device, "resources/models/sphere.obj");
-	entityManager->CreateMesh("SpaceShip_Mesh", device, "resources/models/SpaceShip.obj");
-	entityManager->CreateMesh("Bullet_Mesh", device, "resources/models/bullet.obj");
-	entityManager->CreateMesh("Building_Mesh_01", device, "resources/models/cube.obj");
-	entityManager->CreateMesh("Building_Mesh_02", device, "resources/models/cube.obj");
-	entityManager->CreateMesh("Building_Mesh_03", device, "resources/models/helix.obj");
-	entityManager->CreateMesh("Building_Mesh_04", device, "resources/models/cylinder.obj");
-	entityManager->CreateMesh("Building_Mesh_05", device, "resources/models/cylinder.obj");
-
 	// Create emitters and pass them to entities
-	entityManager->CreateEmitter("Exhaust_Emitter", device, "Particle_Vertex_Shader", "Particle_Pixel_Shader", "Particle", particleDepthState, particleBlendState);
-	entityManager->CreateEmitter("Explosion_Emitter", device, "Particle_Vertex_Shader", "Particle_Pixel_Shader", "Particle", particleDepthState, particleBlendState);
+	// The exhaust tops out around 210 particles a second for 2 seconds, and the explosions
+	// get room for three 300 particle bursts at once so back to back kills don't starve each other
+	entityManager->CreateEmitter("Exhaust_Emitter", device, 512, "Particle_Vertex_Shader", "Particle_Pixel_Shader", "Particle", particleDepthState, particleBlendState);
+	entityManager->CreateEmitter("Explosion_Emitter", device, 900, "Particle_Vertex_Shader", "Particle_Pixel_Shader", "Particle", particleDepthState, particleBlendState);
 
 	// declare properties for explosion emitter
 	entityManager->GetEmitter("Explosion_Emitter")->SetParticlesPerSecod(0);
-	entityManager->GetEmitter("Explosion_Emitter")->SetMaxParticles(300);
+	entityManager->GetEmitter("Explosion_Emitter")->SetBurstSize(300);
+	entityManager->GetEmitter("Explosion_Emitter")->SetFollowEmitter(false);
 	entityManager->GetEmitter("Explosion_Emitter")->SetLifetime(1);
 	entityManager->GetEmitter("Explosion_Emitter")->SetStartSize(0.1f);
 	entityManager->GetEmitter("Explosion_Emitter")->SetEndSize(5.0f);
@@ -320,8 +353,19 @@ void Game::CreateEntities()
 	entityManager->GetEmitter("Explosion_Emitter")->SetEmitterPosition(XMFLOAT3(0, 0, 0));
 	entityManager->GetEmitter("Explosion_Emitter")->SetEmitterAcceleration(XMFLOAT3(0, 0, 0));
 
+	// Keep the particle simulation to a couple of milliseconds a frame, emitters
+	// a full arena's width from the camera start updating and spawning less
+	entityManager->GetParticleBudget()->SetTargetMilliseconds(2.0f);
+	entityManager->GetParticleBudget()->SetMaxLiveParticles(20000);
+	entityManager->GetParticleBudget()->SetLodDistance(150.0f);
+
+	// Keep particles out of the buildings and asteroids, exhaust just stops while explosions bounce off
+	entityManager->GetEmitter("Exhaust_Emitter")->SetCollision(ParticleCollision::Kill, entityManager->GetParticleColliders());
+	entityManager->GetEmitter("Explosion_Emitter")->SetCollision(ParticleCollision::Bounce, entityManager->GetParticleColliders());
+
 	// Create entities using the previously set up resources
-	entityManager->CreateEntityWithEmitter("Player", "SpaceShip_Mesh", "SpaceShip_Material", "Exhaust_Emitter", EntityType::Player);
+	playerHandle = entityManager->CreateEntityWithEmitter("Player", "SpaceShip_Mesh", "SpaceShip_Material", "Exhaust_Emitter", EntityType::Player);
+	entityManager->CreateBulletPool("Bullet_Mesh", "Bullet_Material", 16);
 	entityManager->CreateEntity("Asteroid1", "Sphere_Mesh", "Asteroid_Material", EntityType::Asteroid);
 	entityManager->CreateEntity("Asteroid2", "Sphere_Mesh", "Asteroid_Material", EntityType::Asteroid);
 	entityManager->CreateEntity("Asteroid3", "Sphere_Mesh", "Asteroid_Material", EntityType::Asteroid);
@@ -333,17 +377,18 @@ void Game::CreateEntities()
 	*asteroidCount = 5;
 
 	// Create buildings utilizing interior mapping and randomly place them on the outskitrs of the scene
-	std::vector<int> collidingBuildings = std::vector<int>();
+	std::vector<EntityHandle> placedBuildings = std::vector<EntityHandle>();
 	for (int i = 0; i < 100; i++)
 	{
 		// Create the building entity
 		std::string name = "Building_" + std::to_string(i);
-		entityManager->CreateEntity(name, "Building_Mesh_0" + std::to_string(rand() % 5 + 1), "InteriorMapping_Material", EntityType::Base);
+		EntityHandle building = entityManager->CreateEntity(name, "Building_Mesh_0" + std::to_string(random.RangeInt(1, 6)), "InteriorMapping_Material", EntityType::Base);
+		Entity* buildingEntity = entityManager->GetEntity(building);
 
 		// Generate and set building entity scale and rotation
-		float scale = rand() % 30 + 10;
-		entityManager->GetEntity(name)->SetUniformScale(scale);
-		entityManager->GetEntity(name)->SetRotation(XMFLOAT3(rand() % 180, rand() % 180, rand() % 180));
+		float scale = (float)random.RangeInt(10, 40);
+		buildingEntity->SetUniformScale(scale);
+		buildingEntity->SetRotation(XMFLOAT3(random.RangeInt(0, 180), random.RangeInt(0, 180), random.RangeInt(0, 180)));
 
 		// Generate and set the building's x and z position
 		float x = 0;
@@ -354,31 +399,31 @@ void Game::CreateEntities()
 		// Generate a semi-random x and y co-ordinate for the building
 		do
 		{
-			x = static_cast <float> (rand()) / static_cast <float> (RAND_MAX) * 2 - 1;
+			x = random.Range(-1, 1);
 			x *= scaleDistance;
-			z = static_cast <float> (rand()) / static_cast <float> (RAND_MAX) * 2 - 1;
+			z = random.Range(-1, 1);
 			z *= scaleDistance;
 		} while ((x < minDist && x > -minDist) && (z < minDist && z > -minDist));
-		entityManager->GetEntity(name)->SetPosition(XMFLOAT3(x, 0, z));
+		buildingEntity->SetPosition(XMFLOAT3(x, 0, z));
 
 		// Check to see if this building is colliding with any others using simple circle collision
 		bool colliding = false;
-		for (int j = i - 1; j >= 0; j--)
+		for (size_t j = 0; j < placedBuildings.size(); j++)
 		{
-			// Make sure the other building actually exists
-			if (std::find(collidingBuildings.begin(), collidingBuildings.end(), j) == collidingBuildings.end()) {
-				if (entityManager->CheckForCollision(entityManager->GetEntity(name), entityManager->GetEntity("Building_" + std::to_string(j))))
-				{
-					colliding = true;
-				}
+			if (entityManager->CheckForCollision(buildingEntity, entityManager->GetEntity(placedBuildings[j])))
+			{
+				colliding = true;
 			}
 		}
 
 		// If the building entity is colliding, remove it
 		if (colliding)
 		{
-			entityManager->RemoveEntity(name);
-			collidingBuildings.push_back(i);
+			entityManager->RemoveEntity(building);
+		}
+		else
+		{
+			placedBuildings.push_back(building);
 		}
 	}
 }
@@ -396,6 +441,11 @@ void Game::CreateSky()
 	skyPS = new SimplePixelShader(device, context);
 	skyPS->LoadShaderFile(L"PixelShaderSky.cso");
 
+	skyViewVariable = skyVS->GetVariableInfo("view");
+	skyProjectionVariable = skyVS->GetVariableInfo("projection");
+	skyTextureSlot = skyPS->GetShaderResourceViewInfo("SkyTextureBase");
+	skySamplerSlot = skyPS->GetSamplerInfo("basicSampler");
+
 	// Track a cube mesh separately from other meshes so its specific to the skybox and not entities
 	skyMesh = new Mesh(device, "resources/models/cube.obj");
 
@@ -500,7 +550,7 @@ void Game::CreateDebugEntities()
 	entityManager->CreateMesh("Cone_Mesh", device, "resources/models/cone.obj");
 
 	// Create entities using the previously set up resources
-	entityManager->CreateEntity("Player", "Sphere_Mesh", "Cliff_Normal_Material", EntityType::Player);
+	playerHandle = entityManager->CreateEntity("Player", "Sphere_Mesh", "Cliff_Normal_Material", EntityType::Player);
 	/*entityManager->CreateEntity("Sphere_01", "Sphere_Mesh", "Cliff_Material");
 	entityManager->CreateEntity("Sphere_02", "Sphere_Mesh", "Cliff_Normal_Material");*/
 	entityManager->CreateEntity("Sphere_03", "Sphere_Mesh", "Cliff_Normal_Material", EntityType::Base);
@@ -523,6 +573,23 @@ void Game::Update(float deltaTime, float totalTime)
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
+	// Create the device objects for any assets that finished loading, and build the scene once they all have
+	if (!assetsReady)
+	{
+		entityManager->UpdateAssetLoading();
+		if (!entityManager->IsLoadingAssets())
+		{
+			CreateEntities();
+			assetsReady = true;
+
+			if (measureStartup)
+			{
+				ReportStartupTime("Assets loaded");
+				Quit();
+			}
+		}
+	}
+
 	if (currentScene == SceneState::Game)
 	{
 		// Switch between normal and debug camera modes when the ` key is pressed
@@ -541,7 +608,7 @@ void Game::Update(float deltaTime, float totalTime)
 		}
 
 		// Movement for the player entity
-		Entity* player = entityManager->GetEntity("Player");
+		Entity* player = entityManager->GetEntity(playerHandle);
 		if (&player != nullptr)
 		{
 			// Set movement rate
@@ -581,13 +648,13 @@ void Game::Update(float deltaTime, float totalTime)
 		}
 
 		// Update the camera
-		camera->Update(deltaTime, totalTime, entityManager->GetEntity("Player"), debugCameraEnabled);
-
-		// Update the explosion emitter
-		entityManager->GetEmitter("Explosion_Emitter")->Update(deltaTime);
+		camera->Update(deltaTime, totalTime, player, debugCameraEnabled);
 
 		// Update all entities
 		bool playerCollision = entityManager->UpdateEntities(deltaTime, totalTime, asteroidCount, entityManager->GetEmitter("Explosion_Emitter"));
+
+		// Update every emitter's particles in parallel now that the player has moved the exhaust
+		entityManager->UpdateEmitters(deltaTime, camera->GetPosition());
 		if (playerCollision)
 		{
 			currentScene = SceneState::GameOver;
@@ -656,15 +723,15 @@ void Game::DrawSky()
 	context->IASetIndexBuffer(skyIB, DXGI_FORMAT_R32_UINT, 0);
 
 	// Send in the view and projection matrices, don't need the world for the skybox
-	skyVS->SetMatrix4x4("view", camera->GetViewMatrix());
-	skyVS->SetMatrix4x4("projection", camera->GetProjectionMatrix());
+	skyVS->SetMatrix4x4(skyViewVariable, camera->GetViewMatrix());
+	skyVS->SetMatrix4x4(skyProjectionVariable, camera->GetProjectionMatrix());
 
 	skyVS->CopyAllBufferData();
 	skyVS->SetShader();
 
 	// Send texture-related stuff
-	skyPS->SetShaderResourceView("SkyTextureBase", skySRV);
-	skyPS->SetSamplerState("basicSampler", sampler);
+	skyPS->SetShaderResourceView(skyTextureSlot, skySRV);
+	skyPS->SetSamplerState(skySamplerSlot, sampler);
 
 	skyPS->CopyAllBufferData(); // Remember to copy to the GPU!!!!
 	skyPS->SetShader();
@@ -709,6 +776,9 @@ void Game::Draw(float deltaTime, float totalTime)
 		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
 		1.0f,
 		0);
+
+	// Count this frame's constant buffer copies from scratch
+	ISimpleShader::ResetUploadCounters();
 	
 	switch (currentScene)
 	{
@@ -723,7 +793,7 @@ void Game::Draw(float deltaTime, float totalTime)
 			menuManager->DisplayGameHUD(spriteBatch, context, *asteroidCount);
 
 			// Draw player's emitter
-			((Player *)entityManager->GetEntity("Player"))->DrawEmitter(context, camera->GetViewMatrix(), camera->GetProjectionMatrix());
+			((Player *)entityManager->GetEntity(playerHandle))->DrawEmitter(context, camera->GetViewMatrix(), camera->GetProjectionMatrix());
 			// draw the explosion emitter
 			entityManager->GetEmitter("Explosion_Emitter")->Draw(context, camera->GetViewMatrix(), camera->GetProjectionMatrix());
 			break;
@@ -732,7 +802,7 @@ void Game::Draw(float deltaTime, float totalTime)
 			
 			DrawSky();
 
-			menuManager->DisplayMainMenu(spriteBatch, context);
+			menuManager->DisplayMainMenu(spriteBatch, context, assetsReady ? 1.0f : entityManager->GetAssetLoadingProgress());
 			break;
 		case SceneState::GameOver:
 			// Draw the sky after you finish drawing opaque objects
@@ -756,8 +826,8 @@ void Game::Draw(float deltaTime, float totalTime)
 	extractPS->SetShader();
 	extractPS->CopyAllBufferData();
 
-	extractPS->SetShaderResourceView("Pixels", normalSRV);
-	extractPS->SetSamplerState("Sampler", sampler);
+	extractPS->SetShaderResourceView(extractPixelsSlot, normalSRV);
+	extractPS->SetSamplerState(extractSamplerSlot, sampler);
 
 	// Unbind vertex and index buffers!
 	UINT stride = sizeof(Vertex);
@@ -776,26 +846,33 @@ void Game::Draw(float deltaTime, float totalTime)
 	// Set up my shaders
 	ppVS->SetShader();
 	bloomPS->SetShader();
-	bloomPS->SetInt("blurAmount", 5);
-	bloomPS->SetFloat("pixelWidth", 1.0f / width);
-	bloomPS->SetFloat("pixelHeight", 1.0f / height);
+	bloomPS->SetInt(bloomBlurAmountVariable, 5);
+	bloomPS->SetFloat(bloomPixelWidthVariable, 1.0f / width);
+	bloomPS->SetFloat(bloomPixelHeightVariable, 1.0f / height);
 	bloomPS->CopyAllBufferData();
 
-	bloomPS->SetShaderResourceView("Pixels", normalSRV);
-	bloomPS->SetShaderResourceView("BrightPixels", brightSRV);
-	bloomPS->SetSamplerState("Sampler", sampler);
+	bloomPS->SetShaderResourceView(bloomPixelsSlot, normalSRV);
+	bloomPS->SetShaderResourceView(bloomBrightPixelsSlot, brightSRV);
+	bloomPS->SetSamplerState(bloomSamplerSlot, sampler);
 
 	// Draw exactly 3 vertices
 	context->Draw(3, 0);
 
 	// Now that we're done, UNBIND the srv from the pixel shader
-	extractPS->SetShaderResourceView("Pixels", 0);
-	bloomPS->SetShaderResourceView("Pixels", 0);
+	extractPS->SetShaderResourceView(extractPixelsSlot, 0);
+	bloomPS->SetShaderResourceView(bloomPixelsSlot, 0);
 
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
 	swapChain->Present(0, 0);
+
+	// Record how long it took to get the first frame on screen
+	if (measureStartup && !firstFramePresented)
+	{
+		firstFramePresented = true;
+		ReportStartupTime("First frame");
+	}
 }
 
 #pragma region Mouse Input
@@ -828,7 +905,7 @@ void Game::OnMouseUp(WPARAM buttonState, int x, int y)
 	switch (currentScene)
 	{
 		case SceneState::Main:
-			if (menuManager->DetectStartClick(x, y))
+			if (assetsReady && menuManager->DetectStartClick(x, y))
 			{
 				context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 				// test making a new rasterizer state
@@ -892,4 +969,27 @@ void Game::OnMouseWheel(float wheelDelta, int x, int y)
 {
 	// Add any custom code here...
 }
-#pragma endregion
\ No newline at end of file
+#pragma endregion
+
+// --------------------------------------------------------
+// Prints and logs the time since the game was constructed,
+// used by -measure-startup to track time to first frame
+// --------------------------------------------------------
+void Game::ReportStartupTime(const char* milestone)
+{
+	__int64 now;
+	__int64 frequency;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+	double milliseconds = (now - startupStartTime) * 1000.0 / frequency;
+
+	printf("\n%s: %.2f ms", milestone, milliseconds);
+
+	// Append to a log next to the executable since there is no window or console to read when headless
+	FILE* log = nullptr;
+	if (fopen_s(&log, "StartupTime.txt", "a") == 0 && log)
+	{
+		fprintf(log, "%s: %.2f ms\n", milestone, milliseconds);
+		fclose(log);
+	}
+}
@@ -7,6 +7,7 @@
 #include "EntityManager.h"
 #include "MenuManager.h"
 #include "Player.h"
+#include "Random.h"
 #include <DirectXMath.h>
 #include <SpriteFont.h>
 #include <SpriteBatch.h>
@@ -63,6 +64,10 @@ private:
 	Mesh* skyMesh; // separate mesh to track specifically for skybox and not entities
 	SimpleVertexShader* skyVS;
 	SimplePixelShader* skyPS;
+	const SimpleShaderVariable* skyViewVariable; // Sky shader slots looked up once instead of by name every frame
+	const SimpleShaderVariable* skyProjectionVariable;
+	const SimpleSRV* skyTextureSlot;
+	const SimpleSampler* skySamplerSlot;
 	ID3D11ShaderResourceView* skySRV;
 	ID3D11RasterizerState* skyRastState;
 	ID3D11DepthStencilState* skyDepthState;
@@ -76,6 +81,14 @@ private:
 	SimpleVertexShader* ppVS;
 	SimplePixelShader* extractPS;           // Shader for extracting only the bright pixels to the bright RTV
 	SimplePixelShader* bloomPS;             // Shader for blurring the bright pixels and then adding it to the normal SRV to create bloom
+	const SimpleSRV* extractPixelsSlot;     // Post process shader slots looked up once instead of by name every frame
+	const SimpleSampler* extractSamplerSlot;
+	const SimpleShaderVariable* bloomBlurAmountVariable;
+	const SimpleShaderVariable* bloomPixelWidthVariable;
+	const SimpleShaderVariable* bloomPixelHeightVariable;
+	const SimpleSRV* bloomPixelsSlot;
+	const SimpleSRV* bloomBrightPixelsSlot;
+	const SimpleSampler* bloomSamplerSlot;
 
 	// look at me, I am the E_M_I_T now
 	ID3D11DepthStencilState* particleDepthState;
@@ -83,6 +96,7 @@ private:
 
 	// Initialization helper methods
 	void CreateLights();
+	void LoadAssets();
 	void CreateEntities();
 	void CreateSky();
 
@@ -97,6 +111,9 @@ private:
 	// Draw method unique to Skybox
 	void DrawSky();
 
+	// Startup timing helper method
+	void ReportStartupTime(const char* milestone);
+
 	// Menu Font
 	DirectX::SpriteFont * font;
 
@@ -112,6 +129,20 @@ private:
 	// Entity Manager
 	EntityManager* entityManager;
 
+	// Handle to the player entity so per frame lookups skip the name index
+	EntityHandle playerHandle;
+
+	// Random numbers for placing the scene (seeded in Init)
+	Random random;
+
+	// Whether the assets streamed in by LoadAssets have arrived and the scene has been built
+	bool assetsReady;
+
+	// Startup timing (enabled with the -measure-startup command line flag)
+	bool measureStartup;
+	bool firstFramePresented;
+	__int64 startupStartTime;
+
 	// Menu Manager
 	MenuManager * menuManager;
 
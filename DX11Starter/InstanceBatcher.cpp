@@ -0,0 +1,52 @@
+#include "InstanceBatcher.h"
+
+InstanceBatcher::InstanceBatcher()
+{
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+}
+
+void InstanceBatcher::Clear()
+{
+	batches.clear();
+	instances.clear();
+}
+
+void InstanceBatcher::Add(unsigned long long stateKey, unsigned int item, const EntityInstance& instance)
+{
+	// Anything with different state needs a draw call of its own
+	if (batches.empty() || batches.back().stateKey != stateKey)
+	{
+		InstanceBatch batch;
+		batch.stateKey = stateKey;
+		batch.firstItem = item;
+		batch.firstInstance = (int)instances.size();
+		batch.instanceCount = 0;
+		batches.push_back(batch);
+	}
+
+	instances.push_back(instance);
+	batches.back().instanceCount++;
+}
+
+int InstanceBatcher::GetBatchCount()
+{
+	return (int)batches.size();
+}
+
+InstanceBatch InstanceBatcher::GetBatch(int index)
+{
+	return batches[index];
+}
+
+int InstanceBatcher::GetInstanceCount()
+{
+	return (int)instances.size();
+}
+
+const EntityInstance* InstanceBatcher::GetInstances()
+{
+	return instances.empty() ? nullptr : &instances[0];
+}
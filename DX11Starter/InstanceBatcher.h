@@ -0,0 +1,55 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Per instance record read by the entity vertex shaders from slot 1
+// Shaders that don't need the interior mapping values simply don't read them
+struct EntityInstance
+{
+	DirectX::XMFLOAT4X4 World; // Row major, read one row per element
+	float Offices; // Interior mapping rooms across each face
+	int RandSeed; // Interior mapping room seed
+};
+
+// A run of instances drawn with one instanced draw call
+struct InstanceBatch
+{
+	unsigned long long stateKey; // Shaders, material and mesh shared by every instance
+	unsigned int firstItem; // Item (usually an entity index) of the batch's first instance
+	int firstInstance; // Position of the first instance in the packed instances
+	int instanceCount;
+};
+
+// --------------------------------------------------------
+// Groups draws already in state order into batches that
+// can each be drawn with a single instanced draw call, and
+// packs every instance into one array ready to copy into an
+// instance buffer. Draws join the previous batch whenever
+// their state key matches it, so feeding them in sorted order
+// gives one batch per distinct shaders, material and mesh
+// Knows nothing of the device, so it can run (and be checked)
+// entirely on the CPU
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher(); // Constructor
+	~InstanceBatcher(); // Destructor
+
+	// Empties the batches and instances for the next frame
+	void Clear();
+
+	// Appends an instance, starting a new batch if its state key differs from the current batch's
+	void Add(unsigned long long stateKey, unsigned int item, const EntityInstance& instance);
+
+	// GET methods
+	int GetBatchCount();
+	InstanceBatch GetBatch(int index);
+	int GetInstanceCount();
+	const EntityInstance* GetInstances();
+
+private:
+	std::vector<InstanceBatch> batches;
+	std::vector<EntityInstance> instances;
+};
@@ -0,0 +1,116 @@
+#include "JobPool.h"
+
+JobPool::JobPool()
+	: JobPool(std::thread::hardware_concurrency())
+{
+}
+
+JobPool::JobPool(unsigned int threadCount)
+{
+	shuttingDown = false;
+	batchNumber = 0;
+	jobCount = 0;
+	nextJob = 0;
+	jobsRemaining = 0;
+
+	// The calling thread helps with every batch, so leave one thread for it
+	unsigned int workerCount = threadCount > 1 ? threadCount - 1 : 0;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&JobPool::WorkerLoop, this));
+}
+
+JobPool::~JobPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		shuttingDown = true;
+	}
+	batchStarted.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void JobPool::ParallelFor(int jobCount, std::function<void(int)> job)
+{
+	if (jobCount <= 0)
+		return;
+
+	// Nothing to gain from waking the workers for a single job
+	if (jobCount == 1 || workers.empty())
+	{
+		for (int i = 0; i < jobCount; i++)
+			job(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		currentJob = job;
+		this->jobCount = jobCount;
+		nextJob = 0;
+		jobsRemaining = jobCount;
+		batchNumber++;
+	}
+	batchStarted.notify_all();
+
+	// Pitch in rather than sit idle, then wait for whatever the workers are still running
+	RunJobs();
+
+	std::unique_lock<std::mutex> lock(jobMutex);
+	batchFinished.wait(lock, [this] { return jobsRemaining == 0; });
+	currentJob = nullptr;
+}
+
+unsigned int JobPool::GetThreadCount()
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+void JobPool::WorkerLoop()
+{
+	unsigned int lastBatch = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			batchStarted.wait(lock, [this, lastBatch] { return shuttingDown || batchNumber != lastBatch; });
+			if (shuttingDown)
+				return;
+
+			lastBatch = batchNumber;
+		}
+
+		RunJobs();
+	}
+}
+
+void JobPool::RunJobs()
+{
+	while (true)
+	{
+		// Claim the next job index
+		int index;
+		std::function<void(int)>* job;
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			if (nextJob >= jobCount)
+				return;
+
+			index = nextJob++;
+			job = &currentJob;
+		}
+
+		(*job)(index);
+
+		// Let the caller know once the last job of the batch is done
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			finished = --jobsRemaining == 0;
+		}
+		if (finished)
+			batchFinished.notify_all();
+	}
+}
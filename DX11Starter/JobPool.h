@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A pool of worker threads for splitting per frame work
+// into independent jobs. ParallelFor hands job indices out
+// to the workers and the calling thread alike, and returns
+// once every job has run, so callers can treat it like an
+// ordinary loop whose iterations happen to run in parallel
+// --------------------------------------------------------
+class JobPool
+{
+public:
+	JobPool(); // Constructor (one worker per spare hardware thread)
+	JobPool(unsigned int threadCount); // Constructor (threadCount counts the calling thread, so 1 runs everything inline)
+	~JobPool(); // Destructor
+
+	// Runs job(0) through job(jobCount - 1) across the pool and waits for all of them
+	void ParallelFor(int jobCount, std::function<void(int)> job);
+
+	// GET methods
+	unsigned int GetThreadCount(); // Workers plus the calling thread
+
+private:
+	// Waits for each new batch of jobs and helps run it
+	void WorkerLoop();
+
+	// Runs jobs from the current batch until there are none left to claim
+	void RunJobs();
+
+	// Worker threads and what they use to wait on each other
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+	std::condition_variable batchStarted;
+	std::condition_variable batchFinished;
+	bool shuttingDown;
+
+	// The current batch (only changed while no jobs are running)
+	std::function<void(int)> currentJob;
+	unsigned int batchNumber; // Bumped for every batch so workers know when there's new work
+	int jobCount;
+	int nextJob; // Next job index to hand out
+	int jobsRemaining; // Jobs that haven't finished yet
+};
@@ -1,6 +1,8 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include "Benchmarks.h"
+#include "SelfTests.h"
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -44,6 +46,17 @@ int WINAPI WinMain(
 		}
 	}
 
+	// Headless benchmarks and tests run instead of the game and exit with their result
+	if (strstr(lpCmdLine, "-self-test")) return RunSelfTests();
+	if (strstr(lpCmdLine, "-benchmark-broadphase")) return RunBroadphaseBenchmark();
+	if (strstr(lpCmdLine, "-report-vertex-cache")) return RunVertexCacheReport();
+	if (strstr(lpCmdLine, "-benchmark-obj-parse")) return RunObjParseBenchmark();
+	if (strstr(lpCmdLine, "-report-mesh-dedup")) return RunMeshDedupReport();
+	if (strstr(lpCmdLine, "-benchmark-particles")) return RunParticleBenchmark();
+	if (strstr(lpCmdLine, "-benchmark-particle-threads")) return RunParticleThreadBenchmark();
+	if (strstr(lpCmdLine, "-benchmark-particle-sort")) return RunParticleSortBenchmark();
+	if (strstr(lpCmdLine, "-report-particle-bandwidth")) return RunParticleBandwidthReport();
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
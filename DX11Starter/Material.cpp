@@ -1,8 +1,13 @@
 #include "Material.h"
+#include <map>
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// Ids handed out so far, in the order materials (and new pairs of shaders) were made
+static std::map<std::pair<SimpleVertexShader*, SimplePixelShader*>, unsigned int> shaderIds;
+static unsigned int nextMaterialId = 0;
+
 Material::Material(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader, ID3D11ShaderResourceView* shaderResourceViewBaseColor, ID3D11ShaderResourceView* shaderResourceViewNormal, ID3D11SamplerState* samplerState)
 {
 	this->vertexShader = vertexShader;
@@ -10,6 +15,21 @@ Material::Material(SimpleVertexShader* vertexShader, SimplePixelShader* pixelSha
 	this->shaderResourceViewBaseColor = shaderResourceViewBaseColor;
 	this->shaderResourceViewNormal = shaderResourceViewNormal;
 	this->samplerState = samplerState;
+
+	// Look up the pixel shader slots once, the shader is always loaded before its materials are made
+	baseColorSlot = pixelShader->GetShaderResourceViewInfo("textureBaseColor");
+	normalSlot = pixelShader->GetShaderResourceViewInfo("textureNormal");
+	samplerSlot = pixelShader->GetSamplerInfo("samplerState");
+	skyCubeSlot = pixelShader->GetShaderResourceViewInfo("SkyCube");
+	numCubeMapsVariable = pixelShader->GetVariableInfo("NumCubeMaps");
+
+	// Hand out the sorting ids now so queuing draws never has to look them up
+	std::pair<SimpleVertexShader*, SimplePixelShader*> shaders(vertexShader, pixelShader);
+	auto id = shaderIds.find(shaders);
+	if (id == shaderIds.end())
+		id = shaderIds.insert(std::make_pair(shaders, (unsigned int)shaderIds.size())).first;
+	shaderId = id->second;
+	materialId = nextMaterialId++;
 }
 
 Material::~Material()
@@ -40,3 +60,38 @@ ID3D11SamplerState * Material::GetSamplerState()
 {
 	return samplerState;
 }
+
+unsigned int Material::GetShaderId()
+{
+	return shaderId;
+}
+
+unsigned int Material::GetMaterialId()
+{
+	return materialId;
+}
+
+const SimpleSRV * Material::GetBaseColorSlot()
+{
+	return baseColorSlot;
+}
+
+const SimpleSRV * Material::GetNormalSlot()
+{
+	return normalSlot;
+}
+
+const SimpleSampler * Material::GetSamplerSlot()
+{
+	return samplerSlot;
+}
+
+const SimpleSRV * Material::GetSkyCubeSlot()
+{
+	return skyCubeSlot;
+}
+
+const SimpleShaderVariable * Material::GetNumCubeMapsVariable()
+{
+	return numCubeMapsVariable;
+}
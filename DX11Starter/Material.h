@@ -17,6 +17,19 @@ public:
 	ID3D11ShaderResourceView* GetShaderResourceViewNormal();
 	ID3D11SamplerState* GetSamplerState();
 
+	// Small ids for sorting draws, handed out when the material is made
+	// Materials with the same pair of shaders share a shader id
+	unsigned int GetShaderId();
+	unsigned int GetMaterialId();
+
+	// Where this material's resources go in its pixel shader, found once so drawing skips the lookups by name
+	// Null when the pixel shader doesn't have the resource
+	const SimpleSRV* GetBaseColorSlot();
+	const SimpleSRV* GetNormalSlot();
+	const SimpleSampler* GetSamplerSlot();
+	const SimpleSRV* GetSkyCubeSlot(); // Interior mapping only
+	const SimpleShaderVariable* GetNumCubeMapsVariable(); // Interior mapping only
+
 private:
 	// Wrappers for DirectX shaders to provide simplified shader functionality
 	SimpleVertexShader* vertexShader;
@@ -30,5 +43,16 @@ private:
 
 	// The Sampler State for this material's texture
 	ID3D11SamplerState* samplerState;
+
+	// Ids for sorting draws
+	unsigned int shaderId;
+	unsigned int materialId;
+
+	// Pre-resolved pixel shader slots
+	const SimpleSRV* baseColorSlot;
+	const SimpleSRV* normalSlot;
+	const SimpleSampler* samplerSlot;
+	const SimpleSRV* skyCubeSlot;
+	const SimpleShaderVariable* numCubeMapsVariable;
 };
 
@@ -21,14 +21,30 @@ MenuManager::~MenuManager()
 {
 }
 
-void MenuManager::DisplayMainMenu(DirectX::SpriteBatch * spriteBatch, ID3D11DeviceContext* context)
+void MenuManager::DisplayMainMenu(DirectX::SpriteBatch * spriteBatch, ID3D11DeviceContext* context, float loadingProgress)
 {
 	spriteBatch->Begin();
 	const wchar_t* title = L"Asteroids";
 	XMFLOAT2 titleOrigin;
 	XMStoreFloat2(&titleOrigin, font->MeasureString(title) / 2.f);
 	font->DrawString(spriteBatch, title, XMFLOAT2(600, 200), Colors::White, 0.f, titleOrigin);
-	font->DrawString(spriteBatch, startButton.text, startButton.pos, Colors::White, 0.f, startButton.origin);
+
+	// Show how far along the asset streaming is in place of the start button until it is done
+	if (loadingProgress < 1.0f)
+	{
+		std::wstring loadingS = L"Loading ";
+		loadingS += std::to_wstring((int)(loadingProgress * 100.0f));
+		loadingS += L"%";
+
+		const wchar_t* loading = loadingS.c_str();
+		XMFLOAT2 loadingOrigin;
+		XMStoreFloat2(&loadingOrigin, font->MeasureString(loading) / 2.f);
+		font->DrawString(spriteBatch, loading, startButton.pos, Colors::White, 0.f, loadingOrigin);
+	}
+	else
+	{
+		font->DrawString(spriteBatch, startButton.text, startButton.pos, Colors::White, 0.f, startButton.origin);
+	}
 	font->DrawString(spriteBatch, quitButton.text, quitButton.pos, Colors::White, 0.f, quitButton.origin);
 
 	spriteBatch->End();
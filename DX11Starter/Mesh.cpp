@@ -1,193 +1,247 @@
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <unordered_map>
 
 using namespace DirectX;
 
-Mesh::Mesh(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
-{
-	// Using the mesh description passed in setup the actual mesh
-	Setup(device, vertices, vertexCount, indices, indexCount);
-}
+// Identifies a binary mesh cache ("GGPM") and the version of its layout
+#define MESH_CACHE_MAGIC 0x4D504747
+#define MESH_CACHE_VERSION 5
 
-Mesh::Mesh(ID3D11Device* device, char* objFile)
-{
-	// File input object
-	std::ifstream obj(objFile);
+// Whether OBJ meshes are reordered for the vertex cache and vertex fetch before being cached (0 to disable)
+#define MESH_OPTIMIZE 1
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
+// Size of the FIFO post-transform cache simulated when reporting how well a mesh hits the cache
+#define MESH_SIMULATED_CACHE_SIZE 16
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
+// Triangles whose uvs are closer than this to degenerate (including faces without uvs) add no tangent
+#define TANGENT_UV_EPSILON 1e-12f
+
+// Next id handed out to a mesh's buffers (only ever created on the device's thread)
+static unsigned int nextMeshId = 0;
 
-	// Still have data left?
-	while (obj.good())
+// --------------------------------------------------------
+// Key used to merge face corners that share the exact same
+// position, uv and normal into a single indexed vertex
+// --------------------------------------------------------
+struct VertexKey
+{
+	VertexKey(const Vertex& vertex)
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		// Adding zero turns any -0.0 into 0.0 so values that compare equal also hash equal
+		values[0] = vertex.Position.x + 0.0f;
+		values[1] = vertex.Position.y + 0.0f;
+		values[2] = vertex.Position.z + 0.0f;
+		values[3] = vertex.UV.x + 0.0f;
+		values[4] = vertex.UV.y + 0.0f;
+		values[5] = vertex.Normal.x + 0.0f;
+		values[6] = vertex.Normal.y + 0.0f;
+		values[7] = vertex.Normal.z + 0.0f;
+	}
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
+	bool operator==(const VertexKey& other) const
+	{
+		for (int i = 0; i < 8; i++)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
+			if (values[i] != other.values[i])
+				return false;
 		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
+		return true;
+	}
 
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
+	float values[8];
+};
+
+struct VertexKeyHasher
+{
+	size_t operator()(const VertexKey& key) const
+	{
+		// FNV-1a over the bits of every component
+		unsigned long long hash = 14695981039346656037ULL;
+		for (int i = 0; i < 8; i++)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
+			unsigned int bits;
+			memcpy(&bits, &key.values[i], sizeof(unsigned int));
+			hash = (hash ^ bits) * 1099511628211ULL;
+		}
+		return (size_t)hash;
+	}
+};
 
-			// Add to the positions
-			positions.push_back(pos);
+// Returns the index of an identical vertex if one was already added, otherwise adds this one
+static unsigned int AddUniqueVertex(const Vertex& vertex, std::vector<Vertex>& verts, std::unordered_map<VertexKey, unsigned int, VertexKeyHasher>& uniqueVerts)
+{
+	auto inserted = uniqueVerts.emplace(VertexKey(vertex), (unsigned int)verts.size());
+	if (inserted.second)
+		verts.push_back(vertex);
+
+	return inserted.first->second;
+}
+
+// Character helpers for walking the OBJ text, the buffer is null terminated so they never run off the end
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static bool IsLineEnd(char c)
+{
+	return c == '\n' || c == '\r' || c == '\0';
+}
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static const char* SkipSpaces(const char* p)
+{
+	while (IsSpace(*p))
+		p++;
+	return p;
+}
+
+static const char* SkipLine(const char* p)
+{
+	while (*p != '\n' && *p != '\0')
+		p++;
+	if (*p == '\n')
+		p++;
+	return p;
+}
+
+// Powers of ten that are exactly representable as doubles
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static double PowerOfTen(int exponent)
+{
+	return exponent <= 22 ? powersOfTen[exponent] : pow(10.0, exponent);
+}
+
+// Parses a decimal float (with optional sign, fraction and exponent) and advances past it
+static float ParseFloat(const char*& p)
+{
+	p = SkipSpaces(p);
+
+	bool negative = *p == '-';
+	if (*p == '-' || *p == '+')
+		p++;
+
+	// Gather up to 19 significant digits into an integer and track where the decimal point goes
+	unsigned long long mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	for (; IsDigit(*p); p++)
+	{
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) significantDigits++;
 		}
-		else if (chars[0] == 'f')
+		else
 		{
-			// Read the face indices into an array
-			unsigned int i[12];
-			int facesRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
+			exponent++;
+		}
+	}
 
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-
-			// Add three more indices
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-			indices.push_back(vertCounter); vertCounter += 1;
-
-			// Was there a 4th face?
-			if (facesRead == 12)
+	if (*p == '.')
+	{
+		for (p++; IsDigit(*p); p++)
+		{
+			if (significantDigits < 19)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-
-				// Add three more indices
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
-				indices.push_back(vertCounter); vertCounter += 1;
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) significantDigits++;
+				exponent--;
 			}
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
+	if (*p == 'e' || *p == 'E')
+	{
+		p++;
+		bool negativeExponent = *p == '-';
+		if (*p == '-' || *p == '+')
+			p++;
 
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-	// - Yes, the indices are a bit redundant here (one per vertex).  Could you skip using
-	//    an index buffer in this case?  Sure!  Though, if your mesh class assumes you have
-	//    one, you'll need to write some extra code to handle cases when you don't.
+		int explicitExponent = 0;
+		for (; IsDigit(*p); p++)
+		{
+			if (explicitExponent < 10000)
+				explicitExponent = explicitExponent * 10 + (*p - '0');
+		}
+		exponent += negativeExponent ? -explicitExponent : explicitExponent;
+	}
+
+	// Scaling by an exact power of ten keeps the result correctly rounded for typical OBJ values
+	double value = (double)mantissa;
+	if (exponent > 0) value *= PowerOfTen(exponent);
+	else if (exponent < 0) value /= PowerOfTen(-exponent);
+
+	return (float)(negative ? -value : value);
+}
 
-	// Using the mesh description gathered setup the actual mesh
-	Setup(device, &verts[0], vertCounter, &indices[0], vertCounter);
+// Parses a signed integer and advances past it, returning 0 if there is no number
+static int ParseInt(const char*& p)
+{
+	bool negative = *p == '-';
+	if (*p == '-' || *p == '+')
+		p++;
+
+	int value = 0;
+	for (; IsDigit(*p); p++)
+		value = value * 10 + (*p - '0');
+
+	return negative ? -value : value;
+}
+
+// Converts a 1 based (or negative, relative to the end) OBJ index into a 0 based one, or -1 if it is invalid
+static int ResolveObjIndex(int index, size_t count)
+{
+	if (index > 0)
+		return (size_t)index <= count ? index - 1 : -1;
+	if (index < 0)
+		return (long long)count + index >= 0 ? (int)(count + index) : -1;
+	return -1;
+}
+
+Mesh::Mesh(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+{
+	// Using the mesh description passed in setup the actual mesh
+	Setup(device, vertices, vertexCount, indices, indexCount);
+}
+
+Mesh::Mesh(ID3D11Device* device, char* objFile)
+{
+	// Everything is loaded on this thread, so the buffers can be created as soon as the data is ready
+	LoadObj(device, objFile);
+}
+
+Mesh::Mesh(char* objFile)
+{
+	// No device, so the processed mesh waits on the CPU for FinishLoading
+	LoadObj(0, objFile);
 }
 
 Mesh::Mesh(Mesh const& other)
 {
 	vertexBuffer = other.vertexBuffer;
-	vertexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+	if (vertexBuffer) { vertexBuffer->AddRef(); } // Tell DirectX there is a new reference to this object
 	indexBuffer = other.indexBuffer;
-	indexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+	if (indexBuffer) { indexBuffer->AddRef(); } // Tell DirectX there is a new reference to this object
 	indexCount = other.indexCount;
+	collider = other.collider;
+	meshId = other.meshId;
+	hasVertexCacheStats = other.hasVertexCacheStats;
+	vertexCacheStatsBefore = other.vertexCacheStatsBefore;
+	vertexCacheStatsAfter = other.vertexCacheStatsAfter;
 }
 
 Mesh & Mesh::operator=(Mesh const& other)
@@ -196,10 +250,15 @@ Mesh & Mesh::operator=(Mesh const& other)
 	{
 		// Switch values
 		vertexBuffer = other.vertexBuffer;
-		vertexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+		if (vertexBuffer) { vertexBuffer->AddRef(); } // Tell DirectX there is a new reference to this object
 		indexBuffer = other.indexBuffer;
-		indexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+		if (indexBuffer) { indexBuffer->AddRef(); } // Tell DirectX there is a new reference to this object
 		indexCount = other.indexCount;
+		collider = other.collider;
+		meshId = other.meshId;
+		hasVertexCacheStats = other.hasVertexCacheStats;
+		vertexCacheStatsBefore = other.vertexCacheStatsBefore;
+		vertexCacheStatsAfter = other.vertexCacheStatsAfter;
 	}
 	return *this;
 }
@@ -214,6 +273,20 @@ Mesh::~Mesh()
 	//delete collider;
 }
 
+void Mesh::FinishLoading(ID3D11Device* device)
+{
+	// Nothing to do if the file couldn't be loaded or the buffers already exist
+	if (loadedVertices.empty() || loadedIndices.empty())
+		return;
+
+	// Using the mesh description gathered create the actual buffers
+	CreateBuffers(device, &loadedVertices[0], (int)loadedVertices.size(), &loadedIndices[0], (int)loadedIndices.size());
+
+	// Free the CPU side copy now that the GPU has its own
+	std::vector<Vertex>().swap(loadedVertices);
+	std::vector<unsigned int>().swap(loadedIndices);
+}
+
 ID3D11Buffer* Mesh::GetVertexBuffer()
 {
 	return vertexBuffer;
@@ -234,7 +307,31 @@ int Mesh::GetIndexCount()
 	return indexCount;
 }
 
+unsigned int Mesh::GetMeshId()
+{
+	return meshId;
+}
+
+bool Mesh::GetVertexCacheStats(VertexCacheStats& before, VertexCacheStats& after)
+{
+	before = vertexCacheStatsBefore;
+	after = vertexCacheStatsAfter;
+	return hasVertexCacheStats;
+}
+
 void Mesh::Setup(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+{
+	// Create the default collider associated with the mesh
+	CalculateCollider(vertices, vertexCount);
+
+	// Calculate the tangents before copying to buffer
+	CalculateTangents(vertices, vertexCount, indices, indexCount);
+
+	// Create the actual vertex and index buffers
+	CreateBuffers(device, vertices, vertexCount, indices, indexCount);
+}
+
+void Mesh::CalculateCollider(Vertex* vertices, int vertexCount)
 {
 	// Create the default collider associated with the mesh
 	// get farthest pair of vertices
@@ -274,10 +371,10 @@ void Mesh::Setup(ID3D11Device* device, Vertex* vertices, int vertexCount, unsign
 
 	// Apply the square root here to the final result
 	collider.SetRadius(sqrt(collider.GetRadius()));
+}
 
-	// Calculate the tangents before copying to buffer
-	CalculateTangents(vertices, vertexCount, indices, indexCount);
-
+void Mesh::CreateBuffers(ID3D11Device* device, const Vertex* vertices, int vertexCount, const unsigned int* indices, int indexCount)
+{
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
@@ -321,6 +418,8 @@ void Mesh::Setup(ID3D11Device* device, Vertex* vertices, int vertexCount, unsign
 
 	// Copy the passed in number of indices to the member count variable 
 	this->indexCount = indexCount;
+
+	meshId = nextMeshId++;
 }
 
 // Calculates the tangents of the vertices in a mesh
@@ -334,7 +433,8 @@ void Mesh::CalculateTangents(Vertex* vertices, int vertexCount, unsigned int* in
 	}
 
 	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < vertexCount;)
+	// Shared verts accumulate the tangent of every triangle that uses them
+	for (int i = 0; i < indexCount;)
 	{
 		// Grab indices and vertices of first triangle
 		unsigned int i1 = indices[i++];
@@ -361,7 +461,11 @@ void Mesh::CalculateTangents(Vertex* vertices, int vertexCount, unsigned int* in
 		float t2 = v3->UV.y - v1->UV.y;
 
 		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
+		// Triangles with no uv area have no tangent direction to give, so they are left out
+		float determinant = s1 * t2 - s2 * t1;
+		if (fabsf(determinant) < TANGENT_UV_EPSILON)
+			continue;
+		float r = 1.0f / determinant;
 
 		float tx = (t2 * x1 - t1 * x2) * r;
 		float ty = (t2 * y1 - t1 * y2) * r;
@@ -389,10 +493,393 @@ void Mesh::CalculateTangents(Vertex* vertices, int vertexCount, unsigned int* in
 		XMVECTOR tangent = XMLoadFloat3(&vertices[i].Tangent);
 
 		// Use Gram-Schmidt orthogonalize
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+		tangent = tangent - normal * XMVector3Dot(normal, tangent);
+
+		// Verts that only belong to triangles without uvs have no tangent yet, so give them
+		// any direction perpendicular to the normal (using the axis least aligned with it)
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) < TANGENT_UV_EPSILON)
+		{
+			XMVECTOR axis = fabsf(vertices[i].Normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+			tangent = axis - normal * XMVector3Dot(normal, axis);
+		}
+		tangent = XMVector3Normalize(tangent);
 
 		// Store the tangent
 		XMStoreFloat3(&vertices[i].Tangent, tangent);
 	}
 }
+
+// Reads an entire OBJ file into memory and parses it in place
+// Faces may have any number of corners (they are fan triangulated), may leave out uvs and normals,
+// and may use negative indices. Corners with identical processed data are merged into a single vert
+bool Mesh::ParseObj(char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	// Bulk read the whole file with a null terminator so the parser never needs to check for the end
+	std::ifstream obj(objFile, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!obj.is_open())
+		return false;
+
+	std::streamoff fileSize = obj.tellg();
+	if (fileSize <= 0)
+		return false;
+
+	std::vector<char> buffer((size_t)fileSize + 1);
+	obj.seekg(0, std::ios::beg);
+	obj.read(&buffer[0], fileSize);
+	obj.close();
+	buffer[(size_t)fileSize] = '\0';
+
+	// First pass counts each kind of line so every array can be sized once up front
+	size_t positionCount = 0;
+	size_t uvCount = 0;
+	size_t normalCount = 0;
+	size_t triangulatedIndexCount = 0;
+	for (const char* p = &buffer[0]; *p != '\0'; p = SkipLine(p))
+	{
+		p = SkipSpaces(p);
+		if (p[0] == 'v' && IsSpace(p[1])) positionCount++;
+		else if (p[0] == 'v' && p[1] == 't' && IsSpace(p[2])) uvCount++;
+		else if (p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) normalCount++;
+		else if (p[0] == 'f' && IsSpace(p[1]))
+		{
+			// Count the corners so the triangulated index count is known
+			int corners = 0;
+			for (p++; !IsLineEnd(*p);)
+			{
+				p = SkipSpaces(p);
+				if (IsLineEnd(*p)) break;
+				corners++;
+				while (!IsLineEnd(*p) && !IsSpace(*p)) p++;
+			}
+			if (corners >= 3) triangulatedIndexCount += (corners - 2) * 3;
+		}
+	}
+
+	// Variables used while reading the file
+	std::vector<XMFLOAT3> positions;     // Positions from the file
+	std::vector<XMFLOAT3> normals;       // Normals from the file
+	std::vector<XMFLOAT2> uvs;           // UVs from the file
+	std::vector<Vertex> faceVerts;       // Processed corners of the current face
+	std::unordered_map<VertexKey, unsigned int, VertexKeyHasher> uniqueVerts; // Index of each unique vert
+	positions.reserve(positionCount);
+	normals.reserve(normalCount);
+	uvs.reserve(uvCount);
+	indices.reserve(triangulatedIndexCount);
+	verts.reserve(positionCount);
+	uniqueVerts.reserve(positionCount);
+
+	// Second pass parses every line
+	for (const char* p = &buffer[0]; *p != '\0'; p = SkipLine(p))
+	{
+		p = SkipSpaces(p);
+
+		// Check the type of line
+		if (p[0] == 'v' && p[1] == 'n' && IsSpace(p[2]))
+		{
+			// Read the 3 numbers directly into an XMFLOAT3
+			p += 2;
+			XMFLOAT3 norm;
+			norm.x = ParseFloat(p);
+			norm.y = ParseFloat(p);
+			norm.z = ParseFloat(p);
+
+			// Add to the list of normals
+			normals.push_back(norm);
+		}
+		else if (p[0] == 'v' && p[1] == 't' && IsSpace(p[2]))
+		{
+			// Read the 2 numbers directly into an XMFLOAT2
+			p += 2;
+			XMFLOAT2 uv;
+			uv.x = ParseFloat(p);
+			uv.y = ParseFloat(p);
+
+			// Add to the list of uv's
+			uvs.push_back(uv);
+		}
+		else if (p[0] == 'v' && IsSpace(p[1]))
+		{
+			// Read the 3 numbers directly into an XMFLOAT3
+			p += 1;
+			XMFLOAT3 pos;
+			pos.x = ParseFloat(p);
+			pos.y = ParseFloat(p);
+			pos.z = ParseFloat(p);
+
+			// Add to the positions
+			positions.push_back(pos);
+		}
+		else if (p[0] == 'f' && IsSpace(p[1]))
+		{
+			// Read every corner of the face (v, v/vt, v//vn or v/vt/vn)
+			// - OBJ File indices are 1-based (or negative to count back from
+			//    the end), so they need to be adusted
+			faceVerts.clear();
+			bool validFace = true;
+			bool missingNormal = false;
+			for (p++; ; )
+			{
+				p = SkipSpaces(p);
+				if (IsLineEnd(*p))
+					break;
+
+				int position = ResolveObjIndex(ParseInt(p), positions.size());
+				int uv = -1;
+				int normal = -1;
+				if (*p == '/')
+				{
+					p++;
+					if (*p != '/')
+						uv = ResolveObjIndex(ParseInt(p), uvs.size());
+					if (*p == '/')
+					{
+						p++;
+						normal = ResolveObjIndex(ParseInt(p), normals.size());
+					}
+				}
+
+				// Skip anything else left in this corner
+				while (!IsLineEnd(*p) && !IsSpace(*p))
+					p++;
+
+				// A corner without a usable position makes the whole face unusable
+				if (position < 0)
+				{
+					validFace = false;
+					continue;
+				}
+
+				// Create the vert by looking up corresponding data from the vectors
+				// Missing uvs default to zero and missing normals are filled in below
+				Vertex vert;
+				vert.Position = positions[position];
+				vert.UV = uv >= 0 ? uvs[uv] : XMFLOAT2(0, 0);
+				vert.Normal = normal >= 0 ? normals[normal] : XMFLOAT3(0, 0, 0);
+				vert.Tangent = XMFLOAT3(0, 0, 0);
+				missingNormal |= normal < 0;
+				faceVerts.push_back(vert);
+			}
+
+			if (!validFace || faceVerts.size() < 3)
+				continue;
+
+			// Corners without a normal get the face's flat normal (Newell's method so n-gons work too)
+			if (missingNormal)
+			{
+				XMFLOAT3 faceNormal = XMFLOAT3(0, 0, 0);
+				for (size_t c = 0; c < faceVerts.size(); c++)
+				{
+					XMFLOAT3& current = faceVerts[c].Position;
+					XMFLOAT3& next = faceVerts[(c + 1) % faceVerts.size()].Position;
+					faceNormal.x += (current.y - next.y) * (current.z + next.z);
+					faceNormal.y += (current.z - next.z) * (current.x + next.x);
+					faceNormal.z += (current.x - next.x) * (current.y + next.y);
+				}
+				XMStoreFloat3(&faceNormal, XMVector3Normalize(XMLoadFloat3(&faceNormal)));
+
+				for (size_t c = 0; c < faceVerts.size(); c++)
+				{
+					if (faceVerts[c].Normal.x == 0 && faceVerts[c].Normal.y == 0 && faceVerts[c].Normal.z == 0)
+						faceVerts[c].Normal = faceNormal;
+				}
+			}
+
+			// The model is most likely in a right-handed space,
+			// especially if it came from Maya.  We want to convert
+			// to a left-handed space for DirectX.  This means we 
+			// need to:
+			//  - Invert the Z position
+			//  - Invert the normal's Z
+			//  - Flip the winding order
+			// We also need to flip the UV coordinate since DirectX
+			// defines (0,0) as the top left of the texture, and many
+			// 3D modeling packages use the bottom left as (0,0)
+			for (size_t c = 0; c < faceVerts.size(); c++)
+			{
+				faceVerts[c].UV.y = 1.0f - faceVerts[c].UV.y; // Flip the UV's since they're probably "upside down"
+				faceVerts[c].Position.z *= -1.0f; // Flip Z (LH vs. RH)
+				faceVerts[c].Normal.z *= -1.0f; // Flip normal Z
+			}
+
+			// Fan triangulate the face, adding the verts and their indices (flipping the winding order)
+			// Corners shared with earlier faces reuse the existing vert
+			for (size_t c = 1; c + 1 < faceVerts.size(); c++)
+			{
+				indices.push_back(AddUniqueVertex(faceVerts[0], verts, uniqueVerts));
+				indices.push_back(AddUniqueVertex(faceVerts[c + 1], verts, uniqueVerts));
+				indices.push_back(AddUniqueVertex(faceVerts[c], verts, uniqueVerts));
+			}
+		}
+	}
+
+	return !indices.empty();
+}
+
+// Loads a processed mesh from the binary cache when it is up to date, otherwise parses and processes the OBJ file
+// With a device the buffers are created straight away, without one the mesh is left for FinishLoading
+void Mesh::LoadObj(ID3D11Device* device, char* objFile)
+{
+	// Use the binary cache written by a previous load if it is still up to date with the OBJ file
+	std::string cacheFile = std::string(objFile) + ".meshcache";
+	if (LoadCache(objFile, cacheFile, device))
+		return;
+
+	// Parse the OBJ file into unique verts and the indices of those verts
+	std::vector<Vertex>& verts = loadedVertices;      // Unique verts we're assembling
+	std::vector<UINT>& indices = loadedIndices;       // Indices of these verts
+	if (!ParseObj(objFile, verts, indices))
+		return;
+
+	// - At this point, "verts" is a vector of Vertex structs, and can be used
+	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
+	//
+	// - The vector "indices" is similar. It's a vector of unsigned ints and
+	//    can be used directly for the index buffer: &indices[0] is the address of the first int
+	//
+	// - Corners with the same position, uv and normal share a single vert, so there
+	//    are usually far fewer verts than indices
+	int vertCount = (int)verts.size();
+	int indexCount = (int)indices.size();
+
+#if MESH_OPTIMIZE
+	// Reorder triangles for the post-transform cache, then vertices for fetch locality
+	vertexCacheStatsBefore = MeshOptimizer::AnalyzeVertexCache(&indices[0], indexCount, vertCount, MESH_SIMULATED_CACHE_SIZE);
+	MeshOptimizer::OptimizeVertexCache(&indices[0], indexCount, vertCount);
+	vertCount = MeshOptimizer::OptimizeVertexFetch(&verts[0], vertCount, &indices[0], indexCount);
+	verts.resize(vertCount);
+	vertexCacheStatsAfter = MeshOptimizer::AnalyzeVertexCache(&indices[0], indexCount, vertCount, MESH_SIMULATED_CACHE_SIZE);
+	hasVertexCacheStats = true;
+#endif
+
+	// Bake the collider and tangents, then save the processed mesh so later loads can skip all of the above
+	CalculateCollider(&verts[0], vertCount);
+	CalculateTangents(&verts[0], vertCount, &indices[0], indexCount);
+	SaveCache(objFile, cacheFile, &verts[0], vertCount, &indices[0], indexCount);
+
+	if (device)
+		FinishLoading(device);
+}
+
+// Gets the size and last write time of an OBJ file so caches built from an older version can be detected
+bool Mesh::GetSourceStamp(char* objFile, unsigned long long& size, long long& modifiedTime)
+{
+	struct __stat64 info;
+	if (_stat64(objFile, &info) != 0)
+		return false;
+
+	size = (unsigned long long)info.st_size;
+	modifiedTime = (long long)info.st_mtime;
+	return true;
+}
+
+// Maps a binary mesh cache into memory and hands the already processed mesh straight from the mapped view
+// to CreateBuffer when there is a device, or copies it out for FinishLoading when there isn't
+// Returns false (leaving the mesh untouched) if the cache is missing, malformed or stale
+bool Mesh::LoadCache(char* objFile, std::string cacheFile, ID3D11Device* device)
+{
+	unsigned long long sourceSize;
+	long long sourceModifiedTime;
+	if (!GetSourceStamp(objFile, sourceSize, sourceModifiedTime))
+		return false;
+
+	// Open and map the whole cache file
+	HANDLE file = CreateFileA(cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(MeshCacheHeader))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const char* view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Make sure the cache matches this build's layout and the OBJ file it was built from
+	const MeshCacheHeader* header = (const MeshCacheHeader*)view;
+	unsigned long long expectedSize =
+		sizeof(MeshCacheHeader) +
+		(unsigned long long)header->vertexCount * sizeof(Vertex) +
+		(unsigned long long)header->indexCount * sizeof(unsigned int);
+
+	bool valid =
+		header->magic == MESH_CACHE_MAGIC &&
+		header->version == MESH_CACHE_VERSION &&
+		header->vertexStride == sizeof(Vertex) &&
+		header->flags == MESH_OPTIMIZE &&
+		header->vertexCount > 0 &&
+		header->indexCount > 0 &&
+		header->sourceSize == sourceSize &&
+		header->sourceModifiedTime == sourceModifiedTime &&
+		(unsigned long long)fileSize.QuadPart == expectedSize;
+
+	if (valid)
+	{
+		// Everything is already processed, so the mapped data can go to the GPU as is
+		const Vertex* vertices = (const Vertex*)(view + sizeof(MeshCacheHeader));
+		const unsigned int* indices = (const unsigned int*)(vertices + header->vertexCount);
+		collider.SetRadius(header->colliderRadius);
+		vertexCacheStatsBefore = header->vertexCacheStatsBefore;
+		vertexCacheStatsAfter = header->vertexCacheStatsAfter;
+		hasVertexCacheStats = MESH_OPTIMIZE != 0;
+		if (device)
+		{
+			CreateBuffers(device, vertices, (int)header->vertexCount, indices, (int)header->indexCount);
+		}
+		else
+		{
+			// The device belongs to another thread, so keep a copy until FinishLoading
+			loadedVertices.assign(vertices, vertices + header->vertexCount);
+			loadedIndices.assign(indices, indices + header->indexCount);
+		}
+	}
+
+	// Clean up the mapping now that the GPU (or the mesh) has its own copy of the data
+	UnmapViewOfFile(view);
+	CloseHandle(mapping);
+	CloseHandle(file);
+
+	return valid;
+}
+
+// Writes the fully processed mesh out as a binary cache next to the OBJ file
+// Failing to write the cache is not an error, the OBJ will simply be parsed again next time
+void Mesh::SaveCache(char* objFile, std::string cacheFile, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+{
+	MeshCacheHeader header = {};
+	if (!GetSourceStamp(objFile, header.sourceSize, header.sourceModifiedTime))
+		return;
+
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.vertexStride = sizeof(Vertex);
+	header.flags = MESH_OPTIMIZE;
+	header.colliderRadius = collider.GetRadius();
+	header.vertexCacheStatsBefore = vertexCacheStatsBefore;
+	header.vertexCacheStatsAfter = vertexCacheStatsAfter;
+
+	std::ofstream cache(cacheFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!cache.is_open())
+		return;
+
+	cache.write((const char*)&header, sizeof(MeshCacheHeader));
+	cache.write((const char*)vertices, sizeof(Vertex) * vertexCount);
+	cache.write((const char*)indices, sizeof(unsigned int) * indexCount);
+	cache.close();
+}
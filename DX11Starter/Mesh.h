@@ -4,8 +4,10 @@
 #include <d3d11.h>
 #include <vector>
 #include <fstream>
+#include <string>
 #include "Vertex.h"
 #include "Collider.h"
+#include "MeshOptimizer.h"
 
 // --------------------------------------------------------
 // A small key that only allows entities to directly access
@@ -27,11 +29,15 @@ class Mesh
 {
 public:
 	Mesh(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount); // Constructor Overload
-	Mesh(ID3D11Device* device, char* objFile); // Constructor Overload
+	Mesh(ID3D11Device* device, char* objFile); // Constructor Overload (reads a binary cache of the OBJ when one is up to date)
+	Mesh(char* objFile); // Constructor Overload that only loads on the CPU (safe on any thread), FinishLoading must be called before use
 	Mesh(Mesh const& other); // Copy Constructor
 	Mesh& operator=(Mesh const& other); // Copy Assignment Operator
 	~Mesh(); // Destructor
 
+	// Creates the buffers for a mesh loaded on the CPU and frees the CPU side copy
+	void FinishLoading(ID3D11Device* device);
+
 	// GET methods
 	ID3D11Buffer* GetVertexBuffer();
 	ID3D11Buffer* GetIndexBuffer();
@@ -40,11 +46,51 @@ public:
 	// DO NOT directly edit this
 	Collider GetCollider(ColliderKey);
 	int GetIndexCount();
+	unsigned int GetMeshId(); // Small id handed out when the buffers are made, shared by copies since they share the buffers
+
+	// Simulated vertex cache results from before and after this mesh was optimized, for callers that want to log them
+	// Meshes loaded from the binary cache report the results saved with it
+	// Returns false if the mesh wasn't optimized (or couldn't be loaded)
+	bool GetVertexCacheStats(VertexCacheStats& before, VertexCacheStats& after);
+
+	// Reads an OBJ file into merged vertices and triangle indices, before any optimizing or tangents
+	// The constructors do this themselves, it's public so the parser can be timed on its own
+	static bool ParseObj(char* objFile, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// Fills in the tangent of every vertex from the triangles that use it
+	// The OBJ load does this itself, it's public so that part of the load can be timed on its own
+	static void CalculateTangents(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
 
 private:
+	// Header at the start of a binary mesh cache file
+	// Followed directly by the vertices and then the indices so the whole file can be mapped and handed to the GPU as is
+	struct MeshCacheHeader
+	{
+		unsigned int magic; // Identifies the file as a mesh cache
+		unsigned int version; // Bumped whenever the layout or the baked processing changes
+		unsigned int vertexCount; // Number of vertices following the header
+		unsigned int indexCount; // Number of indices following the vertices
+		unsigned int vertexStride; // Size of a single vertex when the cache was written
+		unsigned int flags; // Processing options the cache was built with (whether it was optimized)
+		float colliderRadius; // Radius of the base collider
+		VertexCacheStats vertexCacheStatsBefore; // Simulated vertex cache results from when the cache was built
+		VertexCacheStats vertexCacheStatsAfter;
+		unsigned long long sourceSize; // Size of the OBJ file the cache was built from
+		long long sourceModifiedTime; // Last write time of the OBJ file the cache was built from
+	};
+
 	// Helper methods
 	void Setup(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
-	void CalculateTangents(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
+	void CalculateCollider(Vertex* vertices, int vertexCount);
+	void CreateBuffers(ID3D11Device* device, const Vertex* vertices, int vertexCount, const unsigned int* indices, int indexCount);
+
+	// OBJ loading helper methods
+	void LoadObj(ID3D11Device* device, char* objFile);
+
+	// Binary mesh cache helper methods
+	bool GetSourceStamp(char* objFile, unsigned long long& size, long long& modifiedTime);
+	bool LoadCache(char* objFile, std::string cacheFile, ID3D11Device* device);
+	void SaveCache(char* objFile, std::string cacheFile, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
 
 	// Buffers to hold actual geometry data
 	ID3D11Buffer* vertexBuffer = nullptr;
@@ -53,6 +99,18 @@ private:
 	// Integer specifying how many indices are in the mesh's index buffer
 	int indexCount = 0;
 
+	// Small id for sorting draws, handed out in the order buffers are created
+	unsigned int meshId = 0;
+
+	// Simulated vertex cache results from the optimization pass, if it ran (now or when the cache was built)
+	bool hasVertexCacheStats = false;
+	VertexCacheStats vertexCacheStatsBefore = {};
+	VertexCacheStats vertexCacheStatsAfter = {};
+
+	// Processed geometry waiting for FinishLoading to copy it to the GPU
+	std::vector<Vertex> loadedVertices;
+	std::vector<unsigned int> loadedIndices;
+
 
 	// A collider for the base geometry of the mesh
 	// Think of this as the base collider that entites base their own colliders on
@@ -0,0 +1,226 @@
+#include "MeshOptimizer.h"
+#include <climits>
+#include <cmath>
+#include <vector>
+
+// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount)
+{
+	int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Build the list of triangles using each vertex, packed into one array with per vertex offsets
+	std::vector<int> remainingTriangles(vertexCount, 0);
+	for (int i = 0; i < indexCount; i++)
+		remainingTriangles[indices[i]]++;
+
+	std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+
+	std::vector<int> adjacency(indexCount);
+	std::vector<int> adjacencyCursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (int i = 0; i < indexCount; i++)
+		adjacency[adjacencyCursor[indices[i]]++] = i / 3;
+
+	// Score every vertex and triangle before anything is in the cache
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScores[v] = ScoreVertex(-1, remainingTriangles[v]);
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> triangleAdded(triangleCount, false);
+	int bestTriangle = 0;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	// Simulated LRU cache, with room for the three vertices pushed in before the oldest fall out
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	int scanCursor = 0;
+
+	while ((int)output.size() < triangleCount * 3)
+	{
+		// Nothing in the cache touches an unadded triangle, so fall back to the next one in the original order
+		if (bestTriangle < 0)
+		{
+			while (triangleAdded[scanCursor])
+				scanCursor++;
+			bestTriangle = scanCursor;
+		}
+
+		// Emit the best triangle
+		triangleAdded[bestTriangle] = true;
+		unsigned int* triangle = &indices[bestTriangle * 3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = triangle[corner];
+			output.push_back(v);
+
+			// Swap the triangle out of the live part of this vertex's adjacency list
+			int start = adjacencyOffsets[v];
+			int last = start + remainingTriangles[v] - 1;
+			for (int a = start; a <= last; a++)
+			{
+				if (adjacency[a] == bestTriangle)
+				{
+					adjacency[a] = adjacency[last];
+					adjacency[last] = bestTriangle;
+					break;
+				}
+			}
+			remainingTriangles[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache and push everything else back
+		newCache.clear();
+		newCache.push_back(triangle[0]);
+		newCache.push_back(triangle[1]);
+		newCache.push_back(triangle[2]);
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			if (cache[c] != triangle[0] && cache[c] != triangle[1] && cache[c] != triangle[2])
+				newCache.push_back(cache[c]);
+		}
+
+		// Vertices that fell off the end are no longer cached
+		for (size_t c = FORSYTH_CACHE_SIZE; c < newCache.size(); c++)
+		{
+			cachePositions[newCache[c]] = -1;
+			vertexScores[newCache[c]] = ScoreVertex(-1, remainingTriangles[newCache[c]]);
+		}
+		if (newCache.size() > FORSYTH_CACHE_SIZE)
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+
+		// Rescore the cached vertices and their remaining triangles, picking the best one for next time
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			cachePositions[cache[c]] = (int)c;
+			vertexScores[cache[c]] = ScoreVertex((int)c, remainingTriangles[cache[c]]);
+		}
+
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			unsigned int v = cache[c];
+			for (int a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remainingTriangles[v]; a++)
+			{
+				int t = adjacency[a];
+				triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	// Copy the reordered triangles back over the original indices (any trailing partial triangle is left as is)
+	for (size_t i = 0; i < output.size(); i++)
+		indices[i] = output[i];
+}
+
+int MeshOptimizer::OptimizeVertexFetch(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+{
+	// Assign new positions in the order vertices are first referenced
+	std::vector<unsigned int> remap(vertexCount, UINT_MAX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] == UINT_MAX)
+		{
+			remap[v] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[v]);
+		}
+		indices[i] = remap[v];
+	}
+
+	// Copy the reordered vertices back, dropping any that were never used
+	for (size_t v = 0; v < reordered.size(); v++)
+		vertices[v] = reordered[v];
+
+	return (int)reordered.size();
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(unsigned int* indices, int indexCount, int vertexCount, int cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (indexCount == 0 || vertexCount == 0)
+		return stats;
+
+	// A vertex is in the FIFO if fewer than cacheSize other vertices were transformed since it was
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	unsigned int time = cacheSize + 1;
+	int misses = 0;
+	int uniqueVertices = 0;
+
+	for (int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - timestamps[v] > (unsigned int)cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+
+		if (!referenced[v])
+		{
+			referenced[v] = true;
+			uniqueVertices++;
+		}
+	}
+
+	stats.acmr = (float)misses / (indexCount / 3);
+	stats.atvr = (float)misses / uniqueVertices;
+	return stats;
+}
+
+float MeshOptimizer::ScoreVertex(int cachePosition, int remainingTriangles)
+{
+	// Vertices with nothing left to draw should never pull a triangle forward
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices get a fixed score so the next triangle doesn't just reuse its edge
+		if (cachePosition < 3)
+		{
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// Boost vertices with few triangles left so they get finished off and leave the cache
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Vertex.h"
+
+// Results of running an index buffer through the post-transform cache simulator
+struct VertexCacheStats
+{
+	// Members
+	float acmr; // Average cache miss ratio (vertices transformed per triangle, 0.5 is ideal for large grids and 3.0 is the worst case)
+	float atvr; // Average transform to vertex ratio (vertices transformed per unique vertex, 1.0 is ideal)
+};
+
+// --------------------------------------------------------
+// Reorders indexed meshes so the GPU does less work drawing
+// them. Triangles are sorted for post-transform vertex cache
+// hits (Forsyth's linear-speed algorithm), then vertices are
+// sorted into the order they are first used so vertex fetch
+// reads memory linearly. A CPU simulation of a FIFO vertex
+// cache reports how well an index buffer hits the cache.
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	// Reorders the triangles of an index buffer in place for vertex cache locality
+	static void OptimizeVertexCache(unsigned int* indices, int indexCount, int vertexCount);
+
+	// Reorders vertices into the order the index buffer first uses them and rewrites the indices to match
+	// Returns the new vertex count, which is smaller if any vertices were never referenced
+	static int OptimizeVertexFetch(Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
+
+	// Simulates a FIFO post-transform cache of the given size over an index buffer
+	static VertexCacheStats AnalyzeVertexCache(unsigned int* indices, int indexCount, int vertexCount, int cacheSize);
+
+private:
+	// Scores a vertex by its position in the simulated LRU cache and how many triangles still need it
+	static float ScoreVertex(int cachePosition, int remainingTriangles);
+};
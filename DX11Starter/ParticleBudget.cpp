@@ -0,0 +1,134 @@
+#include <Windows.h>
+#include "ParticleBudget.h"
+#include "Emitter.h"
+
+// Most distance levels an emitter can drop, each one halving its update rate and spawning
+#define PARTICLE_BUDGET_MAX_LOD 3
+
+// How quickly the smoothed update time follows the measured one
+#define PARTICLE_BUDGET_SMOOTHING 0.1f
+
+// How far spawning drops each frame over the target, and recovers each frame comfortably under it
+#define PARTICLE_BUDGET_BACK_OFF 0.9f
+#define PARTICLE_BUDGET_RECOVERY 1.05f
+#define PARTICLE_BUDGET_MIN_SCALE 0.1f
+
+using namespace DirectX;
+
+ParticleBudget::ParticleBudget()
+{
+	targetMilliseconds = 2.0f;
+	maxLiveParticles = 20000;
+	lodDistance = 100.0f;
+
+	spawnScale = 1.0f;
+	lastLiveParticles = 0;
+
+	viewPosition = XMFLOAT3(0, 0, 0);
+	frameStartTime = 0;
+	counters = {};
+	counters.spawnScale = 1.0f;
+}
+
+ParticleBudget::~ParticleBudget()
+{
+}
+
+void ParticleBudget::BeginFrame(XMFLOAT3 viewPosition)
+{
+	this->viewPosition = viewPosition;
+
+	// Keep the smoothed time across frames, everything else is counted from scratch
+	float averageUpdateMilliseconds = counters.averageUpdateMilliseconds;
+	counters = {};
+	counters.averageUpdateMilliseconds = averageUpdateMilliseconds;
+
+	// Nothing new spawns while too many particles are alive, they'll make room as they die
+	counters.spawnScale = lastLiveParticles >= maxLiveParticles ? 0.0f : spawnScale;
+
+	QueryPerformanceCounter((LARGE_INTEGER*)&frameStartTime);
+}
+
+float ParticleBudget::PlanEmitter(Emitter* emitter, float deltaTime)
+{
+	counters.emitterCount++;
+	counters.liveParticles += emitter->GetLivingParticleCount();
+
+	// Each multiple of the LOD distance away drops another level
+	// Particles that don't follow their emitter live wherever they spawned (like explosions
+	// anywhere in the world), so the emitter's position says nothing about how far away they are
+	int lod = 0;
+	if (emitter->GetFollowEmitter())
+	{
+		XMFLOAT3 position = emitter->GetEmitterPosition();
+		float dx = position.x - viewPosition.x;
+		float dy = position.y - viewPosition.y;
+		float dz = position.z - viewPosition.z;
+		lod = (int)(sqrtf(dx * dx + dy * dy + dz * dz) / lodDistance);
+		if (lod > PARTICLE_BUDGET_MAX_LOD)
+			lod = PARTICLE_BUDGET_MAX_LOD;
+	}
+
+	// Distant emitters spawn less and only update every 2^lod frames
+	emitter->SetSpawnScale(counters.spawnScale / (1 << lod));
+
+	EmitterBudgetState& state = emitterStates[emitter];
+	state.pendingTime += deltaTime;
+	state.framesWaited++;
+	if (state.framesWaited < (1 << lod))
+		return 0.0f;
+
+	// Due an update, covering all the time it skipped
+	float updateTime = state.pendingTime;
+	state.pendingTime = 0.0f;
+	state.framesWaited = 0;
+
+	counters.emittersUpdated++;
+	counters.particlesUpdated += emitter->GetLivingParticleCount();
+	return updateTime;
+}
+
+void ParticleBudget::EndFrame()
+{
+	__int64 now;
+	__int64 frequency;
+	QueryPerformanceCounter((LARGE_INTEGER*)&now);
+	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+	counters.updateMilliseconds = (float)((now - frameStartTime) * 1000.0 / frequency);
+	counters.averageUpdateMilliseconds += (counters.updateMilliseconds - counters.averageUpdateMilliseconds) * PARTICLE_BUDGET_SMOOTHING;
+
+	// Back off spawning while over the target, and ease it back up once there's some headroom
+	if (counters.averageUpdateMilliseconds > targetMilliseconds)
+		spawnScale *= PARTICLE_BUDGET_BACK_OFF;
+	else if (counters.averageUpdateMilliseconds < targetMilliseconds * 0.75f)
+		spawnScale *= PARTICLE_BUDGET_RECOVERY;
+	if (spawnScale < PARTICLE_BUDGET_MIN_SCALE) spawnScale = PARTICLE_BUDGET_MIN_SCALE;
+	if (spawnScale > 1.0f) spawnScale = 1.0f;
+
+	lastLiveParticles = counters.liveParticles;
+}
+
+void ParticleBudget::RemoveEmitter(Emitter* emitter)
+{
+	emitterStates.erase(emitter);
+}
+
+ParticleBudgetCounters ParticleBudget::GetCounters()
+{
+	return counters;
+}
+
+void ParticleBudget::SetTargetMilliseconds(float _targetMilliseconds)
+{
+	targetMilliseconds = _targetMilliseconds;
+}
+
+void ParticleBudget::SetMaxLiveParticles(int _maxLiveParticles)
+{
+	maxLiveParticles = _maxLiveParticles;
+}
+
+void ParticleBudget::SetLodDistance(float _lodDistance)
+{
+	lodDistance = _lodDistance;
+}
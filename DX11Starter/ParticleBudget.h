@@ -0,0 +1,80 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <unordered_map>
+
+class Emitter;
+
+// Numbers describing the last frame of particle work, for profiling
+struct ParticleBudgetCounters
+{
+	int emitterCount; // Emitters planned this frame
+	int emittersUpdated; // Emitters that were due an update this frame
+	int liveParticles; // Living particles across every emitter
+	int particlesUpdated; // Living particles in the emitters that updated
+	float updateMilliseconds; // Time spent simulating particles this frame
+	float averageUpdateMilliseconds; // Smoothed update time the budget steers by
+	float spawnScale; // Scale applied to spawning before distance is taken into account
+};
+
+// --------------------------------------------------------
+// Keeps the total particle work across every emitter in
+// check. Emitters further than the LOD distance from the
+// viewer update less often (with the skipped time folded
+// into their next update) and spawn fewer particles, as
+// long as their particles follow them. Particles left where
+// they spawned could be anywhere, so those emitters are
+// never thinned out by distance. Everyone's spawning is
+// scaled back while the particle update runs over its
+// frame time target or too many particles are alive
+// --------------------------------------------------------
+class ParticleBudget
+{
+public:
+	ParticleBudget(); // Constructor
+	~ParticleBudget(); // Destructor
+
+	// Starts planning a frame's particle work, starting the update timer
+	void BeginFrame(DirectX::XMFLOAT3 viewPosition);
+
+	// Sets the emitter's spawn scale and returns the time step to update it with this frame
+	// Returns 0 when the emitter should skip updating this frame
+	float PlanEmitter(Emitter* emitter, float deltaTime);
+
+	// Finishes the frame's particle work, stopping the timer and adjusting the budget for next frame
+	void EndFrame();
+
+	// Forgets an emitter that's being deleted
+	void RemoveEmitter(Emitter* emitter);
+
+	// GET methods
+	ParticleBudgetCounters GetCounters();
+
+	// SET methods
+	void SetTargetMilliseconds(float _targetMilliseconds);
+	void SetMaxLiveParticles(int _maxLiveParticles);
+	void SetLodDistance(float _lodDistance);
+
+private:
+	// How far behind an emitter is on its updates
+	struct EmitterBudgetState
+	{
+		float pendingTime; // Time skipped since its last update
+		int framesWaited;
+	};
+	std::unordered_map<Emitter*, EmitterBudgetState> emitterStates;
+
+	// Limits
+	float targetMilliseconds;
+	int maxLiveParticles;
+	float lodDistance; // Emitters further than this start updating less often, halving again at each multiple
+
+	// Feedback from previous frames
+	float spawnScale;
+	int lastLiveParticles;
+
+	// This frame
+	DirectX::XMFLOAT3 viewPosition;
+	__int64 frameStartTime;
+	ParticleBudgetCounters counters;
+};
@@ -0,0 +1,145 @@
+#include "ParticleColliderGrid.h"
+#include <cfloat>
+#include <cmath>
+
+// Most cells along either side of the grid, colliders spread wider than this get bigger cells instead
+#define PARTICLE_GRID_MAX_CELLS 256
+
+ParticleColliderGrid::ParticleColliderGrid(float cellSize)
+{
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+	minX = 0;
+	minZ = 0;
+	cellsX = 0;
+	cellsZ = 0;
+}
+
+ParticleColliderGrid::~ParticleColliderGrid()
+{
+}
+
+void ParticleColliderGrid::Clear()
+{
+	colliders.clear();
+	cellStarts.clear();
+	cellColliders.clear();
+	cellsX = 0;
+	cellsZ = 0;
+}
+
+void ParticleColliderGrid::AddCollider(float x, float z, float radius)
+{
+	CircleCollider collider;
+	collider.x = x;
+	collider.z = z;
+	collider.radius = radius;
+	colliders.push_back(collider);
+}
+
+void ParticleColliderGrid::Build()
+{
+	cellStarts.clear();
+	cellColliders.clear();
+	cellsX = 0;
+	cellsZ = 0;
+	if (colliders.empty())
+		return;
+
+	// Only cover the area the colliders do, anything outside it can't hit one
+	float maxX = -FLT_MAX;
+	float maxZ = -FLT_MAX;
+	minX = FLT_MAX;
+	minZ = FLT_MAX;
+	for (size_t i = 0; i < colliders.size(); i++)
+	{
+		if (colliders[i].x - colliders[i].radius < minX) minX = colliders[i].x - colliders[i].radius;
+		if (colliders[i].z - colliders[i].radius < minZ) minZ = colliders[i].z - colliders[i].radius;
+		if (colliders[i].x + colliders[i].radius > maxX) maxX = colliders[i].x + colliders[i].radius;
+		if (colliders[i].z + colliders[i].radius > maxZ) maxZ = colliders[i].z + colliders[i].radius;
+	}
+
+	// Grow the cells if the colliders are spread too far apart for the requested size
+	float size = cellSize;
+	float widest = (maxX - minX) > (maxZ - minZ) ? (maxX - minX) : (maxZ - minZ);
+	if (widest / size > PARTICLE_GRID_MAX_CELLS)
+		size = widest / PARTICLE_GRID_MAX_CELLS;
+	inverseCellSize = 1.0f / size;
+	cellsX = (int)((maxX - minX) * inverseCellSize) + 1;
+	cellsZ = (int)((maxZ - minZ) * inverseCellSize) + 1;
+	if (cellsX > PARTICLE_GRID_MAX_CELLS) cellsX = PARTICLE_GRID_MAX_CELLS;
+	if (cellsZ > PARTICLE_GRID_MAX_CELLS) cellsZ = PARTICLE_GRID_MAX_CELLS;
+
+	// Count how many colliders land in each cell, then turn the counts into where each cell's list starts
+	cellStarts.assign(cellsX * cellsZ + 1, 0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (size_t i = 0; i < colliders.size(); i++)
+		{
+			const CircleCollider& collider = colliders[i];
+			int cellMinX = (int)((collider.x - collider.radius - minX) * inverseCellSize);
+			int cellMinZ = (int)((collider.z - collider.radius - minZ) * inverseCellSize);
+			int cellMaxX = (int)((collider.x + collider.radius - minX) * inverseCellSize);
+			int cellMaxZ = (int)((collider.z + collider.radius - minZ) * inverseCellSize);
+			if (cellMinX >= cellsX) cellMinX = cellsX - 1;
+			if (cellMinZ >= cellsZ) cellMinZ = cellsZ - 1;
+			if (cellMaxX >= cellsX) cellMaxX = cellsX - 1;
+			if (cellMaxZ >= cellsZ) cellMaxZ = cellsZ - 1;
+
+			for (int cellZ = cellMinZ; cellZ <= cellMaxZ; cellZ++)
+			{
+				for (int cellX = cellMinX; cellX <= cellMaxX; cellX++)
+				{
+					int cell = cellZ * cellsX + cellX;
+					if (pass == 0)
+						cellStarts[cell + 1]++;
+					else
+						cellColliders[cellStarts[cell]++] = (int)i;
+				}
+			}
+		}
+
+		if (pass == 0)
+		{
+			for (size_t cell = 1; cell < cellStarts.size(); cell++)
+				cellStarts[cell] += cellStarts[cell - 1];
+			cellColliders.resize(cellStarts.back());
+		}
+	}
+
+	// Filling the lists moved every start along to the next cell's, so shift them back
+	for (size_t cell = cellStarts.size() - 1; cell > 0; cell--)
+		cellStarts[cell] = cellStarts[cell - 1];
+	cellStarts[0] = 0;
+}
+
+bool ParticleColliderGrid::FindCollider(float x, float z, float& colliderX, float& colliderZ, float& colliderRadius)
+{
+	// Points outside the grid are outside every collider
+	float gridX = (x - minX) * inverseCellSize;
+	float gridZ = (z - minZ) * inverseCellSize;
+	if (gridX < 0 || gridZ < 0 || gridX >= cellsX || gridZ >= cellsZ)
+		return false;
+
+	int cell = (int)gridZ * cellsX + (int)gridX;
+	for (int i = cellStarts[cell]; i < cellStarts[cell + 1]; i++)
+	{
+		const CircleCollider& collider = colliders[cellColliders[i]];
+		float dx = x - collider.x;
+		float dz = z - collider.z;
+		if (dx * dx + dz * dz < collider.radius * collider.radius)
+		{
+			colliderX = collider.x;
+			colliderZ = collider.z;
+			colliderRadius = collider.radius;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int ParticleColliderGrid::GetColliderCount()
+{
+	return (int)colliders.size();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// A flat uniform grid of circle colliders on the XZ plane
+// for particles to test themselves against. Unlike the
+// entity broadphase it is rebuilt from scratch once a frame
+// and never changes while particles are using it, so any
+// number of threads can look points up at the same time
+// Each circle is listed in every cell its bounding square
+// overlaps, so a point only ever needs to check one cell
+// --------------------------------------------------------
+class ParticleColliderGrid
+{
+public:
+	ParticleColliderGrid(float cellSize); // Constructor
+	~ParticleColliderGrid(); // Destructor
+
+	// Removes every collider, ready for the next frame's colliders to be added
+	void Clear();
+
+	// Adds a circle collider, it can't be hit until the grid is next built
+	void AddCollider(float x, float z, float radius);
+
+	// Sorts the colliders into cells, call once after adding them and before any lookups
+	void Build();
+
+	// Finds a collider containing the given point, handing back its centre and radius
+	// Returns false when the point is outside every collider
+	bool FindCollider(float x, float z, float& colliderX, float& colliderZ, float& colliderRadius);
+
+	// GET methods
+	int GetColliderCount();
+
+private:
+	struct CircleCollider
+	{
+		float x;
+		float z;
+		float radius;
+	};
+	std::vector<CircleCollider> colliders;
+
+	// Colliders listed cell by cell, cell i's colliders are cellColliders[cellStarts[i]] up to cellColliders[cellStarts[i + 1]]
+	std::vector<int> cellStarts;
+	std::vector<int> cellColliders;
+
+	// Area covered by the cells, which only spans the colliders added since the last clear
+	float cellSize;
+	float inverseCellSize;
+	float minX;
+	float minZ;
+	int cellsX;
+	int cellsZ;
+};
@@ -16,6 +16,8 @@ struct VertexToPixel
 	float2 uv			: TEXCOORD;
 	float3 tangent		: TANGENT;
 	float3 worldPos		: POSITION; // The world position of this PIXEL
+	nointerpolation float offices	: OFFICES; // Rooms across each face of this building
+	nointerpolation int randSeed	: RANDSEED; // Seed for picking this building's rooms
 };
 
 // Struct representing a directional light
@@ -27,19 +29,20 @@ struct DirectionalLight
 	float padding;			// Manual Padding to ensure members don't cross 16-byte boundaries in memory
 };
 
-// Constant Buffer to hold light information
-cbuffer lightData : register(b0)
+// Per frame data, filled once per frame and shared by every entity shader
+// - Must match the layout of FrameConstants in the C++ code
+cbuffer frameData : register(b0)
 {
+	matrix view;
+	matrix projection;
 	DirectionalLight lights[4]; // The size of this array should match the number of lights getting passed in
+	float3 CameraPosition; // Needed for specular (reflection) calculation
 };
 
 // Constant Buffer to hold interior mapping information
 cbuffer interiorMappingData : register(b1)
 {
-	float3 CameraPosition; // Needed for specular (reflection) calculation
-	float Offices;
 	int NumCubeMaps;
-	int RandSeed;
 };
 
 // Texture related global variables
@@ -123,17 +126,17 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3x3 TBN = float3x3(T, B, N);
 
 	// View vector (in world space!)
-	float3 view = normalize(input.worldPos - CameraPosition);
+	float3 viewRay = normalize(input.worldPos - CameraPosition);
 
 	// Reflection vector for window/sky reflection (handled here in world space)
-	float3 refl = reflect(view, input.normal);
+	float3 refl = reflect(viewRay, input.normal);
 	float4 reflColor = SkyCube.Sample(samplerState, refl);
 
 	// Super fake fresnel term to handle reflection amount (again, world space!)
-	float fres = 1 - saturate(-dot(input.normal, view) * 0.75f);
+	float fres = 1 - saturate(-dot(input.normal, viewRay) * 0.75f);
 
 	// Increase number of rooms by repeating the 0-1 uv space
-	float2 uvScaled = input.uv * Offices;
+	float2 uvScaled = input.uv * input.offices;
 	float2 uvFractional = frac(uvScaled);
 
 	// Calculate a 3D position (from the UV coord) that
@@ -142,8 +145,8 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 uvPosition = float3(uvFractional * 2 - 1, 1);
 
 #ifdef TANGENT_SPACE
-	// Change view to tangent space
-	view = mul(view, transpose(TBN));
+	// Change the view ray to tangent space
+	viewRay = mul(viewRay, transpose(TBN));
 #else // WORLD SPACE!
 	// Convert uv position from tangent to world space
 	uvPosition = mul(uvPosition, TBN);
@@ -151,18 +154,18 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// Simplified ray/box intersection test.  We're assuming that
 	// the starting point of the ray is definitely inside the box!
-	float3 viewInv = 1.0f / view;						// Invert the view ray
+	float3 viewInv = 1.0f / viewRay;						// Invert the view ray
 	float3 dist = abs(viewInv) - uvPosition * viewInv;	// Distance the ray travels
 	float distMin = min(dist.x, min(dist.y, dist.z));	// Which plane is hit first?
 
 	// Move along the view ray to the point we actually "see" inside the box
-	float3 sampleDirection = uvPosition + distMin * view;
+	float3 sampleDirection = uvPosition + distMin * viewRay;
 
 	// Randomly rotate the sample direction either 0, 90, 180 or 270 degrees
 	float3 sampleDirRotated = RandomCubeRotation(sampleDirection, uvScaled);
 
 	// Randomly pick a cube map
-	int cubeIndex = RandomArrayIndex(uvScaled + RandSeed, NumCubeMaps);
+	int cubeIndex = RandomArrayIndex(uvScaled + input.randSeed, NumCubeMaps);
 
 	// Sample the interior cube map and interpolate between that and the reflection 
 	float4 interiorColor = textureBaseColor.Sample(samplerState, float4(sampleDirRotated, cubeIndex));
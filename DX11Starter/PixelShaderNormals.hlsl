@@ -26,10 +26,14 @@ struct DirectionalLight
 	float padding;			// Manual Padding to ensure members don't cross 16-byte boundaries in memory
 };
 
-// Constant Buffer to hold light information
-cbuffer lightData : register(b0)
+// Per frame data, filled once per frame and shared by every entity shader
+// - Must match the layout of FrameConstants in the C++ code
+cbuffer frameData : register(b0)
 {
+	matrix view;
+	matrix projection;
 	DirectionalLight lights[4]; // The size of this array should match the number of lights getting passed in
+	float3 CameraPosition; // Needed for specular (reflection) calculation
 };
 
 // Texture related global variables
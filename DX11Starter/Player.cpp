@@ -4,19 +4,20 @@
 // For the DirectX Math library
 using namespace DirectX;
 
-Player::Player(Mesh* m, Material* mat, int type, Emitter * E_M_I_T) :
-	Entity(m, mat, type)
+Player::Player(Mesh* m, Material* mat, int type, Emitter * E_M_I_T, TransformStore* transforms) :
+	Entity(m, mat, type, transforms)
 {
 	maxSpeed = 5;
 
 	numBullets = 0;
 
 	// Start position at the origin
-	position = XMFLOAT3(0, 0, 0);
+	SetPosition(XMFLOAT3(0, 0, 0));
 
 	// Set the direction to face forward and the starting velocity to 0
+	// The player steers with MoveForward, so the transform store never integrates it
 	direction = XMFLOAT3(0, 0, 1);
-	velocity = XMFLOAT3(0, 0, 0);
+	SetVelocity(XMFLOAT3(0, 0, 0));
 
 	// Initialize shooting vars
 	canShoot = true;
@@ -88,6 +89,8 @@ void Player::Update(float deltaTime, float totalTime)
 	}
 
 	// Update the direction of the player based on rotation
+	XMFLOAT3 position = GetPosition();
+	XMFLOAT3 rotation = GetRotation();
 	XMFLOAT3 orig = XMFLOAT3(0, 0, 1);
 	XMStoreFloat3(&direction, XMVector3Rotate(XMLoadFloat3(&orig), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation))));
 
@@ -106,7 +109,7 @@ void Player::Update(float deltaTime, float totalTime)
 	if(particlesPerSecond < 0) particlesPerSecond = 0;
 	exhaustEmitter->SetParticlesPerSecod(particlesPerSecond + 10);
 
-	exhaustEmitter->Update(deltaTime);
+	// The emitter itself is updated along with every other emitter by the entity manager
 }
 
 void Player::SetEntityManager(EntityManager * entityManager)
@@ -125,7 +128,7 @@ void Player::Shoot(float totalTime)
 	if (canShoot)
 	{
 		// Shoot
-		entityManager->CreateEntity("Bullet_" + std::to_string(numBullets), "Bullet_Mesh", "Bullet_Material", EntityType::Bullet);
+		entityManager->FireBullet();
 
 		numBullets++;
 
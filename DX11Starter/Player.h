@@ -11,7 +11,7 @@ class Player :
 	public Entity
 {
 public:
-	Player(Mesh* m, Material* mat, int type, Emitter * E_M_I_T);
+	Player(Mesh* m, Material* mat, int type, Emitter * E_M_I_T, TransformStore* transforms);
 	~Player();
 
 	// Update the player
@@ -0,0 +1,133 @@
+#include "RadixSort.h"
+#include <cstring>
+#include <utility>
+
+// Each pass sorts on one byte of the key
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+// Smallest block worth handing to its own job, below this the counting costs more than it saves
+#define RADIX_MIN_BLOCK_SIZE 4096
+
+RadixSort::RadixSort()
+{
+	blockCount = 0;
+	blockSize = 0;
+}
+
+RadixSort::~RadixSort()
+{
+}
+
+void RadixSort::Sort(unsigned int* keys, unsigned int* values, int count, int keyBits, JobPool* jobPool)
+{
+	SortKeys(keys, values, count, keyBits, jobPool, scratchKeys);
+}
+
+void RadixSort::Sort(unsigned long long* keys, unsigned int* values, int count, int keyBits, JobPool* jobPool)
+{
+	SortKeys(keys, values, count, keyBits, jobPool, scratchWideKeys);
+}
+
+template <typename Key>
+void RadixSort::SortKeys(Key* keys, unsigned int* values, int count, int keyBits, JobPool* jobPool, std::vector<Key>& scratchKeys)
+{
+	if (count <= 1 || keyBits <= 0)
+		return;
+
+	if ((int)scratchKeys.size() < count)
+		scratchKeys.resize(count);
+	if ((int)scratchValues.size() < count)
+		scratchValues.resize(count);
+
+	// One block per thread, unless that would make the blocks too small to be worth it
+	int threadCount = jobPool ? (int)jobPool->GetThreadCount() : 1;
+	blockCount = count / RADIX_MIN_BLOCK_SIZE;
+	if (blockCount > threadCount) blockCount = threadCount;
+	if (blockCount < 1) blockCount = 1;
+	blockSize = (count + blockCount - 1) / blockCount;
+	blockOffsets.resize(blockCount * RADIX_BUCKETS);
+
+	// Each pass moves everything to the other buffer
+	Key* sourceKeys = keys;
+	unsigned int* sourceValues = values;
+	Key* destKeys = &scratchKeys[0];
+	unsigned int* destValues = &scratchValues[0];
+	int passCount = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+	for (int pass = 0; pass < passCount; pass++)
+	{
+		if (!SortPass(sourceKeys, sourceValues, destKeys, destValues, count, pass * RADIX_BITS, jobPool))
+			continue;
+
+		std::swap(sourceKeys, destKeys);
+		std::swap(sourceValues, destValues);
+	}
+
+	// An odd number of passes leaves the results in the scratch buffers
+	if (sourceKeys != keys)
+	{
+		memcpy(keys, sourceKeys, count * sizeof(Key));
+		memcpy(values, sourceValues, count * sizeof(unsigned int));
+	}
+}
+
+template <typename Key>
+bool RadixSort::SortPass(Key* sourceKeys, unsigned int* sourceValues, Key* destKeys, unsigned int* destValues, int count, int shift, JobPool* jobPool)
+{
+	// Count the digits in each block
+	auto countBlock = [&](int block)
+	{
+		int* counts = &blockOffsets[block * RADIX_BUCKETS];
+		memset(counts, 0, RADIX_BUCKETS * sizeof(int));
+
+		int start = block * blockSize;
+		int end = start + blockSize < count ? start + blockSize : count;
+		for (int i = start; i < end; i++)
+			counts[(int)(sourceKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+	};
+
+	// Each block writes its items after every smaller digit, and after earlier blocks' items of the
+	// same digit, which keeps the sort stable no matter which thread scatters which block
+	auto scatterBlock = [&](int block)
+	{
+		int* offsets = &blockOffsets[block * RADIX_BUCKETS];
+
+		int start = block * blockSize;
+		int end = start + blockSize < count ? start + blockSize : count;
+		for (int i = start; i < end; i++)
+		{
+			int destination = offsets[(int)(sourceKeys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			destKeys[destination] = sourceKeys[i];
+			destValues[destination] = sourceValues[i];
+		}
+	};
+
+	if (jobPool && blockCount > 1)
+		jobPool->ParallelFor(blockCount, countBlock);
+	else
+		countBlock(0);
+
+	// Turn the counts into offsets, digit by digit and block by block within each digit
+	int total = 0;
+	for (int digit = 0; digit < RADIX_BUCKETS; digit++)
+	{
+		int digitStart = total;
+		for (int block = 0; block < blockCount; block++)
+		{
+			int blockDigitCount = blockOffsets[block * RADIX_BUCKETS + digit];
+			blockOffsets[block * RADIX_BUCKETS + digit] = total;
+			total += blockDigitCount;
+		}
+
+		// Every key has this digit, so the order wouldn't change
+		if (total - digitStart == count)
+			return false;
+	}
+
+	if (jobPool && blockCount > 1)
+		jobPool->ParallelFor(blockCount, scatterBlock);
+	else
+		scatterBlock(0);
+
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "JobPool.h"
+
+// --------------------------------------------------------
+// A stable least significant digit radix sort of 32 or 64
+// bit keys, each carrying a 32 bit value (usually an index)
+// Every 8 bit pass is split into blocks: each block counts
+// its digits, the counts are turned into offsets, then each
+// block scatters its own items, so with a job pool the
+// counting and scattering run on every thread at once
+// Passes where every key has the same digit are skipped
+// Scratch space is kept between sorts to avoid allocating
+// --------------------------------------------------------
+class RadixSort
+{
+public:
+	RadixSort(); // Constructor
+	~RadixSort(); // Destructor
+
+	// Sorts keys in ascending order, moving values along with them
+	// Only the lowest keyBits bits of each key are looked at, so smaller keys take fewer passes
+	// Pass a job pool to spread each pass across threads, or null to sort on this thread
+	void Sort(unsigned int* keys, unsigned int* values, int count, int keyBits, JobPool* jobPool);
+	void Sort(unsigned long long* keys, unsigned int* values, int count, int keyBits, JobPool* jobPool);
+
+private:
+	// Runs every pass for either size of key, using the matching scratch keys
+	template <typename Key>
+	void SortKeys(Key* keys, unsigned int* values, int count, int keyBits, JobPool* jobPool, std::vector<Key>& scratchKeys);
+
+	// Counts and scatters one 8 bit digit from the source arrays into the destination arrays
+	// Returns false without scattering anything when every key has the same digit
+	template <typename Key>
+	bool SortPass(Key* sourceKeys, unsigned int* sourceValues, Key* destKeys, unsigned int* destValues, int count, int shift, JobPool* jobPool);
+
+	// Ping pong buffers for the passes
+	std::vector<unsigned int> scratchKeys;
+	std::vector<unsigned long long> scratchWideKeys;
+	std::vector<unsigned int> scratchValues;
+
+	// Digit counts for each block, later turned into each block's write offsets
+	std::vector<int> blockOffsets;
+	int blockCount;
+	int blockSize;
+};
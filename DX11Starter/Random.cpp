@@ -0,0 +1,108 @@
+#include "Random.h"
+
+// Spreads a seed out over a full 32 bit state word (splitmix32)
+static unsigned int SplitMix(unsigned int& seed)
+{
+	unsigned int z = (seed += 0x9E3779B9u);
+	z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+	z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+	return z ^ (z >> 16);
+}
+
+// Turns the top 24 bits of a random word into a float in [0, 1)
+static float ToUnitFloat(unsigned int bits)
+{
+	return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+Random::Random()
+{
+	Seed(1);
+}
+
+Random::Random(unsigned int seed)
+{
+	Seed(seed);
+}
+
+Random::~Random()
+{
+}
+
+void Random::Seed(unsigned int seed)
+{
+	for (int i = 0; i < 4; i++)
+		state[i] = SplitMix(seed);
+
+	// The bulk streams continue on from the same seed so they never line up with the scalar one
+	for (int lane = 0; lane < 4; lane++)
+	{
+		for (int i = 0; i < 4; i++)
+			lanes[i][lane] = SplitMix(seed);
+	}
+}
+
+unsigned int Random::NextUInt()
+{
+	return Next(state[0], state[1], state[2], state[3]);
+}
+
+float Random::NextFloat()
+{
+	return ToUnitFloat(NextUInt());
+}
+
+float Random::Range(float min, float max)
+{
+	return min + NextFloat() * (max - min);
+}
+
+int Random::RangeInt(int min, int max)
+{
+	// Scale into the range with a multiply rather than a modulo to avoid bias towards low values
+	unsigned int range = (unsigned int)(max - min);
+	return min + (int)(((unsigned long long)NextUInt() * range) >> 32);
+}
+
+void Random::FillRange(float* values, int count, float min, float max)
+{
+	float scale = (max - min) * (1.0f / 16777216.0f);
+	float block[4];
+
+	for (int i = 0; i < count; i += 4)
+	{
+		// Step all four streams at once, every lane doing exactly the same work
+		for (int lane = 0; lane < 4; lane++)
+		{
+			unsigned int result = lanes[0][lane] + lanes[3][lane];
+			unsigned int t = lanes[1][lane] << 9;
+			lanes[2][lane] ^= lanes[0][lane];
+			lanes[3][lane] ^= lanes[1][lane];
+			lanes[1][lane] ^= lanes[2][lane];
+			lanes[0][lane] ^= lanes[3][lane];
+			lanes[2][lane] ^= t;
+			lanes[3][lane] = (lanes[3][lane] << 11) | (lanes[3][lane] >> 21);
+			block[lane] = min + (result >> 8) * scale;
+		}
+
+		// Only part of the last block is needed when the count isn't a multiple of 4
+		int remaining = count - i < 4 ? count - i : 4;
+		for (int lane = 0; lane < remaining; lane++)
+			values[i + lane] = block[lane];
+	}
+}
+
+unsigned int Random::Next(unsigned int& s0, unsigned int& s1, unsigned int& s2, unsigned int& s3)
+{
+	unsigned int result = s0 + s3;
+	unsigned int t = s1 << 9;
+
+	s2 ^= s0;
+	s3 ^= s1;
+	s1 ^= s2;
+	s0 ^= s3;
+	s2 ^= t;
+	s3 = (s3 << 11) | (s3 >> 21);
+
+	return result;
+}
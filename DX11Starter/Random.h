@@ -0,0 +1,40 @@
+#pragma once
+
+// --------------------------------------------------------
+// A small seeded random number generator (xoshiro128+)
+// Each system that needs random numbers carries its own,
+// so results only depend on the seed and the order of
+// calls on that generator, never on other threads
+// FillRange runs four independent streams side by side
+// (in plain loops the compiler can turn into SIMD) for
+// generating many values at once, like particle bursts
+// --------------------------------------------------------
+class Random
+{
+public:
+	Random(); // Constructor (seeded with 1)
+	Random(unsigned int seed); // Constructor
+	~Random(); // Destructor
+
+	// Resets the generator so the same seed always gives the same sequence
+	void Seed(unsigned int seed);
+
+	// Single values
+	unsigned int NextUInt();
+	float NextFloat(); // [0, 1)
+	float Range(float min, float max); // [min, max)
+	int RangeInt(int min, int max); // [min, max)
+
+	// Fills an array with values in [min, max), four at a time
+	void FillRange(float* values, int count, float min, float max);
+
+private:
+	// Advances a xoshiro128+ state and returns its next output
+	static unsigned int Next(unsigned int& s0, unsigned int& s1, unsigned int& s2, unsigned int& s3);
+
+	// State of the scalar generator
+	unsigned int state[4];
+
+	// States of the four bulk streams, one lane per stream so each word sits in a single vector
+	unsigned int lanes[4][4];
+};
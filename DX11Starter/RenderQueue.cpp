@@ -0,0 +1,76 @@
+#include "RenderQueue.h"
+#include <cfloat>
+
+// Bits given to each part of the sort key, from the top down
+#define RENDER_KEY_FIELD_BITS 16
+#define RENDER_KEY_FIELD_MASK 0xffff
+#define RENDER_KEY_DEPTH_MAX 65535.0f
+
+RenderQueue::RenderQueue()
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+void RenderQueue::Clear()
+{
+	keys.clear();
+	items.clear();
+	depths.clear();
+}
+
+void RenderQueue::Add(unsigned int item, Material* material, Mesh* mesh, float viewDepth)
+{
+	Add(item, material->GetShaderId(), material->GetMaterialId(), mesh->GetMeshId(), viewDepth);
+}
+
+void RenderQueue::Add(unsigned int item, unsigned int shaderId, unsigned int materialId, unsigned int meshId, float viewDepth)
+{
+	// Pack the state ids now, the depth is filled in once the range of depths is known
+	unsigned long long key =
+		((unsigned long long)(shaderId & RENDER_KEY_FIELD_MASK) << (RENDER_KEY_FIELD_BITS * 3)) |
+		((unsigned long long)(materialId & RENDER_KEY_FIELD_MASK) << (RENDER_KEY_FIELD_BITS * 2)) |
+		((unsigned long long)(meshId & RENDER_KEY_FIELD_MASK) << RENDER_KEY_FIELD_BITS);
+
+	keys.push_back(key);
+	items.push_back(item);
+	depths.push_back(viewDepth);
+}
+
+void RenderQueue::Sort(JobPool* jobPool)
+{
+	if (items.empty())
+		return;
+
+	// Quantize the depths across the range they cover so the nearest item gets the smallest depth bits
+	float minDepth = FLT_MAX;
+	float maxDepth = -FLT_MAX;
+	for (size_t i = 0; i < depths.size(); i++)
+	{
+		if (depths[i] < minDepth) minDepth = depths[i];
+		if (depths[i] > maxDepth) maxDepth = depths[i];
+	}
+
+	float depthScale = maxDepth > minDepth ? RENDER_KEY_DEPTH_MAX / (maxDepth - minDepth) : 0.0f;
+	for (size_t i = 0; i < keys.size(); i++)
+		keys[i] |= (unsigned long long)((depths[i] - minDepth) * depthScale + 0.5f);
+
+	sort.Sort(&keys[0], &items[0], (int)items.size(), 64, jobPool);
+}
+
+int RenderQueue::GetCount()
+{
+	return (int)items.size();
+}
+
+unsigned int RenderQueue::GetItem(int index)
+{
+	return items[index];
+}
+
+unsigned long long RenderQueue::GetStateKey(int index)
+{
+	return keys[index] >> RENDER_KEY_FIELD_BITS;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "Material.h"
+#include "Mesh.h"
+#include "RadixSort.h"
+
+// How much state binding a frame's worth of queued draws did, for profiling
+struct RenderStateCounters
+{
+	int draws; // Draw calls, each drawing one or more instances
+	int instances;
+	int shaderChanges;
+	int materialChanges;
+	int meshChanges;
+	int stateChangesAvoided; // Shader, material and mesh binds skipped because the previous draw already had them set
+};
+
+// --------------------------------------------------------
+// Orders a frame's draws so that state only has to change
+// when it actually differs from the previous draw. Every
+// item gets a 64 bit key made of (from most significant)
+// its shaders, material, mesh and view depth, and the keys
+// are radix sorted, which groups everything sharing shaders,
+// then materials, then meshes, nearest first within a group
+// The shader, material and mesh ids come from the objects
+// themselves (handed out as each was made), so queuing an
+// item is just packing a key and the order is stable from
+// frame to frame
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue(); // Constructor
+	~RenderQueue(); // Destructor
+
+	// Empties the queue for the next frame
+	void Clear();
+
+	// Queues an item (usually an entity index) drawn with the given material and mesh
+	void Add(unsigned int item, Material* material, Mesh* mesh, float viewDepth);
+	void Add(unsigned int item, unsigned int shaderId, unsigned int materialId, unsigned int meshId, float viewDepth); // Takes the ids directly
+
+	// Puts the queued items into drawing order
+	void Sort(JobPool* jobPool);
+
+	// GET methods
+	int GetCount();
+	unsigned int GetItem(int index); // The item at the given position in drawing order
+	unsigned long long GetStateKey(int index); // The shaders, material and mesh part of that item's key
+
+private:
+	// The queued items, their keys (without depth until sorting) and depths
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned int> items;
+	std::vector<float> depths;
+
+	RadixSort sort;
+};
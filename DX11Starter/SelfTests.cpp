@@ -0,0 +1,878 @@
+#include "SelfTests.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Emitter.h"
+#include "InstanceBatcher.h"
+#include "MeshOptimizer.h"
+#include "ParticleColliderGrid.h"
+#include "ParticleBudget.h"
+#include "Random.h"
+#include "RenderQueue.h"
+#include "SimpleShader.h"
+
+// Value written over instance buffers before a test, so untouched slots can be spotted
+#define UNWRITTEN_INSTANCE_BYTE 0xCD
+
+// Mesh optimizer test grid, in quads along each side, and the cache size Mesh simulates
+#define TEST_GRID_QUADS 32
+#define TEST_CACHE_SIZE 16
+
+// Particle collision test: circles in the collider grid (at the game's cell size) and points checked against them
+#define TEST_COLLIDER_COUNT 100
+#define TEST_COLLIDER_CELL_SIZE 10.0f
+#define TEST_COLLIDER_POINTS 10000
+
+// Radix sort test: keys sorted (enough to split into several blocks) and threads in the pool that sorts them
+#define TEST_SORT_COUNT 5000
+#define TEST_SORT_THREADS 4
+
+// Failed checks in the current run
+static int failures = 0;
+
+// --------------------------------------------------------
+// Prints a line of results and appends it to SelfTests.txt,
+// since there is no console to read when running headless
+// --------------------------------------------------------
+static void Report(const char* format, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	printf("%s\n", line);
+
+	FILE* log = nullptr;
+	if (fopen_s(&log, "SelfTests.txt", "a") == 0 && log)
+	{
+		fprintf(log, "%s\n", line);
+		fclose(log);
+	}
+}
+
+// --------------------------------------------------------
+// Records a failure (with where it happened) when a check is false
+// --------------------------------------------------------
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+static void Check(bool passed, const char* condition, const char* file, int line)
+{
+	if (passed)
+		return;
+
+	failures++;
+	Report("FAILED %s(%d): %s", file, line, condition);
+}
+
+// --------------------------------------------------------
+// Whether an instance still holds the unwritten fill value
+// --------------------------------------------------------
+static bool IsUnwritten(const ParticleInstance& instance)
+{
+	const unsigned char* bytes = (const unsigned char*)&instance;
+	for (size_t i = 0; i < sizeof(ParticleInstance); i++)
+		if (bytes[i] != UNWRITTEN_INSTANCE_BYTE)
+			return false;
+	return true;
+}
+
+// --------------------------------------------------------
+// Whether an instance sits within a distance of a point on every axis
+// --------------------------------------------------------
+static bool IsNear(const ParticleInstance& instance, DirectX::XMFLOAT3 point, float distance)
+{
+	return
+		fabsf(instance.Position.x - point.x) <= distance &&
+		fabsf(instance.Position.y - point.y) <= distance &&
+		fabsf(instance.Position.z - point.z) <= distance;
+}
+
+// --------------------------------------------------------
+// Packs a triangle into one key, rotated so its smallest
+// vertex comes first, which keeps the winding but ignores
+// which corner the triangle starts from
+// --------------------------------------------------------
+static unsigned long long TriangleKey(unsigned int a, unsigned int b, unsigned int c)
+{
+	while (a > b || a > c)
+	{
+		unsigned int first = a;
+		a = b;
+		b = c;
+		c = first;
+	}
+	return ((unsigned long long)a << 42) | ((unsigned long long)b << 21) | c;
+}
+
+// --------------------------------------------------------
+// Every triangle of an index buffer as a sorted list of keys,
+// with each index first mapped through a table when given one
+// --------------------------------------------------------
+static std::vector<unsigned long long> TriangleKeys(const std::vector<unsigned int>& indices, const std::vector<unsigned int>* remap)
+{
+	std::vector<unsigned long long> keys;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = remap ? (*remap)[indices[i]] : indices[i];
+		unsigned int b = remap ? (*remap)[indices[i + 1]] : indices[i + 1];
+		unsigned int c = remap ? (*remap)[indices[i + 2]] : indices[i + 2];
+		keys.push_back(TriangleKey(a, b, c));
+	}
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+// --------------------------------------------------------
+// A shuffled grid gets fewer simulated cache misses after
+// OptimizeVertexCache, and neither pass changes the mesh:
+// the same triangles (with the same winding) still use the
+// same vertex data, only the order of both changes
+// --------------------------------------------------------
+static void TestMeshOptimizerGrid()
+{
+	const int side = TEST_GRID_QUADS + 1;
+	const int vertexCount = side * side;
+
+	// Every vertex's position says where it sits in the grid
+	std::vector<Vertex> grid(vertexCount);
+	for (int z = 0; z < side; z++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			Vertex& vertex = grid[z * side + x];
+			vertex.Position = DirectX::XMFLOAT3((float)x, 0, (float)z);
+			vertex.Normal = DirectX::XMFLOAT3(0, 1, 0);
+			vertex.Tangent = DirectX::XMFLOAT3(1, 0, 0);
+			vertex.UV = DirectX::XMFLOAT2((float)x / TEST_GRID_QUADS, (float)z / TEST_GRID_QUADS);
+		}
+	}
+
+	// Two triangles per quad, in a random order so the cache has something to fix
+	std::vector<unsigned int> triangles;
+	for (int z = 0; z < TEST_GRID_QUADS; z++)
+	{
+		for (int x = 0; x < TEST_GRID_QUADS; x++)
+		{
+			unsigned int corner = z * side + x;
+			unsigned int quad[6] = { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 };
+			triangles.insert(triangles.end(), quad, quad + 6);
+		}
+	}
+	Random random(1);
+	int triangleCount = (int)triangles.size() / 3;
+	for (int t = triangleCount - 1; t > 0; t--)
+	{
+		int other = random.RangeInt(0, t + 1);
+		for (int corner = 0; corner < 3; corner++)
+			std::swap(triangles[t * 3 + corner], triangles[other * 3 + corner]);
+	}
+
+	std::vector<unsigned long long> gridTriangles = TriangleKeys(triangles, 0);
+	VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&triangles[0], (int)triangles.size(), vertexCount, TEST_CACHE_SIZE);
+
+	// Reordering triangles only changes their order
+	std::vector<unsigned int> indices = triangles;
+	MeshOptimizer::OptimizeVertexCache(&indices[0], (int)indices.size(), vertexCount);
+	VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&indices[0], (int)indices.size(), vertexCount, TEST_CACHE_SIZE);
+	CHECK(after.acmr < before.acmr);
+	CHECK(TriangleKeys(indices, 0) == gridTriangles);
+
+	// Reordering vertices keeps every one (they're all used) and each triangle's vertex data
+	std::vector<Vertex> vertices = grid;
+	int fetchedCount = MeshOptimizer::OptimizeVertexFetch(&vertices[0], vertexCount, &indices[0], (int)indices.size());
+	CHECK(fetchedCount == vertexCount);
+	if (fetchedCount != vertexCount)
+		return;
+
+	// Find each moved vertex's grid slot from its position, then check the rest of it came along
+	std::vector<unsigned int> gridSlots(vertexCount);
+	std::vector<bool> slotUsed(vertexCount, false);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		int x = (int)vertices[i].Position.x;
+		int z = (int)vertices[i].Position.z;
+		unsigned int slot = z * side + x;
+		CHECK(x >= 0 && x < side && z >= 0 && z < side && !slotUsed[slot]);
+		if (x < 0 || x >= side || z < 0 || z >= side || slotUsed[slot])
+			return;
+
+		slotUsed[slot] = true;
+		gridSlots[i] = slot;
+		CHECK(memcmp(&vertices[i], &grid[slot], sizeof(Vertex)) == 0);
+	}
+	CHECK(TriangleKeys(indices, &gridSlots) == gridTriangles);
+	VertexCacheStats fetched = MeshOptimizer::AnalyzeVertexCache(&indices[0], (int)indices.size(), vertexCount, TEST_CACHE_SIZE);
+	CHECK(fetched.acmr == after.acmr);
+}
+
+// --------------------------------------------------------
+// The instance record must match the particle vertex shader's
+// slot 1 input layout: float3 position, RGBA8 color, float size
+// --------------------------------------------------------
+static void TestParticleInstanceLayout()
+{
+	CHECK(sizeof(ParticleInstance) == 20);
+	CHECK(offsetof(ParticleInstance, Position) == 0);
+	CHECK(offsetof(ParticleInstance, Color) == 12);
+	CHECK(offsetof(ParticleInstance, Size) == 16);
+}
+
+// --------------------------------------------------------
+// Colors pack to RGBA8 with red in the lowest byte, each
+// channel clamped to [0, 1] and rounded to the nearest byte
+// --------------------------------------------------------
+static void TestPackParticleColor()
+{
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(0, 0, 0, 0)) == 0x00000000);
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(1, 1, 1, 1)) == 0xFFFFFFFF);
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(1, 0, 0, 1)) == 0xFF0000FF);
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(0, 1, 0, 0)) == 0x0000FF00);
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(0, 0, 1, 0)) == 0x00FF0000);
+
+	// Out of range channels clamp
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(-1, 2, -0.5f, 10)) == 0xFF00FF00);
+
+	// Rounding to the nearest byte: 0.5 * 255 = 127.5 rounds up, 0.2 * 255 = 51
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(0.5f, 0.2f, 0, 0)) == 0x00003380);
+	CHECK(PackParticleColor(DirectX::XMFLOAT4(0.001f, 0.003f, 0, 0)) == 0x00000100);
+}
+
+// --------------------------------------------------------
+// Instances land in the ring slots the draw calls read from,
+// including when the living particles wrap past the end of
+// the ring, and every other slot is left alone
+// --------------------------------------------------------
+static void TestParticleInstanceRingLayout()
+{
+	const int maxParticles = 8;
+	const float stepTime = 0.3f;
+	const DirectX::XMFLOAT3 originA(100, 0, 0);
+	const DirectX::XMFLOAT3 originB(200, 0, 0);
+	const DirectX::XMFLOAT3 originC(300, 0, 0);
+
+	// Simulation only emitter whose particles only come from bursts
+	// Half second lifetimes mean each burst is gone two steps after it spawns
+	Emitter emitter(0, maxParticles, 0, 0, 0, 0, 0);
+	emitter.SetLifetime(0.5f);
+	emitter.SetParticlesPerSecod(1);
+	emitter.SetEmitterAcceleration(DirectX::XMFLOAT3(0, 0, 0));
+	emitter.SetStartColor(DirectX::XMFLOAT4(1, 0, 0, 1));
+	emitter.SetEndColor(DirectX::XMFLOAT4(1, 0, 0, 1));
+	emitter.SetStartSize(1.0f);
+	emitter.SetEndSize(0.5f);
+
+	// Nothing alive writes nothing
+	ParticleInstance instances[maxParticles];
+	memset(instances, UNWRITTEN_INSTANCE_BYTE, sizeof(instances));
+	emitter.WriteInstances(instances);
+	CHECK(IsUnwritten(instances[0]));
+	CHECK(IsUnwritten(instances[maxParticles - 1]));
+
+	// A: slots 0 to 3
+	emitter.SetBurstSize(4);
+	emitter.Explode(originA);
+	emitter.Update(stepTime);
+
+	// B: slots 4 to 6
+	emitter.SetBurstSize(3);
+	emitter.Explode(originB);
+	emitter.Update(stepTime);
+
+	// A dies and C wraps around the end of the ring into slots 7, 0, 1 and 2
+	emitter.SetBurstSize(4);
+	emitter.Explode(originC);
+	emitter.Update(stepTime);
+	CHECK(emitter.GetLivingParticleCount() == 7);
+
+	memset(instances, UNWRITTEN_INSTANCE_BYTE, sizeof(instances));
+	emitter.WriteInstances(instances);
+
+	// Burst particles move at most about 5.2 units a second on each axis
+	const float maxTravel = 5.2f * stepTime * 2.0f + 0.01f;
+	const int slotsB[] = { 4, 5, 6 };
+	const int slotsC[] = { 7, 0, 1, 2 };
+	for (int i = 0; i < _countof(slotsB); i++)
+		CHECK(IsNear(instances[slotsB[i]], originB, maxTravel));
+	for (int i = 0; i < _countof(slotsC); i++)
+		CHECK(IsNear(instances[slotsC[i]], originC, maxTravel));
+
+	// The one dead slot between the two ring ranges is never written
+	CHECK(IsUnwritten(instances[3]));
+
+	for (int i = 0; i < maxParticles; i++)
+	{
+		if (i == 3)
+			continue;
+
+		CHECK(instances[i].Color == 0xFF0000FF);
+		CHECK(instances[i].Size <= 1.0f && instances[i].Size >= 0.5f);
+	}
+}
+
+// --------------------------------------------------------
+// The particle collider grid finds exactly the circles a
+// brute force test does, and a particle flying into a circle
+// is hidden by Kill or pushed out and turned back by Bounce
+// --------------------------------------------------------
+static void TestParticleCollisions()
+{
+	// A field of overlapping circles, with points scattered over it and past its edges
+	Random random(2);
+	float circles[TEST_COLLIDER_COUNT][3];
+	ParticleColliderGrid grid(TEST_COLLIDER_CELL_SIZE);
+	for (int c = 0; c < TEST_COLLIDER_COUNT; c++)
+	{
+		circles[c][0] = random.Range(-50.0f, 50.0f);
+		circles[c][1] = random.Range(-50.0f, 50.0f);
+		circles[c][2] = random.Range(0.5f, 8.0f);
+		grid.AddCollider(circles[c][0], circles[c][1], circles[c][2]);
+	}
+	grid.Build();
+	CHECK(grid.GetColliderCount() == TEST_COLLIDER_COUNT);
+
+	int mismatches = 0;
+	for (int p = 0; p < TEST_COLLIDER_POINTS; p++)
+	{
+		float x = random.Range(-70.0f, 70.0f);
+		float z = random.Range(-70.0f, 70.0f);
+
+		bool inside = false;
+		for (int c = 0; c < TEST_COLLIDER_COUNT && !inside; c++)
+		{
+			float dx = x - circles[c][0];
+			float dz = z - circles[c][1];
+			inside = dx * dx + dz * dz < circles[c][2] * circles[c][2];
+		}
+
+		// Any circle the grid hands back has to contain the point
+		float colliderX, colliderZ, colliderRadius;
+		bool found = grid.FindCollider(x, z, colliderX, colliderZ, colliderRadius);
+		if (found)
+		{
+			float dx = x - colliderX;
+			float dz = z - colliderZ;
+			found = dx * dx + dz * dz < colliderRadius * colliderRadius;
+		}
+		if (found != inside)
+			mismatches++;
+	}
+	CHECK(mismatches == 0);
+
+	// One circle spanning x = 3.5 to 7.5, with a particle heading along +x at 10 units a second
+	// It's still short of the circle after 3 steps and inside it after 4
+	const float stepTime = 0.1f;
+	ParticleColliderGrid wall(TEST_COLLIDER_CELL_SIZE);
+	wall.AddCollider(5.5f, 0.0f, 2.0f);
+	wall.Build();
+
+	const ParticleCollision modes[] = { ParticleCollision::Kill, ParticleCollision::Bounce };
+	for (int m = 0; m < _countof(modes); m++)
+	{
+		// Simulation only emitter with no emission of its own, just the one particle
+		Emitter emitter(0, 4, 0, 0, 0, 0, 0);
+		emitter.SetLifetime(10.0f);
+		emitter.SetSpawnScale(0.0f);
+		emitter.SetEmitterAcceleration(DirectX::XMFLOAT3(0, 0, 0));
+		emitter.SetStartSize(1.0f);
+		emitter.SetEndSize(1.0f);
+		emitter.SetCollision(modes[m], &wall);
+		emitter.SetBounciness(0.5f);
+		emitter.SpawnExplosionParticle(DirectX::XMFLOAT3(0, 0, 0), DirectX::XMFLOAT3(10, 0, 0));
+
+		ParticleInstance instance;
+		for (int step = 0; step < 3; step++)
+			emitter.Update(stepTime);
+		emitter.WriteInstances(&instance);
+		CHECK(instance.Size == 1.0f);
+		CHECK(fabsf(instance.Position.x - 3.0f) < 0.001f);
+
+		emitter.Update(stepTime);
+		emitter.WriteInstances(&instance);
+		if (modes[m] == ParticleCollision::Kill)
+		{
+			// Killed particles keep their slot but are never drawn again
+			CHECK(emitter.GetLivingParticleCount() == 1);
+			CHECK(instance.Size == 0.0f);
+			emitter.Update(stepTime);
+			emitter.WriteInstances(&instance);
+			CHECK(instance.Size == 0.0f);
+		}
+		else
+		{
+			// Pushed back to the edge, then heading out at half the speed it came in with
+			CHECK(instance.Size == 1.0f);
+			CHECK(fabsf(instance.Position.x - 3.5f) < 0.001f);
+			emitter.Update(stepTime);
+			emitter.WriteInstances(&instance);
+			CHECK(fabsf(instance.Position.x - 3.0f) < 0.001f);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Distant emitters drop to fewer updates, except ones whose
+// particles stay where they spawned, since those particles
+// can be anywhere no matter where the emitter sits
+// --------------------------------------------------------
+static void TestParticleBudgetDistanceLod()
+{
+	const float deltaTime = 1.0f / 60.0f;
+
+	ParticleBudget budget;
+	budget.SetLodDistance(100.0f);
+
+	Emitter following(0, 8, 0, 0, 0, 0, 0);
+	Emitter worldSpace(0, 8, 0, 0, 0, 0, 0);
+	worldSpace.SetFollowEmitter(false);
+
+	// Both emitters sit at the origin, over the maximum LOD distance from the viewer
+	budget.BeginFrame(DirectX::XMFLOAT3(1000, 0, 0));
+	CHECK(budget.PlanEmitter(&following, deltaTime) == 0.0f);
+	CHECK(budget.PlanEmitter(&worldSpace, deltaTime) == deltaTime);
+	budget.EndFrame();
+
+	// The world space emitter keeps updating every frame, the other catches up every 8
+	int followingUpdates = 0;
+	for (int frame = 1; frame < 8; frame++)
+	{
+		budget.BeginFrame(DirectX::XMFLOAT3(1000, 0, 0));
+		if (budget.PlanEmitter(&following, deltaTime) > 0.0f)
+			followingUpdates++;
+		CHECK(budget.PlanEmitter(&worldSpace, deltaTime) == deltaTime);
+		budget.EndFrame();
+	}
+	CHECK(followingUpdates == 1);
+}
+
+// --------------------------------------------------------
+// Makes an instance whose every field says which one it is
+// --------------------------------------------------------
+static EntityInstance MakeTestInstance(int index)
+{
+	EntityInstance instance = {};
+	instance.World._41 = (float)index;
+	instance.World._44 = 1.0f;
+	instance.Offices = (float)index * 2.0f;
+	instance.RandSeed = index * 3;
+	return instance;
+}
+
+// --------------------------------------------------------
+// 64 bit radix sorts match a stable sort of the same keys,
+// with and without a job pool, including keys whose middle
+// digits never change (so those passes are skipped) and
+// plenty of duplicates (so stability shows)
+// --------------------------------------------------------
+static void TestRadixSort64()
+{
+	Random random(3);
+	std::vector<std::pair<unsigned long long, unsigned int>> expected(TEST_SORT_COUNT);
+	for (int i = 0; i < TEST_SORT_COUNT; i++)
+	{
+		// Few distinct values up top, a constant byte and word in the middle, and a small spread at the bottom
+		unsigned long long high = random.NextUInt() % 5;
+		unsigned long long low = random.NextUInt() % 300;
+		expected[i].first = (high << 56) | (0xABull << 40) | (0x1234ull << 16) | low;
+		expected[i].second = (unsigned int)i;
+	}
+
+	// Sorting pairs by key alone keeps equal keys in the order they were added
+	std::vector<std::pair<unsigned long long, unsigned int>> sorted = expected;
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const std::pair<unsigned long long, unsigned int>& a, const std::pair<unsigned long long, unsigned int>& b) { return a.first < b.first; });
+
+	RadixSort sort;
+	JobPool jobPool(TEST_SORT_THREADS);
+	JobPool* pools[] = { nullptr, &jobPool };
+	for (int p = 0; p < _countof(pools); p++)
+	{
+		std::vector<unsigned long long> keys(TEST_SORT_COUNT);
+		std::vector<unsigned int> values(TEST_SORT_COUNT);
+		for (int i = 0; i < TEST_SORT_COUNT; i++)
+		{
+			keys[i] = expected[i].first;
+			values[i] = expected[i].second;
+		}
+
+		sort.Sort(&keys[0], &values[0], TEST_SORT_COUNT, 64, pools[p]);
+
+		int mismatches = 0;
+		for (int i = 0; i < TEST_SORT_COUNT; i++)
+			if (keys[i] != sorted[i].first || values[i] != sorted[i].second)
+				mismatches++;
+		CHECK(mismatches == 0);
+	}
+}
+
+// --------------------------------------------------------
+// Queued draws come out grouped by shaders, then material,
+// then mesh, nearest first within a group, whatever order
+// they were added in
+// --------------------------------------------------------
+static void TestRenderQueueOrder()
+{
+	// Items are numbered in the order they should be drawn: shader id, material id, mesh id, depth
+	const unsigned int ids[][3] = {
+		{ 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 2 }, { 0, 3, 1 },
+		{ 1, 1, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 2, 0 } };
+	const float depths[] = { 1.0f, 50.0f, 0.5f, 2.0f, 0.1f, 100.0f, 7.0f, 3.0f };
+	const int addOrder[] = { 5, 2, 7, 0, 3, 6, 1, 4 };
+
+	RenderQueue queue;
+	for (int run = 0; run < 2; run++)
+	{
+		// The second run checks that clearing leaves nothing behind from the first
+		queue.Clear();
+		for (int i = 0; i < _countof(addOrder); i++)
+		{
+			int item = addOrder[i];
+			queue.Add(item, ids[item][0], ids[item][1], ids[item][2], depths[item]);
+		}
+		queue.Sort(nullptr);
+
+		CHECK(queue.GetCount() == _countof(addOrder));
+		for (int i = 0; i < queue.GetCount(); i++)
+		{
+			unsigned int item = queue.GetItem(i);
+			CHECK(item == (unsigned int)i);
+			if (item < _countof(ids))
+				CHECK(queue.GetStateKey(i) == (((unsigned long long)ids[item][0] << 32) | ((unsigned long long)ids[item][1] << 16) | ids[item][2]));
+		}
+	}
+
+	// Depth only breaks ties, and equal depths keep the order they were added in
+	queue.Clear();
+	queue.Add(0, 0, 0, 0, 4.0f);
+	queue.Add(1, 0, 0, 0, 4.0f);
+	queue.Add(2, 0, 0, 0, 4.0f);
+	queue.Sort(nullptr);
+	CHECK(queue.GetItem(0) == 0 && queue.GetItem(1) == 1 && queue.GetItem(2) == 2);
+}
+
+// --------------------------------------------------------
+// Draws in state order become one batch per run of equal
+// state keys, and every instance is packed back to back in
+// the order it was added, ready for one buffer copy
+// --------------------------------------------------------
+static void TestInstanceBatcherGrouping()
+{
+	// The instance record must match the entity vertex shaders' slot 1 input layout
+	CHECK(sizeof(EntityInstance) == 72);
+	CHECK(offsetof(EntityInstance, World) == 0);
+	CHECK(offsetof(EntityInstance, Offices) == 64);
+	CHECK(offsetof(EntityInstance, RandSeed) == 68);
+
+	InstanceBatcher batcher;
+	CHECK(batcher.GetBatchCount() == 0);
+	CHECK(batcher.GetInstanceCount() == 0);
+	CHECK(batcher.GetInstances() == nullptr);
+
+	// Two runs of one key around a run of another, the second run can't join the first
+	const unsigned long long keys[] = { 7, 7, 3, 3, 3, 7 };
+	const unsigned int items[] = { 10, 11, 12, 13, 14, 15 };
+	for (int i = 0; i < _countof(keys); i++)
+		batcher.Add(keys[i], items[i], MakeTestInstance(i));
+
+	CHECK(batcher.GetBatchCount() == 3);
+	CHECK(batcher.GetInstanceCount() == 6);
+	if (batcher.GetBatchCount() == 3)
+	{
+		const int expectedFirst[] = { 0, 2, 5 };
+		const int expectedCount[] = { 2, 3, 1 };
+		for (int b = 0; b < 3; b++)
+		{
+			InstanceBatch batch = batcher.GetBatch(b);
+			CHECK(batch.stateKey == keys[expectedFirst[b]]);
+			CHECK(batch.firstItem == items[expectedFirst[b]]);
+			CHECK(batch.firstInstance == expectedFirst[b]);
+			CHECK(batch.instanceCount == expectedCount[b]);
+		}
+	}
+
+	const EntityInstance* instances = batcher.GetInstances();
+	for (int i = 0; i < batcher.GetInstanceCount(); i++)
+	{
+		EntityInstance expected = MakeTestInstance(i);
+		CHECK(memcmp(&instances[i], &expected, sizeof(EntityInstance)) == 0);
+	}
+
+	// Clearing starts the next frame from nothing, even with the same key as the last batch
+	batcher.Clear();
+	CHECK(batcher.GetBatchCount() == 0);
+	CHECK(batcher.GetInstanceCount() == 0);
+	batcher.Add(7, 20, MakeTestInstance(0));
+	CHECK(batcher.GetBatchCount() == 1);
+	CHECK(batcher.GetBatch(0).firstInstance == 0);
+	CHECK(batcher.GetBatch(0).firstItem == 20);
+	CHECK(batcher.GetBatch(0).instanceCount == 1);
+}
+
+// --------------------------------------------------------
+// A shader without a device, laid out by hand instead of by
+// reflection, that records the constant buffer copies it
+// would have made instead of making them
+// Buffer 0 (64 bytes): color at 0, tint at 16, offset at 20, fade at 48
+// Buffer 1 (16 bytes, shared): time at 0
+// --------------------------------------------------------
+class TestShader : public ISimpleShader
+{
+public:
+	struct Upload
+	{
+		unsigned int buffer;
+		unsigned int start;
+		unsigned int end;
+	};
+	std::vector<Upload> uploads;
+
+	TestShader(bool partialUpdates) : ISimpleShader(0, 0)
+	{
+		shaderValid = true;
+		partialConstantBufferUpdates = partialUpdates;
+
+		constantBufferCount = 2;
+		constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+		AddBuffer(0, "perObject", 64);
+		AddBuffer(1, "perFrame", 16);
+		AddVariable("color", 0, 0, 16);
+		AddVariable("tint", 0, 16, 4);
+		AddVariable("offset", 0, 20, 4);
+		AddVariable("fade", 0, 48, 16);
+		AddVariable("time", 1, 0, 4);
+		AddShaderResourceView("texture", 0);
+		AddSampler("sampler", 0);
+
+		// What SetSharedConstantBuffer leaves behind, without needing a real buffer to share
+		constantBuffers[1].Shared = true;
+		constantBuffers[1].Dirty = false;
+		constantBuffers[1].DirtyStart = 0;
+		constantBuffers[1].DirtyEnd = 0;
+	}
+
+	~TestShader()
+	{
+		CleanUp();
+	}
+
+	// Resources only check their info, there's nothing to bind them to
+	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) { return SetShaderResourceView(GetShaderResourceViewInfo(name), srv); }
+	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) { return SetSamplerState(GetSamplerInfo(name), samplerState); }
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv) { return OwnsShaderResourceView(srvInfo); }
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState) { return OwnsSampler(sampInfo); }
+
+protected:
+	bool CreateShader(ID3DBlob* shaderBlob) { return true; }
+	void SetShaderAndCBs() {}
+
+	void UploadConstantBuffer(SimpleConstantBuffer* cb, unsigned int start, unsigned int end)
+	{
+		Upload upload = { (unsigned int)(cb - constantBuffers), start, end };
+		uploads.push_back(upload);
+	}
+
+private:
+	// Sets up a buffer the way loading a shader would, with every byte still to be copied
+	void AddBuffer(unsigned int index, std::string name, unsigned int size)
+	{
+		SimpleConstantBuffer& cb = constantBuffers[index];
+		cb.Name = name;
+		cb.Size = size;
+		cb.BindIndex = index;
+		cb.ConstantBuffer = 0;
+		cb.LocalDataBuffer = new unsigned char[size];
+		memset(cb.LocalDataBuffer, 0, size);
+		cb.Dirty = true;
+		cb.Shared = false;
+		cb.DirtyStart = 0;
+		cb.DirtyEnd = size;
+		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(name, &cb));
+	}
+
+	void AddShaderResourceView(std::string name, unsigned int bindIndex)
+	{
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = bindIndex;
+		srv->Index = (unsigned int)shaderResourceViews.size();
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(name, srv));
+		shaderResourceViews.push_back(srv);
+	}
+
+	void AddSampler(std::string name, unsigned int bindIndex)
+	{
+		SimpleSampler* sampler = new SimpleSampler();
+		sampler->BindIndex = bindIndex;
+		sampler->Index = (unsigned int)samplerStates.size();
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(name, sampler));
+		samplerStates.push_back(sampler);
+	}
+
+	void AddVariable(std::string name, unsigned int buffer, unsigned int offset, unsigned int size)
+	{
+		SimpleShaderVariable variable;
+		variable.ConstantBufferIndex = buffer;
+		variable.ByteOffset = offset;
+		variable.Size = size;
+		variable.Owner = this;
+		varTable.insert(std::pair<std::string, SimpleShaderVariable>(name, variable));
+		constantBuffers[buffer].Variables.push_back(variable);
+	}
+};
+
+// --------------------------------------------------------
+// Whether a shader recorded exactly one copy, of the given range of buffer 0
+// --------------------------------------------------------
+static bool UploadedOnly(TestShader& shader, unsigned int start, unsigned int end)
+{
+	return
+		shader.uploads.size() == 1 &&
+		shader.uploads[0].buffer == 0 &&
+		shader.uploads[0].start == start &&
+		shader.uploads[0].end == end;
+}
+
+// --------------------------------------------------------
+// Constant buffers track the range of bytes that changed
+// since their last copy: setting variables merges their
+// ranges, copying resets the range, setting a value that's
+// already there changes nothing and shared buffers are never
+// copied. Only the changed range (widened to whole 16 byte
+// constants) is copied when partial updates are supported,
+// and the whole buffer when they aren't
+// --------------------------------------------------------
+static void TestConstantBufferDirtyRanges()
+{
+	for (int partial = 0; partial < 2; partial++)
+	{
+		TestShader shader(partial == 1);
+		const SimpleShaderVariable* tint = shader.GetVariableInfo("tint");
+		const SimpleShaderVariable* offset = shader.GetVariableInfo("offset");
+		const SimpleShaderVariable* fade = shader.GetVariableInfo("fade");
+		const SimpleShaderVariable* time = shader.GetVariableInfo("time");
+		const SimpleConstantBuffer* perObject = shader.GetBufferInfo(0);
+		const SimpleConstantBuffer* perFrame = shader.GetBufferInfo(1);
+		CHECK(tint && offset && fade && time && perObject && perFrame);
+		if (!tint || !offset || !fade || !time || !perObject || !perFrame)
+			continue;
+
+		// A fresh buffer is copied whole, the shared one is left alone
+		ISimpleShader::ResetUploadCounters();
+		shader.CopyAllBufferData();
+		CHECK(UploadedOnly(shader, 0, 64));
+		CHECK(ISimpleShader::GetUploadCounters().buffersCopied == 1);
+		CHECK(ISimpleShader::GetUploadCounters().buffersSkipped == 1);
+		CHECK(ISimpleShader::GetUploadCounters().bytesCopied == 64);
+
+		// Copying resets the range, so a second copy has nothing to send
+		CHECK(!perObject->Dirty && perObject->DirtyStart == 0 && perObject->DirtyEnd == 0);
+		shader.uploads.clear();
+		shader.CopyAllBufferData();
+		CHECK(shader.uploads.empty());
+
+		// Setting the value that's already there changes nothing
+		CHECK(shader.SetFloat(tint, 0.0f));
+		CHECK(!perObject->Dirty);
+
+		// Two variables merge into one range covering both of them
+		ISimpleShader::ResetUploadCounters();
+		CHECK(shader.SetFloat(tint, 0.5f));
+		CHECK(perObject->Dirty && perObject->DirtyStart == 16 && perObject->DirtyEnd == 20);
+		CHECK(shader.SetFloat4(fade, DirectX::XMFLOAT4(1, 2, 3, 4)));
+		CHECK(perObject->DirtyStart == 16 && perObject->DirtyEnd == 64);
+		CHECK(shader.SetFloat(offset, 2.0f));
+		CHECK(perObject->DirtyStart == 16 && perObject->DirtyEnd == 64);
+
+		float tintValue = 0;
+		memcpy(&tintValue, perObject->LocalDataBuffer + 16, sizeof(float));
+		CHECK(tintValue == 0.5f);
+
+		shader.uploads.clear();
+		shader.CopyAllBufferData();
+		CHECK(partial ? UploadedOnly(shader, 16, 64) : UploadedOnly(shader, 0, 64));
+		CHECK(ISimpleShader::GetUploadCounters().bytesCopied == (partial ? 48u : 64u));
+		CHECK(ISimpleShader::GetUploadCounters().bytesChanged == 48);
+		CHECK(!perObject->Dirty && perObject->DirtyStart == 0 && perObject->DirtyEnd == 0);
+
+		// A range that doesn't start or end on a constant is widened to cover whole constants
+		ISimpleShader::ResetUploadCounters();
+		CHECK(shader.SetFloat(offset, 3.0f));
+		CHECK(perObject->DirtyStart == 20 && perObject->DirtyEnd == 24);
+		shader.uploads.clear();
+		shader.CopyBufferData(0);
+		CHECK(partial ? UploadedOnly(shader, 16, 32) : UploadedOnly(shader, 0, 64));
+		CHECK(ISimpleShader::GetUploadCounters().bytesChanged == 4);
+
+		// Shared buffers keep whatever is set locally but are never copied over
+		ISimpleShader::ResetUploadCounters();
+		CHECK(shader.SetFloat(time, 1.0f));
+		shader.uploads.clear();
+		shader.CopyAllBufferData();
+		CHECK(shader.uploads.empty());
+		CHECK(ISimpleShader::GetUploadCounters().buffersCopied == 0);
+		CHECK(ISimpleShader::GetUploadCounters().buffersSkipped == 2);
+	}
+}
+
+// --------------------------------------------------------
+// Variable, SRV and sampler info found on one shader only
+// works on that shader, since another shader's offsets and
+// bind points could point anywhere
+// Handing a shader another's info asserts in debug builds,
+// so that half only runs in release builds
+// --------------------------------------------------------
+static void TestShaderHandleOwnership()
+{
+	TestShader shader(false);
+	TestShader other(false);
+
+	// Null and the shader's own info behave as before
+	CHECK(!shader.SetFloat((const SimpleShaderVariable*)0, 1.0f));
+	CHECK(!shader.SetShaderResourceView((const SimpleSRV*)0, 0));
+	CHECK(!shader.SetSamplerState((const SimpleSampler*)0, 0));
+	CHECK(!shader.SetSharedConstantBuffer((const SimpleConstantBuffer*)0, 0));
+	CHECK(!shader.SetSharedConstantBuffer(shader.GetBufferInfo("perFrame"), 0));
+	CHECK(shader.SetFloat(shader.GetVariableInfo("tint"), 1.0f));
+	CHECK(shader.SetShaderResourceView(shader.GetShaderResourceViewInfo("texture"), 0));
+	CHECK(shader.SetSamplerState(shader.GetSamplerInfo("sampler"), 0));
+
+#ifdef NDEBUG
+	// The other shader's info has the same layout, so only ownership tells them apart
+	CHECK(!shader.SetFloat(other.GetVariableInfo("offset"), 2.0f));
+	CHECK(!shader.SetShaderResourceView(other.GetShaderResourceViewInfo("texture"), 0));
+	CHECK(!shader.SetSamplerState(other.GetSamplerInfo("sampler"), 0));
+
+	float offsetValue = -1.0f;
+	memcpy(&offsetValue, shader.GetBufferInfo(0)->LocalDataBuffer + 20, sizeof(float));
+	CHECK(offsetValue == 0.0f);
+#endif
+}
+
+// --------------------------------------------------------
+// Runs every test, reporting failures as they happen
+// --------------------------------------------------------
+int RunSelfTests()
+{
+	failures = 0;
+
+	TestMeshOptimizerGrid();
+	TestParticleInstanceLayout();
+	TestPackParticleColor();
+	TestParticleInstanceRingLayout();
+	TestParticleCollisions();
+	TestParticleBudgetDistanceLod();
+	TestRadixSort64();
+	TestRenderQueueOrder();
+	TestInstanceBatcherGrouping();
+	TestConstantBufferDirtyRanges();
+	TestShaderHandleOwnership();
+
+	Report("Self tests: %d failure(s)", failures);
+	return failures;
+}
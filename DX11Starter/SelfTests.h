@@ -0,0 +1,10 @@
+#pragma once
+
+// --------------------------------------------------------
+// Headless checks of the engine's CPU side systems
+// Started with -self-test on the command line (see Main.cpp),
+// runs without a window or device, prints each failure and
+// appends the results to SelfTests.txt next to the executable
+// Returns the number of failed checks, so 0 means everything passed
+// --------------------------------------------------------
+int RunSelfTests();
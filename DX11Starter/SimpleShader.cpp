@@ -1,9 +1,16 @@
 #include "SimpleShader.h"
+#include <cassert>
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+// Shared by every shader, so the totals cover everything drawn
+SimpleShaderUploadCounters ISimpleShader::uploadCounters = {};
+
+// Partial constant buffer copies are widened to whole 16 byte constants
+#define CONSTANT_ALIGNMENT 16
+
 // --------------------------------------------------------
 // Constructor accepts DirectX device & context
 // --------------------------------------------------------
@@ -17,6 +24,22 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	constantBufferCount = 0;
 	constantBuffers = 0;
 	shaderBlob = 0;
+	shaderValid = false;
+
+	// Copying just the changed part of a constant buffer needs Direct3D 11.1
+	// and a driver that supports it, otherwise whole buffers are copied
+	deviceContext1 = 0;
+	partialConstantBufferUpdates = false;
+	if (device && context)
+	{
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+		if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+			options.ConstantBufferPartialUpdate &&
+			SUCCEEDED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&deviceContext1)))
+		{
+			partialConstantBufferUpdates = true;
+		}
+	}
 }
 
 // --------------------------------------------------------
@@ -27,6 +50,8 @@ ISimpleShader::~ISimpleShader()
 	// Derived class destructors will call this class's CleanUp method
 	if(shaderBlob)
 		shaderBlob->Release();
+	if (deviceContext1)
+		deviceContext1->Release();
 }
 
 // --------------------------------------------------------
@@ -38,7 +63,8 @@ void ISimpleShader::CleanUp()
 	// Handle constant buffers and local data buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		constantBuffers[i].ConstantBuffer->Release();
+		if (constantBuffers[i].ConstantBuffer)
+			constantBuffers[i].ConstantBuffer->Release();
 		delete[] constantBuffers[i].LocalDataBuffer;
 	}
 
@@ -73,12 +99,35 @@ void ISimpleShader::CleanUp()
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
 	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+	ID3DBlob* blob = 0;
+	HRESULT hr = D3DReadFileToBlob(shaderFile, &blob);
 	if (hr != S_OK)
 	{
 		return false;
 	}
 
+	// Create the shader and its variable table from the blob
+	return LoadShaderBlob(blob);
+}
+
+// --------------------------------------------------------
+// Creates the shader and builds the variable table from a
+// compiled shader that has already been read into memory
+// (for instance by a loader thread).
+//
+// blob - The compiled shader, which this shader takes ownership of
+// 
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob(ID3DBlob* blob)
+{
+	// Nothing to load if reading the file failed
+	if (!blob)
+	{
+		return false;
+	}
+	shaderBlob = blob;
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -176,6 +225,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].Size = bufferDesc.Size;
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].Dirty = true;
+		constantBuffers[b].Shared = false;
+		constantBuffers[b].DirtyStart = 0;
+		constantBuffers[b].DirtyEnd = bufferDesc.Size;
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -193,6 +246,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			varStruct.ConstantBufferIndex = b;
 			varStruct.ByteOffset = varDesc.StartOffset;
 			varStruct.Size = varDesc.Size;
+			varStruct.Owner = this;
 			
 			// Get a string version
 			std::string varName(varDesc.Name);
@@ -270,20 +324,18 @@ void ISimpleShader::SetShader()
 // Copies the relevant data to the all of this 
 // shader's constant buffers.  To just copy one
 // buffer, use CopyBufferData()
+//
+// Buffers whose data hasn't changed since their last copy
+// (and shared buffers) are skipped
 // --------------------------------------------------------
 void ISimpleShader::CopyAllBufferData()
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy all changed data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
-	}
+		CopyDirtyBuffer(&constantBuffers[i]);
 }
 
 // --------------------------------------------------------
@@ -310,10 +362,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	CopyDirtyBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -332,10 +382,124 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	CopyDirtyBuffer(cb);
+}
+
+
+// --------------------------------------------------------
+// Copies a constant buffer's local data to the GPU, unless
+// none of it has changed since the last copy (or the buffer
+// is shared and filled elsewhere)
+//
+// NOTE: Only the changed range (widened to whole constants)
+//       is copied when the device supports partial updates,
+//       otherwise the whole buffer is, since Direct3D 11.0
+//       can't update part of a constant buffer
+// --------------------------------------------------------
+void ISimpleShader::CopyDirtyBuffer(SimpleConstantBuffer* cb)
+{
+	if (!cb->Dirty || cb->Shared)
+	{
+		uploadCounters.buffersSkipped++;
+		return;
+	}
+
+	// Work out how much has to go
+	unsigned int start = 0;
+	unsigned int end = cb->Size;
+	if (partialConstantBufferUpdates)
+	{
+		start = cb->DirtyStart / CONSTANT_ALIGNMENT * CONSTANT_ALIGNMENT;
+		end = (cb->DirtyEnd + CONSTANT_ALIGNMENT - 1) / CONSTANT_ALIGNMENT * CONSTANT_ALIGNMENT;
+		if (end > cb->Size) end = cb->Size;
+	}
+	UploadConstantBuffer(cb, start, end);
+
+	uploadCounters.buffersCopied++;
+	uploadCounters.bytesCopied += end - start;
+	uploadCounters.bytesChanged += cb->DirtyEnd - cb->DirtyStart;
+
+	// Clean until something changes again
+	cb->Dirty = false;
+	cb->DirtyStart = 0;
+	cb->DirtyEnd = 0;
+}
+
+// --------------------------------------------------------
+// Sends part (or all) of a constant buffer's local data to
+// the GPU
+//
+// cb    - The buffer to copy
+// start - First byte to copy
+// end   - One past the last byte to copy
+//
+// NOTE: Partial copies go straight through the immediate
+//       context, where the box and the source data line up
+// --------------------------------------------------------
+void ISimpleShader::UploadConstantBuffer(SimpleConstantBuffer* cb, unsigned int start, unsigned int end)
+{
+	// Copy the entire local data buffer
+	if (start == 0 && end == cb->Size)
+	{
+		deviceContext->UpdateSubresource(
+			cb->ConstantBuffer, 0, 0,
+			cb->LocalDataBuffer, 0, 0);
+		return;
+	}
+
+	// Copy just the range that changed
+	D3D11_BOX box = {};
+	box.left = start;
+	box.right = end;
+	box.bottom = 1;
+	box.back = 1;
+	deviceContext1->UpdateSubresource1(
+		cb->ConstantBuffer, 0, &box,
+		cb->LocalDataBuffer + start, 0, 0, 0);
+}
+
+// --------------------------------------------------------
+// Replaces the shader's own copy of a buffer with one that is
+// owned and filled elsewhere, such as per frame data shared by
+// many shaders.  The shader keeps binding it in SetShader(), but
+// never copies its local data over it.
+//
+// bufferName - The name of the buffer in the shader
+// buffer     - The buffer to bind instead (must be at least as large)
+//
+// Returns true if the buffer exists and was replaced
+// --------------------------------------------------------
+bool ISimpleShader::SetSharedConstantBuffer(std::string bufferName, ID3D11Buffer* buffer)
+{
+	return SetSharedConstantBuffer(this->FindConstantBuffer(bufferName), buffer);
+}
+
+// --------------------------------------------------------
+// Same as above, with the buffer's info already looked up
+//
+// bufferInfo - The buffer's info from GetBufferInfo() (null fails)
+// buffer     - The buffer to bind instead (must be at least as large)
+//
+// Returns true if the buffer belongs to this shader and was replaced
+// --------------------------------------------------------
+bool ISimpleShader::SetSharedConstantBuffer(const SimpleConstantBuffer* bufferInfo, ID3D11Buffer* buffer)
+{
+	// Check for the buffer
+	if (!OwnsConstantBuffer(bufferInfo) || !buffer) return false;
+	SimpleConstantBuffer* cb = &constantBuffers[bufferInfo - constantBuffers];
+
+	// Swap the buffers, holding a reference so clean up works the same either way
+	if (cb->ConstantBuffer == buffer) return true;
+	buffer->AddRef();
+	if (cb->ConstantBuffer)
+		cb->ConstantBuffer->Release();
+	cb->ConstantBuffer = buffer;
+	cb->Shared = true;
+	cb->Dirty = false;
+	cb->DirtyStart = 0;
+	cb->DirtyEnd = 0;
+	return true;
 }
 
 
@@ -351,16 +515,54 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 // --------------------------------------------------------
 bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
 {
-	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, size);
+	// Look for the variable and set it
+	return SetData(FindVariable(name, size), data, size);
+}
+
+// --------------------------------------------------------
+// Sets a variable found ahead of time with GetVariableInfo()
+// with arbitrary data of the specified size, skipping the
+// lookup by name
+//
+// variable - The variable's info (null is allowed and fails)
+// data     - The data to set in the buffer
+// size     - The size of the data (this must match the variable's size)
+//
+// Returns true if data is copied, false if the variable is
+// null, belongs to another shader or sizes don't match
+// --------------------------------------------------------
+bool ISimpleShader::SetData(const SimpleShaderVariable* var, const void* data, unsigned int size)
+{
+	// Verify the variable, another shader's offsets would land in the wrong buffer
 	if (var == 0)
 		return false;
+	assert(var->Owner == this && "Shader variable info belongs to a different shader");
+	if (var->Owner != this || var->Size != size)
+		return false;
+
+	// Setting the value that's already there changes nothing
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	unsigned char* destination = cb->LocalDataBuffer + var->ByteOffset;
+	if (memcmp(destination, data, size) == 0)
+		return true;
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	memcpy(destination, data, size);
+
+	// Grow the buffer's changed range to cover this variable
+	unsigned int start = var->ByteOffset;
+	unsigned int end = var->ByteOffset + size;
+	if (!cb->Dirty)
+	{
+		cb->Dirty = true;
+		cb->DirtyStart = start;
+		cb->DirtyEnd = end;
+	}
+	else
+	{
+		if (start < cb->DirtyStart) cb->DirtyStart = start;
+		if (end > cb->DirtyEnd) cb->DirtyEnd = end;
+	}
 
 	// Success
 	return true;
@@ -446,14 +648,103 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Pre-resolved versions of the setters above, for variables
+// found once with GetVariableInfo() and then set every frame
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(const SimpleShaderVariable* variable, int data)
+{
+	return this->SetData(variable, (void*)(&data), sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(const SimpleShaderVariable* variable, float data)
+{
+	return this->SetData(variable, (void*)(&data), sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(const SimpleShaderVariable* variable, const DirectX::XMFLOAT2 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(const SimpleShaderVariable* variable, const DirectX::XMFLOAT3 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4X4 data)
+{
+	return this->SetData(variable, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
+//
+// The result stays valid until the shader is reloaded, so it
+// can be kept and passed to the setters in place of the name
 // --------------------------------------------------------
 const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 {
 	return FindVariable(name, -1);
 }
 
+// --------------------------------------------------------
+// Checks that buffer info was found on this shader
+//
+// bufferInfo - The buffer's info (null is allowed and fails)
+//
+// Returns true if the info belongs to this shader
+// --------------------------------------------------------
+bool ISimpleShader::OwnsConstantBuffer(const SimpleConstantBuffer* bufferInfo)
+{
+	if (bufferInfo == 0)
+		return false;
+
+	bool owned = bufferInfo >= constantBuffers && bufferInfo < constantBuffers + constantBufferCount;
+	assert(owned && "Constant buffer info belongs to a different shader");
+	return owned;
+}
+
+// --------------------------------------------------------
+// Checks that SRV info was found on this shader, since
+// another shader's bind points could be anywhere
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+//
+// Returns true if the info belongs to this shader
+// --------------------------------------------------------
+bool ISimpleShader::OwnsShaderResourceView(const SimpleSRV* srvInfo)
+{
+	if (srvInfo == 0)
+		return false;
+
+	bool owned = srvInfo->Index < shaderResourceViews.size() && shaderResourceViews[srvInfo->Index] == srvInfo;
+	assert(owned && "Shader resource view info belongs to a different shader");
+	return owned;
+}
+
+// --------------------------------------------------------
+// Checks that sampler info was found on this shader
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+//
+// Returns true if the info belongs to this shader
+// --------------------------------------------------------
+bool ISimpleShader::OwnsSampler(const SimpleSampler* sampInfo)
+{
+	if (sampInfo == 0)
+		return false;
+
+	bool owned = sampInfo->Index < samplerStates.size() && samplerStates[sampInfo->Index] == sampInfo;
+	assert(owned && "Sampler info belongs to a different shader");
+	return owned;
+}
+
 // --------------------------------------------------------
 // Gets info about an SRV in the shader (or null)
 //
@@ -675,6 +966,10 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
 		refl->GetInputParameterDesc(i, &paramDesc);
 
+		// System values (like SV_VertexID) are generated by the input assembler, not read from a buffer
+		if (paramDesc.SystemValueType != D3D_NAME_UNDEFINED)
+			continue;
+
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
 		std::string sem = paramDesc.SemanticName;
@@ -732,6 +1027,13 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// A shader that only uses system values doesn't need an input layout at all
+	if (inputLayoutDesc.empty())
+	{
+		refl->Release();
+		return true;
+	}
+
 	// Try to create Input Layout
 	HRESULT hr = device->CreateInputLayout(
 		&inputLayoutDesc[0], 
@@ -778,9 +1080,23 @@ void SimpleVertexShader::SetShaderAndCBs()
 // --------------------------------------------------------
 bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
+	// Look for the variable and set it
+	return SetShaderResourceView(GetShaderResourceViewInfo(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view found ahead of time with
+// GetShaderResourceViewInfo(), skipping the lookup by name
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if srvInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv)
+{
+	// Verify the resource belongs to this shader
+	if (!OwnsShaderResourceView(srvInfo))
 		return false;
 
 	// Set the shader resource view
@@ -800,9 +1116,23 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 // --------------------------------------------------------
 bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
+	// Look for the variable and set it
+	return SetSamplerState(GetSamplerInfo(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state found ahead of time with
+// GetSamplerInfo(), skipping the lookup by name
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if sampInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState)
+{
+	// Verify the sampler belongs to this shader
+	if (!OwnsSampler(sampInfo))
 		return false;
 
 	// Set the shader resource view
@@ -899,9 +1229,23 @@ void SimplePixelShader::SetShaderAndCBs()
 // --------------------------------------------------------
 bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
+	// Look for the variable and set it
+	return SetShaderResourceView(GetShaderResourceViewInfo(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view found ahead of time with
+// GetShaderResourceViewInfo(), skipping the lookup by name
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if srvInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv)
+{
+	// Verify the resource belongs to this shader
+	if (!OwnsShaderResourceView(srvInfo))
 		return false;
 
 	// Set the shader resource view
@@ -921,9 +1265,23 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 // --------------------------------------------------------
 bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
+	// Look for the variable and set it
+	return SetSamplerState(GetSamplerInfo(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state found ahead of time with
+// GetSamplerInfo(), skipping the lookup by name
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if sampInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState)
+{
+	// Verify the sampler belongs to this shader
+	if (!OwnsSampler(sampInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1022,9 +1380,23 @@ void SimpleDomainShader::SetShaderAndCBs()
 // --------------------------------------------------------
 bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
+	// Look for the variable and set it
+	return SetShaderResourceView(GetShaderResourceViewInfo(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view found ahead of time with
+// GetShaderResourceViewInfo(), skipping the lookup by name
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if srvInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleDomainShader::SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv)
+{
+	// Verify the resource belongs to this shader
+	if (!OwnsShaderResourceView(srvInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1044,9 +1416,23 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 // --------------------------------------------------------
 bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
+	// Look for the variable and set it
+	return SetSamplerState(GetSamplerInfo(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state found ahead of time with
+// GetSamplerInfo(), skipping the lookup by name
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if sampInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleDomainShader::SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState)
+{
+	// Verify the sampler belongs to this shader
+	if (!OwnsSampler(sampInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1144,9 +1530,23 @@ void SimpleHullShader::SetShaderAndCBs()
 // --------------------------------------------------------
 bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
+	// Look for the variable and set it
+	return SetShaderResourceView(GetShaderResourceViewInfo(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view found ahead of time with
+// GetShaderResourceViewInfo(), skipping the lookup by name
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if srvInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleHullShader::SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv)
+{
+	// Verify the resource belongs to this shader
+	if (!OwnsShaderResourceView(srvInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1166,9 +1566,23 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResou
 // --------------------------------------------------------
 bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
+	// Look for the variable and set it
+	return SetSamplerState(GetSamplerInfo(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state found ahead of time with
+// GetSamplerInfo(), skipping the lookup by name
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if sampInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleHullShader::SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState)
+{
+	// Verify the sampler belongs to this shader
+	if (!OwnsSampler(sampInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1388,9 +1802,23 @@ void SimpleGeometryShader::SetShaderAndCBs()
 // --------------------------------------------------------
 bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
+	// Look for the variable and set it
+	return SetShaderResourceView(GetShaderResourceViewInfo(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view found ahead of time with
+// GetShaderResourceViewInfo(), skipping the lookup by name
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if srvInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv)
+{
+	// Verify the resource belongs to this shader
+	if (!OwnsShaderResourceView(srvInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1410,9 +1838,23 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 // --------------------------------------------------------
 bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
+	// Look for the variable and set it
+	return SetSamplerState(GetSamplerInfo(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state found ahead of time with
+// GetSamplerInfo(), skipping the lookup by name
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if sampInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState)
+{
+	// Verify the sampler belongs to this shader
+	if (!OwnsSampler(sampInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1626,9 +2068,23 @@ void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int
 // --------------------------------------------------------
 bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
+	// Look for the variable and set it
+	return SetShaderResourceView(GetShaderResourceViewInfo(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view found ahead of time with
+// GetShaderResourceViewInfo(), skipping the lookup by name
+//
+// srvInfo - The SRV's info (null is allowed and fails)
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if srvInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleComputeShader::SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv)
+{
+	// Verify the resource belongs to this shader
+	if (!OwnsShaderResourceView(srvInfo))
 		return false;
 
 	// Set the shader resource view
@@ -1648,9 +2104,23 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderRe
 // --------------------------------------------------------
 bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
+	// Look for the variable and set it
+	return SetSamplerState(GetSamplerInfo(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state found ahead of time with
+// GetSamplerInfo(), skipping the lookup by name
+//
+// sampInfo - The sampler's info (null is allowed and fails)
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if sampInfo isn't null, false otherwise
+// --------------------------------------------------------
+bool SimpleComputeShader::SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState)
+{
+	// Verify the sampler belongs to this shader
+	if (!OwnsSampler(sampInfo))
 		return false;
 
 	// Set the shader resource view
@@ -3,6 +3,7 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 
@@ -14,11 +15,13 @@
 // Used by simple shaders to store information about
 // specific variables in constant buffers
 // --------------------------------------------------------
+class ISimpleShader;
 struct SimpleShaderVariable
 {
 	unsigned int ByteOffset;
 	unsigned int Size;
 	unsigned int ConstantBufferIndex;
+	const ISimpleShader* Owner;	// The shader the offsets belong to
 };
 
 // --------------------------------------------------------
@@ -34,6 +37,23 @@ struct SimpleConstantBuffer
 	ID3D11Buffer* ConstantBuffer;
 	unsigned char* LocalDataBuffer;
 	std::vector<SimpleShaderVariable> Variables;
+	bool Dirty;		// Local data has changed since it was last copied to the GPU
+	bool Shared;	// Buffer is owned and filled elsewhere, the shader only binds it
+	unsigned int DirtyStart;	// First byte changed since the last copy
+	unsigned int DirtyEnd;		// One past the last byte changed since the last copy
+};
+
+// --------------------------------------------------------
+// Totals of constant buffer copies made by every simple
+// shader since the counters were last reset (usually once
+// per frame)
+// --------------------------------------------------------
+struct SimpleShaderUploadCounters
+{
+	unsigned int buffersCopied;	// Buffers sent to the GPU
+	unsigned int buffersSkipped;	// Buffers left alone because nothing in them changed
+	unsigned int bytesCopied;		// Bytes sent to the GPU (the changed range when the device can update part of a buffer)
+	unsigned int bytesChanged;		// Bytes of those buffers that actually changed
 };
 
 // --------------------------------------------------------
@@ -66,6 +86,7 @@ public:
 	// Initialization method (since we can't invoke derived class
 	// overrides in the base class constructor)
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderBlob(ID3DBlob* blob);
 
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
@@ -76,8 +97,14 @@ public:
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
 
+	// Replaces one of this shader's buffers with a buffer filled elsewhere
+	// (such as per frame data shared by many shaders)
+	bool SetSharedConstantBuffer(std::string bufferName, ID3D11Buffer* buffer);
+	bool SetSharedConstantBuffer(const SimpleConstantBuffer* bufferInfo, ID3D11Buffer* buffer); // Info from GetBufferInfo(), skipping the lookup by name
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
+	bool SetData(const SimpleShaderVariable* variable, const void* data, unsigned int size);
 
 	bool SetInt(std::string name, int data);
 	bool SetFloat(std::string name, float data);
@@ -90,9 +117,19 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Setters for variables found once with GetVariableInfo(), which skip the lookup by name
+	bool SetInt(const SimpleShaderVariable* variable, int data);
+	bool SetFloat(const SimpleShaderVariable* variable, float data);
+	bool SetFloat2(const SimpleShaderVariable* variable, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(const SimpleShaderVariable* variable, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(const SimpleShaderVariable* variable, const DirectX::XMFLOAT4X4 data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
 	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
+	virtual bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState) = 0;
 
 	// Getting data about variables and resources
 	const SimpleShaderVariable* GetVariableInfo(std::string name);
@@ -114,12 +151,18 @@ public:
 	// Misc getters
 	ID3DBlob* GetShaderBlob() { return shaderBlob; }
 
+	// Constant buffer copies made by all shaders
+	static SimpleShaderUploadCounters GetUploadCounters() { return uploadCounters; }
+	static void ResetUploadCounters() { uploadCounters = {}; }
+
 protected:
 	
 	bool shaderValid;
 	ID3DBlob* shaderBlob;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
+	ID3D11DeviceContext1* deviceContext1;	// Only kept when the device can update part of a constant buffer
+	bool partialConstantBufferUpdates;		// Whether only the changed range of a buffer is copied
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -142,6 +185,19 @@ protected:
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+
+	// Whether resource info came from this shader (asserts when it came from another one)
+	bool OwnsConstantBuffer(const SimpleConstantBuffer* bufferInfo);
+	bool OwnsShaderResourceView(const SimpleSRV* srvInfo);
+	bool OwnsSampler(const SimpleSampler* sampInfo);
+
+	// Copies a buffer to the GPU if anything in it changed
+	void CopyDirtyBuffer(SimpleConstantBuffer* cb);
+
+	// Sends bytes [start, end) of a buffer's local data to the GPU
+	// Only ever asked for part of a buffer when partialConstantBufferUpdates is set
+	virtual void UploadConstantBuffer(SimpleConstantBuffer* cb, unsigned int start, unsigned int end);
+	static SimpleShaderUploadCounters uploadCounters;
 };
 
 // --------------------------------------------------------
@@ -159,6 +215,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -182,6 +240,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11PixelShader* shader;
@@ -202,6 +262,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11DomainShader* shader;
@@ -222,6 +284,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11HullShader* shader;
@@ -242,6 +306,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
@@ -281,6 +347,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const SimpleSRV* srvInfo, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const SimpleSampler* sampInfo, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
@@ -0,0 +1,185 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(float cellSize)
+{
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+}
+
+SpatialGrid::~SpatialGrid()
+{
+}
+
+void SpatialGrid::Insert(Entity* entity, float x, float z, float radius, unsigned int order)
+{
+	// If the entity already exists, treat this as a move
+	auto existing = records.find(entity);
+	if (existing != records.end())
+	{
+		// The cells hold a copy of the order key, so a new key means re-adding the entity to them
+		if (existing->second.order != order)
+		{
+			RemoveFromCells(entity, existing->second);
+			existing->second.order = order;
+			CalculateFootprint(x, z, radius, existing->second);
+			AddToCells(entity, existing->second);
+			return;
+		}
+
+		Move(entity, x, z, radius);
+		return;
+	}
+
+	// Otherwise compute the footprint and drop it into every overlapped cell
+	GridRecord record = {};
+	record.order = order;
+	CalculateFootprint(x, z, radius, record);
+	AddToCells(entity, record);
+	records[entity] = record;
+}
+
+void SpatialGrid::Move(Entity* entity, float x, float z, float radius)
+{
+	auto existing = records.find(entity);
+	if (existing == records.end())
+		return;
+
+	// Only touch the cells if the entity's footprint actually changed
+	GridRecord updated = existing->second;
+	CalculateFootprint(x, z, radius, updated);
+	if (updated.minX == existing->second.minX && updated.maxX == existing->second.maxX &&
+		updated.minZ == existing->second.minZ && updated.maxZ == existing->second.maxZ)
+		return;
+
+	RemoveFromCells(entity, existing->second);
+	AddToCells(entity, updated);
+	existing->second = updated;
+}
+
+void SpatialGrid::Remove(Entity* entity)
+{
+	auto existing = records.find(entity);
+	if (existing == records.end())
+		return;
+
+	RemoveFromCells(entity, existing->second);
+	records.erase(existing);
+}
+
+void SpatialGrid::Clear()
+{
+	cells.clear();
+	records.clear();
+}
+
+void SpatialGrid::Query(float x, float z, float radius, std::vector<Entity*>& results)
+{
+	results.clear();
+	queryEntries.clear();
+
+	GridRecord footprint = {};
+	CalculateFootprint(x, z, radius, footprint);
+
+	// Gather every entity in the overlapped cells along with its order key
+	for (int cellX = footprint.minX; cellX <= footprint.maxX; cellX++)
+	{
+		for (int cellZ = footprint.minZ; cellZ <= footprint.maxZ; cellZ++)
+		{
+			auto cell = cells.find(GetCellKey(cellX, cellZ));
+			if (cell == cells.end())
+				continue;
+
+			queryEntries.insert(queryEntries.end(), cell->second.begin(), cell->second.end());
+		}
+	}
+
+	// Hand the candidates back in a stable order so callers can resolve them deterministically
+	// Entities spanning several cells end up next to their duplicates, which are skipped below
+	std::sort(queryEntries.begin(), queryEntries.end(), [](const GridEntry& a, const GridEntry& b) {
+		return a.order < b.order || (a.order == b.order && a.entity < b.entity);
+	});
+
+	for (size_t i = 0; i < queryEntries.size(); i++)
+	{
+		if (i > 0 && queryEntries[i].entity == queryEntries[i - 1].entity)
+			continue;
+
+		results.push_back(queryEntries[i].entity);
+	}
+}
+
+bool SpatialGrid::Contains(Entity* entity)
+{
+	return records.count(entity) != 0;
+}
+
+unsigned int SpatialGrid::GetOrder(Entity* entity)
+{
+	return records[entity].order;
+}
+
+float SpatialGrid::GetCellSize()
+{
+	return cellSize;
+}
+
+void SpatialGrid::CalculateFootprint(float x, float z, float radius, GridRecord& record)
+{
+	// Colliders without a valid radius still occupy the cell they sit in
+	if (radius < 0)
+		radius = 0;
+
+	record.minX = (int)floorf((x - radius) * inverseCellSize);
+	record.maxX = (int)floorf((x + radius) * inverseCellSize);
+	record.minZ = (int)floorf((z - radius) * inverseCellSize);
+	record.maxZ = (int)floorf((z + radius) * inverseCellSize);
+}
+
+void SpatialGrid::AddToCells(Entity* entity, GridRecord& record)
+{
+	for (int cellX = record.minX; cellX <= record.maxX; cellX++)
+	{
+		for (int cellZ = record.minZ; cellZ <= record.maxZ; cellZ++)
+		{
+			GridEntry entry = { record.order, entity };
+			cells[GetCellKey(cellX, cellZ)].push_back(entry);
+		}
+	}
+}
+
+void SpatialGrid::RemoveFromCells(Entity* entity, GridRecord& record)
+{
+	for (int cellX = record.minX; cellX <= record.maxX; cellX++)
+	{
+		for (int cellZ = record.minZ; cellZ <= record.maxZ; cellZ++)
+		{
+			auto cell = cells.find(GetCellKey(cellX, cellZ));
+			if (cell == cells.end())
+				continue;
+
+			// Swap and pop since the order inside a cell does not matter
+			std::vector<GridEntry>& contents = cell->second;
+			for (size_t i = 0; i < contents.size(); i++)
+			{
+				if (contents[i].entity == entity)
+				{
+					contents[i] = contents.back();
+					contents.pop_back();
+					break;
+				}
+			}
+
+			// Drop empty cells so the hash doesn't grow as entities move around
+			if (contents.empty())
+				cells.erase(cell);
+		}
+	}
+}
+
+long long SpatialGrid::GetCellKey(int x, int z)
+{
+	// Pack both signed cell co-ordinates into a single 64 bit key
+	return ((long long)x << 32) | (unsigned int)z;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+class Entity;
+
+// --------------------------------------------------------
+// A uniform grid spatial hash over the XZ plane used as a
+// collision broadphase. Each entity is stored as a circle
+// in every cell its bounding square overlaps, so any two
+// circles that overlap are guaranteed to share a cell.
+// --------------------------------------------------------
+class SpatialGrid
+{
+public:
+	SpatialGrid(float cellSize); // Constructor
+	~SpatialGrid(); // Destructor
+
+	// Adds an entity to the grid (or moves it if it already exists) and assigns it an order key
+	void Insert(Entity* entity, float x, float z, float radius, unsigned int order);
+
+	// Moves an entity that already exists in the grid, only touching cells if its footprint changed
+	void Move(Entity* entity, float x, float z, float radius);
+
+	// Removes an entity from the grid
+	void Remove(Entity* entity);
+
+	// Removes everything from the grid
+	void Clear();
+
+	// Gathers every unique entity sharing a cell with the given circle, sorted by order key
+	void Query(float x, float z, float radius, std::vector<Entity*>& results);
+
+	// GET methods
+	bool Contains(Entity* entity);
+	unsigned int GetOrder(Entity* entity);
+	float GetCellSize();
+
+private:
+	// Cell footprint and ordering data tracked for each entity in the grid
+	struct GridRecord
+	{
+		int minX;
+		int minZ;
+		int maxX;
+		int maxZ;
+		unsigned int order;
+	};
+
+	// An entity's entry in a cell, carrying its order key so queries never have to look it up
+	struct GridEntry
+	{
+		unsigned int order;
+		Entity* entity;
+	};
+
+	// Helper methods
+	void CalculateFootprint(float x, float z, float radius, GridRecord& record);
+	void AddToCells(Entity* entity, GridRecord& record);
+	void RemoveFromCells(Entity* entity, GridRecord& record);
+	long long GetCellKey(int x, int z);
+
+	// Size of a single square cell in world units
+	float cellSize;
+	float inverseCellSize;
+
+	// Sparse cells keyed by packed cell co-ordinates
+	std::unordered_map<long long, std::vector<GridEntry>> cells;
+
+	// Footprint of every entity currently in the grid
+	std::unordered_map<Entity*, GridRecord> records;
+
+	// Reused by every query so gathering candidates doesn't allocate
+	std::vector<GridEntry> queryEntries;
+};
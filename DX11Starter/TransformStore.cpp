@@ -0,0 +1,198 @@
+#include "TransformStore.h"
+#include <climits>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+TransformStore::TransformStore()
+{
+	capacity = 0;
+	freeSlots = std::vector<unsigned int>();
+}
+
+TransformStore::~TransformStore()
+{
+}
+
+unsigned int TransformStore::Allocate()
+{
+	// Grow by a whole block of slots once every free slot has been handed out
+	if (freeSlots.empty())
+	{
+		unsigned int oldCapacity = capacity;
+		Grow(capacity == 0 ? 64 : capacity * 2);
+
+		// Push in reverse so the lowest slots get handed out first
+		for (unsigned int i = capacity; i > oldCapacity; i--)
+			freeSlots.push_back(i - 1);
+	}
+
+	unsigned int index = freeSlots.back();
+	freeSlots.pop_back();
+
+	// Reset the slot to an identity transform at rest
+	positionX[index] = positionY[index] = positionZ[index] = 0;
+	velocityX[index] = velocityY[index] = velocityZ[index] = 0;
+	rotationX[index] = rotationY[index] = rotationZ[index] = 0;
+	scaleX[index] = scaleY[index] = scaleZ[index] = 1;
+	XMStoreFloat4x4(&worldMatrices[index], XMMatrixIdentity());
+	dirty[index] = 0;
+
+	return index;
+}
+
+void TransformStore::Free(unsigned int index)
+{
+	// Zero the velocity so the batched pass leaves the empty slot alone
+	velocityX[index] = velocityY[index] = velocityZ[index] = 0;
+	dirty[index] = 0;
+	freeSlots.push_back(index);
+}
+
+void TransformStore::UpdateTransforms(float deltaTime)
+{
+	XMVECTOR dt = XMVectorReplicate(deltaTime);
+	XMVECTOR zero = XMVectorZero();
+
+	// Integrate four slots at a time, each lane of a vector being a different entity
+	// Capacity is always a multiple of 4 so there is never a remainder to handle
+	for (unsigned int i = 0; i < capacity; i += 4)
+	{
+		XMVECTOR vx = XMLoadFloat4((XMFLOAT4*)&velocityX[i]);
+		XMVECTOR vy = XMLoadFloat4((XMFLOAT4*)&velocityY[i]);
+		XMVECTOR vz = XMLoadFloat4((XMFLOAT4*)&velocityZ[i]);
+
+		XMStoreFloat4((XMFLOAT4*)&positionX[i], XMVectorMultiplyAdd(vx, dt, XMLoadFloat4((XMFLOAT4*)&positionX[i])));
+		XMStoreFloat4((XMFLOAT4*)&positionY[i], XMVectorMultiplyAdd(vy, dt, XMLoadFloat4((XMFLOAT4*)&positionY[i])));
+		XMStoreFloat4((XMFLOAT4*)&positionZ[i], XMVectorMultiplyAdd(vz, dt, XMLoadFloat4((XMFLOAT4*)&positionZ[i])));
+
+		// Anything with a non-zero velocity moved, so flag its world matrix as dirty
+		XMVECTOR moving = XMVectorOrInt(
+			XMVectorOrInt(XMVectorNotEqual(vx, zero), XMVectorNotEqual(vy, zero)),
+			XMVectorNotEqual(vz, zero));
+		XMStoreUInt4(
+			(XMUINT4*)&dirty[i],
+			XMVectorOrInt(moving, XMLoadUInt4((XMUINT4*)&dirty[i])));
+	}
+
+	// Rebuild only the world matrices that changed
+	for (unsigned int i = 0; i < capacity; i++)
+	{
+		if (dirty[i])
+			RebuildWorldMatrix(i);
+	}
+}
+
+void TransformStore::RebuildWorldMatrix(unsigned int index)
+{
+	if (!dirty[index])
+		return;
+
+	// Update the world matrix based on the position, rotation, and scale
+	XMStoreFloat4x4(&worldMatrices[index],
+		XMMatrixScaling(scaleX[index], scaleY[index], scaleZ[index]) *
+		XMMatrixRotationRollPitchYaw(rotationX[index], rotationY[index], rotationZ[index]) *
+		XMMatrixTranslation(positionX[index], positionY[index], positionZ[index]));
+
+	dirty[index] = 0;
+}
+
+XMFLOAT3 TransformStore::GetPosition(unsigned int index)
+{
+	return XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+}
+
+XMFLOAT3 TransformStore::GetRotation(unsigned int index)
+{
+	return XMFLOAT3(rotationX[index], rotationY[index], rotationZ[index]);
+}
+
+XMFLOAT3 TransformStore::GetScale(unsigned int index)
+{
+	return XMFLOAT3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+XMFLOAT3 TransformStore::GetVelocity(unsigned int index)
+{
+	return XMFLOAT3(velocityX[index], velocityY[index], velocityZ[index]);
+}
+
+XMFLOAT4X4 TransformStore::GetWorldMatrix(unsigned int index)
+{
+	// Make sure anything changed since the last batched pass is reflected
+	RebuildWorldMatrix(index);
+	return worldMatrices[index];
+}
+
+bool TransformStore::IsDirty(unsigned int index)
+{
+	return dirty[index] != 0;
+}
+
+unsigned int TransformStore::GetCapacity()
+{
+	return capacity;
+}
+
+void TransformStore::SetPosition(unsigned int index, XMFLOAT3 position)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+	dirty[index] = UINT_MAX;
+}
+
+void TransformStore::SetRotation(unsigned int index, XMFLOAT3 rotation)
+{
+	rotationX[index] = rotation.x;
+	rotationY[index] = rotation.y;
+	rotationZ[index] = rotation.z;
+	dirty[index] = UINT_MAX;
+}
+
+void TransformStore::SetScale(unsigned int index, XMFLOAT3 scale)
+{
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+	dirty[index] = UINT_MAX;
+}
+
+void TransformStore::SetVelocity(unsigned int index, XMFLOAT3 velocity)
+{
+	velocityX[index] = velocity.x;
+	velocityY[index] = velocity.y;
+	velocityZ[index] = velocity.z;
+}
+
+void TransformStore::SetWorldMatrix(unsigned int index, XMFLOAT4X4 worldMatrix)
+{
+	// An explicitly set matrix wins until the next position, rotation or scale change
+	worldMatrices[index] = worldMatrix;
+	dirty[index] = 0;
+}
+
+void TransformStore::Grow(unsigned int newCapacity)
+{
+	// Keep the capacity a multiple of 4 so the SIMD pass never reads past the end
+	newCapacity = (newCapacity + 3) & ~3u;
+	if (newCapacity <= capacity)
+		return;
+
+	positionX.resize(newCapacity, 0);
+	positionY.resize(newCapacity, 0);
+	positionZ.resize(newCapacity, 0);
+	velocityX.resize(newCapacity, 0);
+	velocityY.resize(newCapacity, 0);
+	velocityZ.resize(newCapacity, 0);
+	rotationX.resize(newCapacity, 0);
+	rotationY.resize(newCapacity, 0);
+	rotationZ.resize(newCapacity, 0);
+	scaleX.resize(newCapacity, 1);
+	scaleY.resize(newCapacity, 1);
+	scaleZ.resize(newCapacity, 1);
+	worldMatrices.resize(newCapacity);
+	dirty.resize(newCapacity, 0);
+
+	capacity = newCapacity;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// A structure of arrays store for entity transforms
+// Position, rotation, scale and velocity are kept in
+// contiguous per-component arrays so the per frame
+// integration can run four entities per SIMD instruction,
+// and world matrices are only rebuilt for dirty entries
+// --------------------------------------------------------
+class TransformStore
+{
+public:
+	TransformStore(); // Constructor
+	~TransformStore(); // Destructor
+
+	// Slot management
+	unsigned int Allocate();
+	void Free(unsigned int index);
+
+	// Batched per frame pass that integrates velocities and rebuilds every dirty world matrix
+	void UpdateTransforms(float deltaTime);
+
+	// Rebuilds a single world matrix if it is dirty
+	void RebuildWorldMatrix(unsigned int index);
+
+	// GET methods
+	DirectX::XMFLOAT3 GetPosition(unsigned int index);
+	DirectX::XMFLOAT3 GetRotation(unsigned int index);
+	DirectX::XMFLOAT3 GetScale(unsigned int index);
+	DirectX::XMFLOAT3 GetVelocity(unsigned int index);
+	DirectX::XMFLOAT4X4 GetWorldMatrix(unsigned int index);
+	bool IsDirty(unsigned int index);
+	unsigned int GetCapacity();
+
+	// SET methods (all of which mark the world matrix as dirty)
+	void SetPosition(unsigned int index, DirectX::XMFLOAT3 position);
+	void SetRotation(unsigned int index, DirectX::XMFLOAT3 rotation);
+	void SetScale(unsigned int index, DirectX::XMFLOAT3 scale);
+	void SetVelocity(unsigned int index, DirectX::XMFLOAT3 velocity);
+	void SetWorldMatrix(unsigned int index, DirectX::XMFLOAT4X4 worldMatrix);
+
+private:
+	// Grows every array to hold at least the given number of slots (always a multiple of 4)
+	void Grow(unsigned int capacity);
+
+	// Number of slots currently backed by the arrays
+	unsigned int capacity;
+
+	// Slots that have been freed and can be handed out again
+	std::vector<unsigned int> freeSlots;
+
+	// Per component arrays
+	std::vector<float> positionX;
+	std::vector<float> positionY;
+	std::vector<float> positionZ;
+	std::vector<float> velocityX;
+	std::vector<float> velocityY;
+	std::vector<float> velocityZ;
+	std::vector<float> rotationX;
+	std::vector<float> rotationY;
+	std::vector<float> rotationZ;
+	std::vector<float> scaleX;
+	std::vector<float> scaleY;
+	std::vector<float> scaleZ;
+
+	// Cached world matrices and whether they need to be recalculated
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<unsigned int> dirty;
+};
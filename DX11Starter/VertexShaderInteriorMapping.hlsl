@@ -5,9 +5,11 @@
 // - All non-pipeline variables that get their values from 
 //    our C++ code must be defined inside a Constant Buffer
 // - The name of the cbuffer itself is unimportant
-cbuffer externalData : register(b0)
+//
+// Per frame data, filled once per frame and shared by every entity shader
+// - Only the camera matrices at the start of it are needed here
+cbuffer frameData : register(b0)
 {
-	matrix world;
 	matrix view;
 	matrix projection;
 };
@@ -28,6 +30,15 @@ struct VertexShaderInput
 	float3 normal		: NORMAL;
 	float3 tangent		: TANGENT;
 	float2 uv			: TEXCOORD;
+
+	// Per instance data, read from the instance buffer in slot 1 (see the _PER_INSTANCE semantics)
+	// The world matrix arrives one row per element
+	float4 worldRow0	: WORLD_PER_INSTANCE0;
+	float4 worldRow1	: WORLD_PER_INSTANCE1;
+	float4 worldRow2	: WORLD_PER_INSTANCE2;
+	float4 worldRow3	: WORLD_PER_INSTANCE3;
+	float offices		: OFFICES_PER_INSTANCE;
+	int randSeed		: RANDSEED_PER_INSTANCE;
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -47,6 +58,8 @@ struct VertexToPixel
 	float2 uv			: TEXCOORD;
 	float3 tangent		: TANGENT;
 	float3 worldPos		: POSITION; // The world position of this vertex
+	nointerpolation float offices	: OFFICES; // Rooms across each face of this building
+	nointerpolation int randSeed	: RANDSEED; // Seed for picking this building's rooms
 };
 
 // --------------------------------------------------------
@@ -61,6 +74,9 @@ VertexToPixel main( VertexShaderInput input )
 	// Set up output struct
 	VertexToPixel output;
 
+	// Rebuild this instance's world matrix
+	matrix world = matrix(input.worldRow0, input.worldRow1, input.worldRow2, input.worldRow3);
+
 	// The vertex's position (input.position) must be converted to world space,
 	// then camera space (relative to our 3D camera), then to proper homogenous 
 	// screen-space coordinates.  This is taken care of by our world, view and
@@ -92,6 +108,10 @@ VertexToPixel main( VertexShaderInput input )
 	// Pass the vertex UV cordinates through to the pixel shader
 	output.uv = input.uv;
 
+	// Pass this building's interior settings through as well
+	output.offices = input.offices;
+	output.randSeed = input.randSeed;
+
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
 	return output;
@@ -6,13 +6,26 @@ cbuffer externalData : register(b0)
     matrix projection;
 };
 
-// Describes individual vertex data
+// Describes a single particle, read once per corner of its quad
+// - The _PER_INSTANCE semantics tell SimpleShader to read these from the instance buffer in slot 1
+// - Color arrives as RGBA8 packed into a single uint (red in the lowest byte)
 struct VertexShaderInput
 {
-    float3 position		: POSITION;
-    float2 uv			: TEXCOORD;
-    float4 color		: COLOR;
-	float size			: SIZE;
+	float3 position		: POSITION_PER_INSTANCE;
+	uint color			: COLOR_PER_INSTANCE;
+	float size			: SIZE_PER_INSTANCE;
+	uint vertexID		: SV_VertexID;
+};
+
+// Corners of the two triangles that make up each particle's quad
+static const float2 cornerUVs[6] =
+{
+	float2(0, 0),
+	float2(1, 0),
+	float2(1, 1),
+	float2(0, 0),
+	float2(1, 1),
+	float2(0, 1)
 };
 
 // Defines the output data of our vertex shader
@@ -33,15 +46,22 @@ VertexToPixel main(VertexShaderInput input)
     matrix viewProj = mul(view, projection);
     output.position = mul(float4(input.position, 1.0f), viewProj);
 
+	// Generate this corner's UV from the vertex ID
+	float2 uv = cornerUVs[input.vertexID % 6];
+
 	// Use UV to offset position (billboarding)
-	float2 offset = input.uv * 2 - 1;
+	float2 offset = uv * 2 - 1;
 	offset *= input.size;
 	offset.y *= -1;
 	output.position.xy += offset;
 	
-	// Pass uv through
-	output.uv = input.uv;
-	output.color = input.color;
+	// Pass uv through and unpack the color
+	output.uv = uv;
+	output.color = float4(
+		input.color & 0xFF,
+		(input.color >> 8) & 0xFF,
+		(input.color >> 16) & 0xFF,
+		input.color >> 24) / 255.0f;
    
     return output;
 }
\ No newline at end of file